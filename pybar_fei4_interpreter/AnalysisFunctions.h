@@ -9,232 +9,677 @@
 #include <exception>
 #include <algorithm>
 #include <sstream>
+#include <vector>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 #include "Basis.h"
 #include "defines.h"
 
+//returns true if one sorted array is so much larger than the other that skipping through it by galloping is faster than a linear search
+bool useGalloping(const unsigned int& rSizeArrayOne, const unsigned int& rSizeArrayTwo)
+{
+	return (uint64_t) std::max(rSizeArrayOne, rSizeArrayTwo) >= (uint64_t) __GALLOP_MIN_SIZE_RATIO * (uint64_t) std::min(rSizeArrayOne, rSizeArrayTwo);
+}
+
+inline int64_t eventNumber(const int64_t& rEventNumber){ return rEventNumber; }
+inline int64_t eventNumber(const ClusterInfo& rClusterInfo){ return rClusterInfo.event_number; }
+
+//true if the entry is before rValue in an array sorted by event number (rUpper: not after rValue)
+template<class T> inline bool beforeEventNumber(const T& rEntry, const int64_t& rValue, const bool& rUpper)
+{
+	return eventNumber(rEntry) < rValue || (rUpper && eventNumber(rEntry) == rValue);
+}
+
+//returns the first index >= rStart of the array sorted by event number with an event number >= rValue (rUpper: > rValue), rSize if there is none
+//galloping: the step size doubles until the value is passed, then binary search in the last step, thus O(log(distance)) instead of O(distance)
+template<class T> unsigned int advanceSorted(const T* rArray, const unsigned int& rStart, const unsigned int& rSize, const int64_t& rValue, const bool& rUpper, const bool& rGallop)
+{
+	if (!rGallop){
+		unsigned int i = rStart;
+		while (i < rSize && beforeEventNumber(rArray[i], rValue, rUpper))
+			++i;
+		return i;
+	}
+	size_t tLow = rStart;  // all values before tLow are passed
+	size_t tHigh = rStart;
+	size_t tStep = 1;
+	while (tHigh < rSize && beforeEventNumber(rArray[tHigh], rValue, rUpper)){
+		tLow = tHigh + 1;
+		tHigh = tLow + tStep;
+		tStep *= 2;
+	}
+	tHigh = std::min(tHigh, (size_t) rSize);
+	while (tLow < tHigh){
+		size_t tMid = tLow + (tHigh - tLow) / 2;
+		if (beforeEventNumber(rArray[tMid], rValue, rUpper))
+			tLow = tMid + 1;
+		else
+			tHigh = tMid;
+	}
+	return (unsigned int) tLow;
+}
+
+//returns the number of threads for a parallel function with rNentries input entries, rNthreads = 0: OpenMP default; always 1 if compiled without OpenMP
+unsigned int getNanalysisThreads(const unsigned int& rNthreads, const uint64_t& rNentries)
+{
+#ifdef _OPENMP
+	uint64_t tNthreads = rNthreads == 0 ? (uint64_t) omp_get_max_threads() : (uint64_t) rNthreads;
+	return (unsigned int) std::max((uint64_t) 1, std::min(tNthreads, rNentries / __MIN_EVENTS_PER_THREAD));  // small arrays are not worth the thread overhead
+#else
+	return 1;
+#endif
+}
+
+//group reductions of the values [rFirst, rLast) of one group (rLast > rFirst)
+template<class TValue, class TResult> struct GroupCount{ static TResult reduce(const TValue*, const unsigned int& rFirst, const unsigned int& rLast){ return (TResult) (rLast - rFirst); } };
+template<class TValue, class TResult> struct GroupSum
+{
+	static TResult reduce(const TValue* rValues, const unsigned int& rFirst, const unsigned int& rLast)
+	{
+		TResult tSum = 0;
+		for (unsigned int i = rFirst; i < rLast; ++i)
+			tSum += (TResult) rValues[i];
+		return tSum;
+	}
+};
+template<class TValue, class TResult> struct GroupMin{ static TResult reduce(const TValue* rValues, const unsigned int& rFirst, const unsigned int& rLast){ return (TResult) *std::min_element(rValues + rFirst, rValues + rLast); } };
+template<class TValue, class TResult> struct GroupMax{ static TResult reduce(const TValue* rValues, const unsigned int& rFirst, const unsigned int& rLast){ return (TResult) *std::max_element(rValues + rFirst, rValues + rLast); } };
+template<class TValue, class TResult> struct GroupFirst{ static TResult reduce(const TValue* rValues, const unsigned int& rFirst, const unsigned int&){ return (TResult) rValues[rFirst]; } };
+template<class TValue, class TResult> struct GroupLast{ static TResult reduce(const TValue* rValues, const unsigned int&, const unsigned int& rLast){ return (TResult) rValues[rLast - 1]; } };
+
+//returns the number of groups (runs of equal keys) of the entries [rFirst, rLast), the loop has no branch and is vectorized by the compiler
+unsigned int countGroups(const int64_t* rKeys, const unsigned int& rFirst, const unsigned int& rLast)
+{
+	if (rFirst == rLast)
+		return 0;
+	unsigned int tNgroups = 1;
+	for (unsigned int i = rFirst + 1; i < rLast; ++i)
+		tNgroups += (unsigned int) (rKeys[i] != rKeys[i - 1]);
+	return tNgroups;
+}
+
+//reduces the groups of the entries [rFirst, rLast), writes the key and the result of each group and returns the number of groups
+template<class TOperation, class TValue, class TResult> unsigned int reduceGroupRange(const int64_t* rKeys, const TValue* rValues, const unsigned int& rFirst, const unsigned int& rLast, int64_t* rResultKeys, TResult* rResult)
+{
+	unsigned int tNgroups = 0;
+	for (unsigned int i = rFirst; i < rLast; ++tNgroups){
+		unsigned int tEnd = i + 1;
+		while (tEnd < rLast && rKeys[tEnd] == rKeys[i])
+			++tEnd;
+		rResultKeys[tNgroups] = rKeys[i];
+		rResult[tNgroups] = TOperation::reduce(rValues, i, tEnd);
+		i = tEnd;
+	}
+	return tNgroups;
+}
+
+//group-by reduction with the operation TOperation, see reduceGroups
+//parallel: the entries are split into parts of about the same size, every split is moved back to the first entry of its group; the groups of each part are counted first and then reduced to the prefix sum of the counts
+template<class TOperation, class TValue, class TResult> unsigned int reduceGroupsWith(const int64_t* rKeys, const TValue* rValues, const unsigned int& rSize, int64_t* rResultKeys, TResult* rResult, const unsigned int& rNthreads)
+{
+	const unsigned int tNparts = getNanalysisThreads(rNthreads, rSize);
+	if (tNparts == 1)
+		return reduceGroupRange<TOperation>(rKeys, rValues, 0, rSize, rResultKeys, rResult);
+	std::vector<unsigned int> tSplit(tNparts + 1, rSize);
+	tSplit[0] = 0;
+	for (unsigned int t = 1; t < tNparts; ++t){
+		unsigned int i = std::max((unsigned int) ((uint64_t) rSize * t / tNparts), tSplit[t - 1]);
+		while (i > tSplit[t - 1] && rKeys[i - 1] == rKeys[i])  // the keys are not required to be sorted, thus no binary search
+			--i;
+		tSplit[t] = i;
+	}
+	std::vector<unsigned int> tOffset(tNparts + 1, 0);
+#pragma omp parallel for num_threads((int) tNparts)
+	for (int t = 0; t < (int) tNparts; ++t)
+		tOffset[t + 1] = countGroups(rKeys, tSplit[t], tSplit[t + 1]);
+	for (unsigned int t = 0; t < tNparts; ++t)
+		tOffset[t + 1] += tOffset[t];
+#pragma omp parallel for num_threads((int) tNparts)
+	for (int t = 0; t < (int) tNparts; ++t)
+		reduceGroupRange<TOperation>(rKeys, rValues, tSplit[t], tSplit[t + 1], rResultKeys + tOffset[t], rResult + tOffset[t]);
+	return tOffset[tNparts];
+}
+
+//group-by reduction of the value column over the groups of equal consecutive keys, e.g. the hits of one event in the event number column
+//rOperation: __GROUP_COUNT (rValues is not used), __GROUP_SUM, __GROUP_MIN, __GROUP_MAX, __GROUP_FIRST, __GROUP_LAST
+//writes the key and the result of each group to rResultKeys/rResult (rSize entries are always enough) and returns the number of groups
+template<class TValue, class TResult> unsigned int reduceGroups(const int64_t* rKeys, const TValue* rValues, const unsigned int& rSize, const unsigned int& rOperation, int64_t* rResultKeys, TResult* rResult, const unsigned int& rNthreads = 1)
+{
+	switch (rOperation){
+		case __GROUP_COUNT:
+			return reduceGroupsWith<GroupCount<TValue, TResult> >(rKeys, rValues, rSize, rResultKeys, rResult, rNthreads);
+		case __GROUP_SUM:
+			return reduceGroupsWith<GroupSum<TValue, TResult> >(rKeys, rValues, rSize, rResultKeys, rResult, rNthreads);
+		case __GROUP_MIN:
+			return reduceGroupsWith<GroupMin<TValue, TResult> >(rKeys, rValues, rSize, rResultKeys, rResult, rNthreads);
+		case __GROUP_MAX:
+			return reduceGroupsWith<GroupMax<TValue, TResult> >(rKeys, rValues, rSize, rResultKeys, rResult, rNthreads);
+		case __GROUP_FIRST:
+			return reduceGroupsWith<GroupFirst<TValue, TResult> >(rKeys, rValues, rSize, rResultKeys, rResult, rNthreads);
+		case __GROUP_LAST:
+			return reduceGroupsWith<GroupLast<TValue, TResult> >(rKeys, rValues, rSize, rResultKeys, rResult, rNthreads);
+		default:
+			throw std::invalid_argument("Unknown group operation.");
+	}
+}
+
 // counts from the event number column of the cluster table how often a cluster occurs in every event
-unsigned int getNclusterInEvents(int64_t*& rEventNumber, const unsigned int& rSize, int64_t*& rResultEventNumber, unsigned int*& rResultCount)
+unsigned int getNclusterInEvents(int64_t*& rEventNumber, const unsigned int& rSize, int64_t*& rResultEventNumber, unsigned int*& rResultCount, const unsigned int& rNthreads = 1)
 {
-	unsigned int tResultIndex = 0;
-	unsigned int tLastIndex = 0;
-	int64_t tLastValue = 0;
-	for (unsigned int i=0; i<rSize; ++i){  // loop over all events can count the consecutive equal event numbers
-		if (i == 0)
-			tLastValue = rEventNumber[i];
-		else if (tLastValue != rEventNumber[i]){
-			rResultCount[tResultIndex] = i - tLastIndex;
-			rResultEventNumber[tResultIndex] = tLastValue;
-			tLastValue = rEventNumber[i];
-			tLastIndex = i;
-			tResultIndex++;
-		}
+	return reduceGroupsWith<GroupCount<int64_t, unsigned int> >(rEventNumber, (const int64_t*) 0, rSize, rResultEventNumber, rResultCount, rNthreads);
+}
+
+//returns the first index of the array sorted by event number with an event number >= rValue
+template<class T> unsigned int lowerBoundEventNumber(const T* rArray, const unsigned int& rSize, const int64_t& rValue)
+{
+	unsigned int tLow = 0;
+	unsigned int tHigh = rSize;
+	while (tLow < tHigh){
+		unsigned int tMid = tLow + (tHigh - tLow) / 2;
+		if (eventNumber(rArray[tMid]) < rValue)
+			tLow = tMid + 1;
+		else
+			tHigh = tMid;
 	}
-	// add last event
-	rResultCount[tResultIndex] = rSize - tLastIndex;
-	rResultEventNumber[tResultIndex] = tLastValue;
-	return tResultIndex+1;
+	return tLow;
 }
 
-//takes two event arrays and calculates an intersection array of event numbers occurring in both arrays
-unsigned int getEventsInBothArrays(int64_t*& rEventArrayOne, const unsigned int& rSizeArrayOne, int64_t*& rEventArrayTwo, const unsigned int& rSizeArrayTwo, int64_t*& rEventArrayIntersection)
+//merge path partitioning of two arrays sorted by event number into rNparts parts with about the same number of entries, part t is [rSplitOne[t], rSplitOne[t + 1]) of array one and [rSplitTwo[t], rSplitTwo[t + 1]) of array two
+//the merge path crossing of each diagonal is moved back to the first entry of its event number, thus all entries of one event number are in the same part
+template<class TOne, class TTwo> void splitSortedArrays(const TOne* rArrayOne, const unsigned int& rSizeArrayOne, const TTwo* rArrayTwo, const unsigned int& rSizeArrayTwo, const unsigned int& rNparts, std::vector<unsigned int>& rSplitOne, std::vector<unsigned int>& rSplitTwo)
 {
-	int64_t tActualEventNumber = -1;
-	unsigned int tActualIndex = 0;
-	unsigned int tActualResultIndex = 0;
-	for (unsigned int i=0; i<rSizeArrayOne; ++i){  // loop over all event numbers in first array
-		if (rEventArrayOne[i] == tActualEventNumber)  // omit the same event number occuring again
-			continue;
-		tActualEventNumber = rEventArrayOne[i];
-		for(unsigned int j = tActualIndex; j<rSizeArrayTwo; ++j){
-			if (rEventArrayTwo[j] >= tActualEventNumber){
-				tActualIndex = j;
-				break;
-			}
-		}
-		if (rEventArrayTwo[tActualIndex] == tActualEventNumber){
-			rEventArrayIntersection[tActualResultIndex] = tActualEventNumber;
-			tActualResultIndex++;
+	rSplitOne.assign(rNparts + 1, rSizeArrayOne);
+	rSplitTwo.assign(rNparts + 1, rSizeArrayTwo);
+	rSplitOne[0] = 0;
+	rSplitTwo[0] = 0;
+	for (unsigned int t = 1; t < rNparts; ++t){
+		uint64_t tDiagonal = ((uint64_t) rSizeArrayOne + (uint64_t) rSizeArrayTwo) * t / rNparts;
+		uint64_t tLow = tDiagonal > rSizeArrayTwo ? tDiagonal - rSizeArrayTwo : 0;  // number of entries of array one before the crossing
+		uint64_t tHigh = std::min(tDiagonal, (uint64_t) rSizeArrayOne);
+		while (tLow < tHigh){
+			uint64_t tMid = (tLow + tHigh) / 2;
+			if (eventNumber(rArrayOne[tMid]) <= eventNumber(rArrayTwo[tDiagonal - tMid - 1]))
+				tLow = tMid + 1;
+			else
+				tHigh = tMid;
 		}
+		unsigned int i = (unsigned int) tLow;
+		unsigned int j = (unsigned int) (tDiagonal - tLow);
+		int64_t tEventNumber = (j == rSizeArrayTwo || (i < rSizeArrayOne && eventNumber(rArrayOne[i]) <= eventNumber(rArrayTwo[j]))) ? eventNumber(rArrayOne[i]) : eventNumber(rArrayTwo[j]);
+		rSplitOne[t] = lowerBoundEventNumber(rArrayOne, rSizeArrayOne, tEventNumber);
+		rSplitTwo[t] = lowerBoundEventNumber(rArrayTwo, rSizeArrayTwo, tEventNumber);
 	}
-	return tActualResultIndex++;
 }
 
-//takes two event number arrays and returns a event number array with the maximum occurrence of each event number in array one and two
-unsigned int getMaxEventsInBothArrays(int64_t*& rEventArrayOne, const unsigned int& rSizeArrayOne, int64_t*& rEventArrayTwo, const unsigned int& rSizeArrayTwo, int64_t*& result, const unsigned int& rSizeArrayResult)
+//serial intersection of two sorted event arrays, rEventArrayIntersection = 0: only counts
+unsigned int intersectSortedArrays(const int64_t* rEventArrayOne, const unsigned int& rSizeArrayOne, const int64_t* rEventArrayTwo, const unsigned int& rSizeArrayTwo, int64_t* rEventArrayIntersection)
 {
-	int64_t tFirstActualEventNumber = rEventArrayOne[0];
-	int64_t tSecondActualEventNumber = rEventArrayTwo[0];
-	int64_t tFirstLastEventNumber = rEventArrayOne[rSizeArrayOne - 1];
-	int64_t tSecondLastEventNumber = rEventArrayTwo[rSizeArrayTwo - 1];
+	const bool tGallop = useGalloping(rSizeArrayOne, rSizeArrayTwo);
 	unsigned int i = 0;
 	unsigned int j = 0;
 	unsigned int tActualResultIndex = 0;
-	unsigned int tFirstActualOccurrence = 0;
-	unsigned int tSecondActualOccurrence = 0;
-
-	bool first_finished = false;
-	bool second_finished = false;
-
-//	std::cout<<"tFirstActualEventNumber "<<tFirstActualEventNumber<<std::endl;
-//	std::cout<<"tSecondActualEventNumber "<<tSecondActualEventNumber<<std::endl;
-//	std::cout<<"tFirstLastEventNumber "<<tFirstLastEventNumber<<std::endl;
-//	std::cout<<"tSecondLastEventNumber "<<tSecondLastEventNumber<<std::endl;
-//	std::cout<<"rSizeArrayOne "<<rSizeArrayOne<<std::endl;
-//	std::cout<<"rSizeArrayTwo "<<rSizeArrayTwo<<std::endl;
-//	std::cout<<"rSizeArrayResult "<<rSizeArrayResult<<std::endl;
-
-	while ( !(first_finished && second_finished) ){
-		if ( (tFirstActualEventNumber <= tSecondActualEventNumber) || second_finished ){
-			unsigned int ii;
-			for (ii = i; ii < rSizeArrayOne; ++ii){
-				if (rEventArrayOne[ii] == tFirstActualEventNumber)
-					tFirstActualOccurrence++;
-				else break;
-			}
-			i = ii;
+	while (i < rSizeArrayOne && j < rSizeArrayTwo){
+		if (rEventArrayOne[i] < rEventArrayTwo[j])
+			i = advanceSorted(rEventArrayOne, i, rSizeArrayOne, rEventArrayTwo[j], false, tGallop);
+		else if (rEventArrayTwo[j] < rEventArrayOne[i])
+			j = advanceSorted(rEventArrayTwo, j, rSizeArrayTwo, rEventArrayOne[i], false, tGallop);
+		else{  // omit the same event number occurring again
+			int64_t tActualEventNumber = rEventArrayOne[i];
+			if (rEventArrayIntersection != 0)
+				rEventArrayIntersection[tActualResultIndex] = tActualEventNumber;
+			tActualResultIndex++;
+			i = advanceSorted(rEventArrayOne, i, rSizeArrayOne, tActualEventNumber, true, tGallop);
+			j = advanceSorted(rEventArrayTwo, j, rSizeArrayTwo, tActualEventNumber, true, tGallop);
 		}
+	}
+	return tActualResultIndex;
+}
 
-		if ( (tSecondActualEventNumber <= tFirstActualEventNumber) || first_finished ){
-			unsigned int jj;
-			for (jj=j; jj < rSizeArrayTwo; ++jj){
-				if (rEventArrayTwo[jj] == tSecondActualEventNumber)
-					tSecondActualOccurrence++;
-				else break;
-			}
-			j = jj;
-		}
+//takes two event arrays and calculates an intersection array of event numbers occurring in both arrays
+//parallel: every thread intersects one merge path part, the part results are counted first and then written at the prefix sum of the counts
+unsigned int getEventsInBothArrays(int64_t*& rEventArrayOne, const unsigned int& rSizeArrayOne, int64_t*& rEventArrayTwo, const unsigned int& rSizeArrayTwo, int64_t*& rEventArrayIntersection, const unsigned int& rNthreads = 1)
+{
+	const unsigned int tNparts = getNanalysisThreads(rNthreads, (uint64_t) rSizeArrayOne + (uint64_t) rSizeArrayTwo);
+	if (tNparts == 1)
+		return intersectSortedArrays(rEventArrayOne, rSizeArrayOne, rEventArrayTwo, rSizeArrayTwo, rEventArrayIntersection);
+	std::vector<unsigned int> tSplitOne, tSplitTwo;
+	splitSortedArrays(rEventArrayOne, rSizeArrayOne, rEventArrayTwo, rSizeArrayTwo, tNparts, tSplitOne, tSplitTwo);
+	std::vector<unsigned int> tOffset(tNparts + 1, 0);
+#pragma omp parallel for num_threads((int) tNparts)
+	for (int t = 0; t < (int) tNparts; ++t)
+		tOffset[t + 1] = intersectSortedArrays(rEventArrayOne + tSplitOne[t], tSplitOne[t + 1] - tSplitOne[t], rEventArrayTwo + tSplitTwo[t], tSplitTwo[t + 1] - tSplitTwo[t], 0);
+	for (unsigned int t = 0; t < tNparts; ++t)
+		tOffset[t + 1] += tOffset[t];
+#pragma omp parallel for num_threads((int) tNparts)
+	for (int t = 0; t < (int) tNparts; ++t)
+		intersectSortedArrays(rEventArrayOne + tSplitOne[t], tSplitOne[t + 1] - tSplitOne[t], rEventArrayTwo + tSplitTwo[t], tSplitTwo[t + 1] - tSplitTwo[t], rEventArrayIntersection + tOffset[t]);
+	return tOffset[tNparts];
+}
 
-//		std::cout<<"tFirstActualEventNumber "<<tFirstActualEventNumber<<" "<<tFirstActualOccurrence<<" "<<first_finished<<std::endl;
-//		std::cout<<"tSecondActualEventNumber "<<tSecondActualEventNumber<<" "<<tSecondActualOccurrence<<" "<<second_finished<<std::endl;
+//throws if the result array has no space for rNevents more event numbers
+void checkResultSize(const unsigned int& rActualResultIndex, const unsigned int& rNevents, const unsigned int& rSizeArrayResult)
+{
+	if ((uint64_t) rActualResultIndex + (uint64_t) rNevents > (uint64_t) rSizeArrayResult)
+		throw std::out_of_range("The result histogram is too small. Increase size.");
+}
 
-		if (tFirstActualEventNumber == tSecondActualEventNumber){
-//			std::cout<<"==, add "<<std::max(tFirstActualOccurrence, tSecondActualOccurrence)<<" x "<<tFirstActualEventNumber<<std::endl;
-			if (tFirstActualEventNumber == tFirstLastEventNumber) first_finished = true;
-			if (tSecondActualEventNumber == tSecondLastEventNumber) second_finished = true;
-			for (unsigned int k = 0; k < std::max(tFirstActualOccurrence, tSecondActualOccurrence); ++k){
-				if (tActualResultIndex < rSizeArrayResult)
-					result[tActualResultIndex++] = tFirstActualEventNumber;
-				else
-					throw std::out_of_range("The result histogram is too small. Increase size.");
+//serial maximum occurrence merge of two sorted event arrays, result = 0: only counts
+unsigned int mergeMaxSortedArrays(const int64_t* rEventArrayOne, const unsigned int& rSizeArrayOne, const int64_t* rEventArrayTwo, const unsigned int& rSizeArrayTwo, int64_t* result, const unsigned int& rSizeArrayResult)
+{
+	const bool tGallop = useGalloping(rSizeArrayOne, rSizeArrayTwo);
+	unsigned int i = 0;
+	unsigned int j = 0;
+	unsigned int tActualResultIndex = 0;
+	while (i < rSizeArrayOne || j < rSizeArrayTwo){
+		if (j == rSizeArrayTwo || (i < rSizeArrayOne && rEventArrayOne[i] < rEventArrayTwo[j])){  // event numbers only in array one are copied
+			unsigned int tEnd = j == rSizeArrayTwo ? rSizeArrayOne : advanceSorted(rEventArrayOne, i, rSizeArrayOne, rEventArrayTwo[j], false, tGallop);
+			if (result != 0){
+				checkResultSize(tActualResultIndex, tEnd - i, rSizeArrayResult);
+				std::copy(rEventArrayOne + i, rEventArrayOne + tEnd, result + tActualResultIndex);
 			}
+			tActualResultIndex += tEnd - i;
+			i = tEnd;
 		}
-		else if ( (!first_finished && tFirstActualEventNumber < tSecondActualEventNumber) || second_finished){
-//			std::cout<<"==, add "<<tFirstActualOccurrence<<" x "<<tFirstActualEventNumber<<std::endl;
-			if (tFirstActualEventNumber == tFirstLastEventNumber) first_finished = true;
-			for (unsigned int k = 0; k < tFirstActualOccurrence; ++k){
-				if (tActualResultIndex < rSizeArrayResult)
-					result[tActualResultIndex++] = tFirstActualEventNumber;
-				else
-					throw std::out_of_range("The result histogram is too small. Increase size.");
+		else if (i == rSizeArrayOne || rEventArrayTwo[j] < rEventArrayOne[i]){  // event numbers only in array two are copied
+			unsigned int tEnd = i == rSizeArrayOne ? rSizeArrayTwo : advanceSorted(rEventArrayTwo, j, rSizeArrayTwo, rEventArrayOne[i], false, tGallop);
+			if (result != 0){
+				checkResultSize(tActualResultIndex, tEnd - j, rSizeArrayResult);
+				std::copy(rEventArrayTwo + j, rEventArrayTwo + tEnd, result + tActualResultIndex);
 			}
+			tActualResultIndex += tEnd - j;
+			j = tEnd;
 		}
-		else if ( (!second_finished && tSecondActualEventNumber < tFirstActualEventNumber) || first_finished){
-//			std::cout<<"==, add "<<tSecondActualOccurrence<<" x "<<tSecondActualEventNumber<<std::endl;
-			if (tSecondActualEventNumber == tSecondLastEventNumber) second_finished = true;
-			for (unsigned int k = 0; k < tSecondActualOccurrence; ++k){
-				if (tActualResultIndex < rSizeArrayResult)
-					result[tActualResultIndex++] = tSecondActualEventNumber;
-				else
-					throw std::out_of_range("The result histogram is too small. Increase size.");
+		else{  // event number in both arrays, the larger occurrence is taken
+			int64_t tActualEventNumber = rEventArrayOne[i];
+			unsigned int tFirstEnd = advanceSorted(rEventArrayOne, i, rSizeArrayOne, tActualEventNumber, true, tGallop);
+			unsigned int tSecondEnd = advanceSorted(rEventArrayTwo, j, rSizeArrayTwo, tActualEventNumber, true, tGallop);
+			unsigned int tNevents = std::max(tFirstEnd - i, tSecondEnd - j);
+			if (result != 0){
+				checkResultSize(tActualResultIndex, tNevents, rSizeArrayResult);
+				std::fill(result + tActualResultIndex, result + tActualResultIndex + tNevents, tActualEventNumber);
 			}
+			tActualResultIndex += tNevents;
+			i = tFirstEnd;
+			j = tSecondEnd;
 		}
-
-		if (i < rSizeArrayOne)
-			tFirstActualEventNumber = rEventArrayOne[i];
-		if (j < rSizeArrayTwo)
-			tSecondActualEventNumber = rEventArrayTwo[j];
-		tFirstActualOccurrence = 0;
-		tSecondActualOccurrence = 0;
 	}
-
 	return tActualResultIndex;
 }
 
-//does the same as np.in1d but uses the fact that the arrays are sorted
-void in1d_sorted(int64_t*& rEventArrayOne, const unsigned int& rSizeArrayOne, int64_t*& rEventArrayTwo, const unsigned int& rSizeArrayTwo, uint8_t*& rSelection)
-{
-	rSelection[0] = true;
-	int64_t tActualEventNumber = -1;
-	unsigned int tActualIndex = 0;
-	for (unsigned int i=0; i<rSizeArrayOne; ++i){  // loop over all event numbers in first array
-		tActualEventNumber = rEventArrayOne[i];
-		for(unsigned int j = tActualIndex; j<rSizeArrayTwo; ++j){
-			if (rEventArrayTwo[j] >= tActualEventNumber){
-				tActualIndex = j;
-				break;
-			}
+//takes two event number arrays and returns a event number array with the maximum occurrence of each event number in array one and two
+//parallel: every thread merges one merge path part, the part results are counted first and then written at the prefix sum of the counts
+unsigned int getMaxEventsInBothArrays(int64_t*& rEventArrayOne, const unsigned int& rSizeArrayOne, int64_t*& rEventArrayTwo, const unsigned int& rSizeArrayTwo, int64_t*& result, const unsigned int& rSizeArrayResult, const unsigned int& rNthreads = 1)
+{
+	const unsigned int tNparts = getNanalysisThreads(rNthreads, (uint64_t) rSizeArrayOne + (uint64_t) rSizeArrayTwo);
+	if (tNparts == 1)
+		return mergeMaxSortedArrays(rEventArrayOne, rSizeArrayOne, rEventArrayTwo, rSizeArrayTwo, result, rSizeArrayResult);
+	std::vector<unsigned int> tSplitOne, tSplitTwo;
+	splitSortedArrays(rEventArrayOne, rSizeArrayOne, rEventArrayTwo, rSizeArrayTwo, tNparts, tSplitOne, tSplitTwo);
+	std::vector<unsigned int> tOffset(tNparts + 1, 0);
+#pragma omp parallel for num_threads((int) tNparts)
+	for (int t = 0; t < (int) tNparts; ++t)
+		tOffset[t + 1] = mergeMaxSortedArrays(rEventArrayOne + tSplitOne[t], tSplitOne[t + 1] - tSplitOne[t], rEventArrayTwo + tSplitTwo[t], tSplitTwo[t + 1] - tSplitTwo[t], 0, 0);
+	for (unsigned int t = 0; t < tNparts; ++t)
+		tOffset[t + 1] += tOffset[t];
+	checkResultSize(0, tOffset[tNparts], rSizeArrayResult);  // thus the parts cannot throw
+#pragma omp parallel for num_threads((int) tNparts)
+	for (int t = 0; t < (int) tNparts; ++t)
+		mergeMaxSortedArrays(rEventArrayOne + tSplitOne[t], tSplitOne[t + 1] - tSplitOne[t], rEventArrayTwo + tSplitTwo[t], tSplitTwo[t + 1] - tSplitTwo[t], result + tOffset[t], tOffset[t + 1] - tOffset[t]);
+	return tOffset[tNparts];
+}
+
+//serial in1d of two sorted event arrays
+void in1dSortedArrays(const int64_t* rEventArrayOne, const unsigned int& rSizeArrayOne, const int64_t* rEventArrayTwo, const unsigned int& rSizeArrayTwo, uint8_t* rSelection)
+{
+	const bool tGallop = useGalloping(rSizeArrayOne, rSizeArrayTwo);
+	unsigned int i = 0;
+	unsigned int j = 0;
+	while (i < rSizeArrayOne && j < rSizeArrayTwo){
+		if (rEventArrayOne[i] < rEventArrayTwo[j]){  // event numbers not in array two
+			unsigned int tEnd = advanceSorted(rEventArrayOne, i, rSizeArrayOne, rEventArrayTwo[j], false, tGallop);
+			std::fill(rSelection + i, rSelection + tEnd, 0);
+			i = tEnd;
+		}
+		else if (rEventArrayTwo[j] < rEventArrayOne[i])
+			j = advanceSorted(rEventArrayTwo, j, rSizeArrayTwo, rEventArrayOne[i], false, tGallop);
+		else{  // all occurrences of the event number in array one are selected
+			unsigned int tEnd = advanceSorted(rEventArrayOne, i, rSizeArrayOne, rEventArrayOne[i], true, tGallop);
+			std::fill(rSelection + i, rSelection + tEnd, 1);
+			i = tEnd;
 		}
-		if (rEventArrayTwo[tActualIndex] == tActualEventNumber)
-			rSelection[i] = 1;
-		else
-			rSelection[i] = 0;
 	}
+	std::fill(rSelection + i, rSelection + rSizeArrayOne, 0);  // no event numbers in array two left
 }
 
+//does the same as np.in1d but uses the fact that the arrays are sorted
+//parallel: every thread selects the entries of one merge path part, the parts of the selection are disjoint
+void in1d_sorted(int64_t*& rEventArrayOne, const unsigned int& rSizeArrayOne, int64_t*& rEventArrayTwo, const unsigned int& rSizeArrayTwo, uint8_t*& rSelection, const unsigned int& rNthreads = 1)
+{
+	const unsigned int tNparts = getNanalysisThreads(rNthreads, (uint64_t) rSizeArrayOne + (uint64_t) rSizeArrayTwo);
+	if (tNparts == 1){
+		in1dSortedArrays(rEventArrayOne, rSizeArrayOne, rEventArrayTwo, rSizeArrayTwo, rSelection);
+		return;
+	}
+	std::vector<unsigned int> tSplitOne, tSplitTwo;
+	splitSortedArrays(rEventArrayOne, rSizeArrayOne, rEventArrayTwo, rSizeArrayTwo, tNparts, tSplitOne, tSplitTwo);
+#pragma omp parallel for num_threads((int) tNparts)
+	for (int t = 0; t < (int) tNparts; ++t)
+		in1dSortedArrays(rEventArrayOne + tSplitOne[t], tSplitOne[t + 1] - tSplitOne[t], rEventArrayTwo + tSplitTwo[t], tSplitTwo[t + 1] - tSplitTwo[t], rSelection + tSplitOne[t]);
+}
 
-// fast 1d index histogramming (bin size = 1, values starting from 0)
-void histogram_1d(int*& x, const unsigned int& rSize, const unsigned int& rNbinsX, uint32_t*& rResult)
+
+//adds one entry to a bin, returns false if the bin overflows
+template<class TBin> inline bool addEntry(TBin& rBin){ ++rBin; return true; }
+inline bool addEntry(uint32_t& rBin){ return ++rBin != 0; }
+
+//adds a partial histogram bin sum to a bin, returns false if the bin overflows
+template<class TBin, class TSum> inline bool addSum(TBin& rBin, const TSum& rSum){ rBin += (TBin) rSum; return true; }
+inline bool addSum(uint32_t& rBin, const uint64_t& rSum)
 {
-	for (unsigned int i = 0; i < rSize; ++i){
-		if (x[i] >= rNbinsX)
-			throw std::out_of_range("The histogram indices are out of range");
-		if (rResult[x[i]] < 4294967295)
-			++rResult[x[i]];
-		else
+	if ((uint64_t) rBin + rSum > 4294967295ULL)
+		return false;
+	rBin += (uint32_t) rSum;
+	return true;
+}
+
+//partial histograms of uint32 bins count in uint64, thus the overflow is only checked once per bin in the reduction
+template<class TBin> struct HistogramSum{ typedef TBin Type; };
+template<> struct HistogramSum<uint32_t>{ typedef uint64_t Type; };
+
+//adds the rNparts partial histograms of rNbins bins to rResult, the result is only changed if no bin overflows; the sums are kept in the first partial histogram
+template<class TBin, class TSum> void addPartialHistograms(std::vector<TSum>& rPartial, const uint64_t& rNbins, const unsigned int& rNparts, TBin* rResult)
+{
+	bool tOverflow = false;
+#pragma omp parallel for num_threads((int) rNparts) reduction(||:tOverflow)
+	for (int iBin = 0; iBin < (int) rNbins; ++iBin){
+		TSum tSum = 0;
+		for (unsigned int t = 0; t < rNparts; ++t)
+			tSum += rPartial[(size_t) rNbins * t + (size_t) iBin];
+		rPartial[iBin] = tSum;
+		TBin tBin = rResult[iBin];
+		tOverflow = !addSum(tBin, tSum) || tOverflow;
+	}
+	if (tOverflow)
+		throw std::out_of_range("The histogram has more than 4294967295 entries per bin. This is not supported.");
+#pragma omp parallel for num_threads((int) rNparts)
+	for (int iBin = 0; iBin < (int) rNbins; ++iBin)
+		addSum(rResult[iBin], rPartial[iBin]);
+}
+
+//fills the entries [rFirst, rLast) into rHist, rY/rZ = 0 for 1d/2d histograms, rWeights = 0: unweighted
+//returns the first entry with an index out of range or rLast, throws if a bin overflows
+template<class TIndex, class TBin> unsigned int fillHistogram(const TIndex* rX, const TIndex* rY, const TIndex* rZ, const double* rWeights, const unsigned int& rFirst, const unsigned int& rLast, const unsigned int& rNbinsX, const unsigned int& rNbinsY, const unsigned int& rNbinsZ, TBin* rHist)
+{
+	for (unsigned int i = rFirst; i < rLast; ++i){
+		uint64_t tX = (uint64_t) (int64_t) rX[i];  // negative indices become large
+		uint64_t tY = rY != 0 ? (uint64_t) (int64_t) rY[i] : 0;
+		uint64_t tZ = rZ != 0 ? (uint64_t) (int64_t) rZ[i] : 0;
+		if (tX >= rNbinsX || tY >= rNbinsY || tZ >= rNbinsZ)
+			return i;
+		TBin& rBin = rHist[(tX * rNbinsY + tY) * rNbinsZ + tZ];
+		if (rWeights != 0)
+			rBin += (TBin) rWeights[i];
+		else if (!addEntry(rBin)){
+			--rBin;
 			throw std::out_of_range("The histogram has more than 4294967295 entries per bin. This is not supported.");
+		}
+	}
+	return rLast;
+}
+
+//fast 1d/2d/3d index histogramming (bin size = 1, values starting from 0), the entries are added to rResult sorted via x, y, z (C order)
+//rY/rZ = 0 for 1d/2d histograms, rWeights = 0: every entry counts 1, uint32 bins throw on overflow
+//parallel: every thread fills a partial histogram of a contiguous range of entries, the partial histograms are added bin by bin
+//the threads are limited to rSize / number of bins, thus the reduction never costs more than the filling
+template<class TIndex, class TBin> void histogram(const TIndex* rX, const TIndex* rY, const TIndex* rZ, const double* rWeights, const unsigned int& rSize, const unsigned int& rNbinsX, const unsigned int& rNbinsY, const unsigned int& rNbinsZ, TBin* rResult, const unsigned int& rNthreads = 1)
+{
+	typedef typename HistogramSum<TBin>::Type TSum;
+	const uint64_t tNbins = (uint64_t) rNbinsX * (uint64_t) rNbinsY * (uint64_t) rNbinsZ;
+	unsigned int tNthreads = getNanalysisThreads(rNthreads, rSize);
+	if (tNbins != 0)
+		tNthreads = (unsigned int) std::max((uint64_t) 1, std::min((uint64_t) tNthreads, (uint64_t) rSize / tNbins));
+	unsigned int tInvalid = rSize;  // first entry with an index out of range
+	if (tNthreads == 1)
+		tInvalid = fillHistogram(rX, rY, rZ, rWeights, 0, rSize, rNbinsX, rNbinsY, rNbinsZ, rResult);
+	else{
+		std::vector<TSum> tPartial((size_t) tNbins * tNthreads, 0);
+		std::vector<unsigned int> tThreadInvalid(tNthreads, rSize);
+#pragma omp parallel for num_threads((int) tNthreads)
+		for (int t = 0; t < (int) tNthreads; ++t){
+			unsigned int tFirst = (unsigned int) ((uint64_t) rSize * t / tNthreads);
+			unsigned int tLast = (unsigned int) ((uint64_t) rSize * (t + 1) / tNthreads);
+			unsigned int tEnd = fillHistogram(rX, rY, rZ, rWeights, tFirst, tLast, rNbinsX, rNbinsY, rNbinsZ, &tPartial[(size_t) tNbins * t]);  // cannot overflow
+			if (tEnd != tLast)
+				tThreadInvalid[t] = tEnd;
+		}
+		tInvalid = *std::min_element(tThreadInvalid.begin(), tThreadInvalid.end());
+		if (tInvalid == rSize)  // the result is only changed if all indices are valid, tNbins <= rSize / 2
+			addPartialHistograms(tPartial, tNbins, tNthreads, rResult);
+	}
+	if (tInvalid != rSize){
+		std::stringstream errorString;
+		errorString<<"The histogram indices (x/y/z)=("<<(int64_t) rX[tInvalid]<<"/"<<(rY != 0 ? (int64_t) rY[tInvalid] : 0)<<"/"<<(rZ != 0 ? (int64_t) rZ[tInvalid] : 0)<<") are out of range.";
+		throw std::out_of_range(errorString.str());
 	}
 }
 
+// fast 1d index histogramming (bin size = 1, values starting from 0)
+template<class TIndex, class TBin> void histogram_1d(const TIndex* x, const unsigned int& rSize, const unsigned int& rNbinsX, TBin* rResult, const double* rWeights = 0, const unsigned int& rNthreads = 1)
+{
+	histogram(x, (const TIndex*) 0, (const TIndex*) 0, rWeights, rSize, rNbinsX, 1, 1, rResult, rNthreads);
+}
 
 // fast 2d index histogramming (bin size = 1, values starting from 0)
-void histogram_2d(int*& x, int*& y, const unsigned int& rSize, const unsigned int& rNbinsX, const unsigned int& rNbinsY, uint32_t*& rResult)
+template<class TIndex, class TBin> void histogram_2d(const TIndex* x, const TIndex* y, const unsigned int& rSize, const unsigned int& rNbinsX, const unsigned int& rNbinsY, TBin* rResult, const double* rWeights = 0, const unsigned int& rNthreads = 1)
 {
-	for (unsigned int i = 0; i < rSize; ++i){
-		if (x[i] >= rNbinsX || y[i] >= rNbinsY)
-			throw std::out_of_range("The histogram indices are out of range");
-		if (rResult[x[i] * rNbinsY + y[i]] < 4294967295)
-			++rResult[x[i] * rNbinsY + y[i]];
-		else
-			throw std::out_of_range("The histogram has more than 4294967295 entries per bin. This is not supported.");
-	}
+	histogram(x, y, (const TIndex*) 0, rWeights, rSize, rNbinsX, rNbinsY, 1, rResult, rNthreads);
 }
 
 // fast 3d index histogramming (bin size = 1, values starting from 0)
-void histogram_3d(int*& x, int*& y, int*& z, const unsigned int& rSize, const unsigned int& rNbinsX, const unsigned int& rNbinsY, const unsigned int& rNbinsZ, uint32_t*& rResult)
+template<class TIndex, class TBin> void histogram_3d(const TIndex* x, const TIndex* y, const TIndex* z, const unsigned int& rSize, const unsigned int& rNbinsX, const unsigned int& rNbinsY, const unsigned int& rNbinsZ, TBin* rResult, const double* rWeights = 0, const unsigned int& rNthreads = 1)
 {
-	for (unsigned int i = 0; i < rSize; ++i){
-		if (x[i] >= rNbinsX || y[i] >= rNbinsY || z[i] >= rNbinsZ){
-			std::stringstream errorString;
-			errorString<<"The histogram indices (x/y/z)=("<<x[i]<<"/"<<y[i]<<"/"<<z[i]<<") are out of range.";
-			throw std::out_of_range(errorString.str());
+	histogram(x, y, z, rWeights, rSize, rNbinsX, rNbinsY, rNbinsZ, rResult, rNthreads);
+}
+
+//serial correlation of the sorted key entries [rFirstOne, rLastOne) of table one and [rFirstTwo, rLastTwo) of table two, every pair of entries with equal keys is added to the bin (slice, index one, index two) of rHist
+template<class TIndex, class TBin> void correlateSortedArrays(const int64_t* rKeysOne, const TIndex* rIndexOne, const unsigned int* rSliceOne, const unsigned int& rFirstOne, const unsigned int& rLastOne, const int64_t* rKeysTwo, const TIndex* rIndexTwo, const unsigned int& rFirstTwo, const unsigned int& rLastTwo, const unsigned int& rNbinsOne, const unsigned int& rNbinsTwo, TBin* rHist)
+{
+	const bool tGallop = useGalloping(rLastOne - rFirstOne, rLastTwo - rFirstTwo);
+	unsigned int i = rFirstOne;
+	unsigned int j = rFirstTwo;
+	while (i < rLastOne && j < rLastTwo){
+		if (rKeysOne[i] < rKeysTwo[j])
+			i = advanceSorted(rKeysOne, i, rLastOne, rKeysTwo[j], false, tGallop);
+		else if (rKeysTwo[j] < rKeysOne[i])
+			j = advanceSorted(rKeysTwo, j, rLastTwo, rKeysOne[i], false, tGallop);
+		else{
+			unsigned int tEndOne = advanceSorted(rKeysOne, i, rLastOne, rKeysOne[i], true, tGallop);
+			unsigned int tEndTwo = advanceSorted(rKeysTwo, j, rLastTwo, rKeysTwo[j], true, tGallop);
+			for (; i < tEndOne; ++i){
+				TBin* tRow = rHist + ((size_t) (rSliceOne != 0 ? rSliceOne[i] : 0) * rNbinsOne + (size_t) rIndexOne[i]) * rNbinsTwo;
+				for (unsigned int k = j; k < tEndTwo; ++k){
+					if (!addEntry(tRow[rIndexTwo[k]])){
+						--tRow[rIndexTwo[k]];
+						throw std::out_of_range("The histogram has more than 4294967295 entries per bin. This is not supported.");
+					}
+				}
+			}
+			j = tEndTwo;
 		}
-		if (rResult[x[i] * rNbinsY * rNbinsZ + y[i] * rNbinsZ + z[i]] < 4294967295)
-			++rResult[x[i] * rNbinsY * rNbinsZ + y[i] * rNbinsZ + z[i]];
-		else
-			throw std::out_of_range("The histogram has more than 4294967295 entries per bin. This is not supported.");
 	}
 }
 
-// fast mapping of cluster hits to event numbers
-void mapCluster(int64_t*& rEventArray, const unsigned int& rEventArraySize, ClusterInfo*& rClusterInfo, const unsigned int& rClusterInfoSize, ClusterInfo*& rMappedClusterInfo, const unsigned int& rMappedClusterInfoSize)
+//returns the first entry with an index >= rNbins (negative indices become large) or rSize
+template<class TIndex> unsigned int findInvalidIndex(const TIndex* rIndex, const unsigned int& rSize, const unsigned int& rNbins)
 {
-	unsigned int j = 0;
-	for (unsigned int i = 0; i < rEventArraySize; ++i){
-		for (; j < rClusterInfoSize; ++j){
-			if (rClusterInfo[j].event_number == rEventArray[i]){
-				if (i < rEventArraySize){
-					rMappedClusterInfo[i] = rClusterInfo[j];
-					++i;
+	for (unsigned int i = 0; i < rSize; ++i){
+		if ((uint64_t) (int64_t) rIndex[i] >= rNbins)
+			return i;
+	}
+	return rSize;
+}
+
+//correlation histogram of two tables sorted by key, e.g. the columns (or rows) of the hits of two telescope planes with the event number as key
+//every pair of entries with equal keys is added to the bin (slice, index one, index two) of rResult (C order) without creating the pairs; rSliceOne: slice of each entry of table one, e.g. a time slice, 0: one slice
+//parallel: every thread correlates one merge path part into a partial histogram, the partial histograms are added bin by bin; the threads are limited as in histogram
+template<class TIndex, class TBin> void correlationHistogram(const int64_t* rKeysOne, const TIndex* rIndexOne, const unsigned int* rSliceOne, const unsigned int& rSizeOne, const int64_t* rKeysTwo, const TIndex* rIndexTwo, const unsigned int& rSizeTwo, const unsigned int& rNbinsOne, const unsigned int& rNbinsTwo, const unsigned int& rNslices, TBin* rResult, const unsigned int& rNthreads = 1)
+{
+	typedef typename HistogramSum<TBin>::Type TSum;
+	unsigned int tInvalidOne = findInvalidIndex(rIndexOne, rSizeOne, rNbinsOne);
+	unsigned int tInvalidTwo = findInvalidIndex(rIndexTwo, rSizeTwo, rNbinsTwo);
+	unsigned int tInvalidSlice = rSliceOne != 0 ? findInvalidIndex(rSliceOne, rSizeOne, rNslices) : rSizeOne;
+	if (tInvalidOne != rSizeOne || tInvalidTwo != rSizeTwo || tInvalidSlice != rSizeOne){
+		std::stringstream errorString;
+		errorString<<"The correlation indices (one/two/slice)=("<<(tInvalidOne != rSizeOne ? (int64_t) rIndexOne[tInvalidOne] : 0)<<"/"<<(tInvalidTwo != rSizeTwo ? (int64_t) rIndexTwo[tInvalidTwo] : 0)<<"/"<<(tInvalidSlice != rSizeOne ? rSliceOne[tInvalidSlice] : 0)<<") are out of range.";
+		throw std::out_of_range(errorString.str());
+	}
+	const uint64_t tNbins = (uint64_t) rNbinsOne * (uint64_t) rNbinsTwo * (uint64_t) rNslices;
+	const uint64_t tSize = (uint64_t) rSizeOne + (uint64_t) rSizeTwo;
+	unsigned int tNparts = getNanalysisThreads(rNthreads, tSize);
+	if (tNbins != 0)
+		tNparts = (unsigned int) std::max((uint64_t) 1, std::min((uint64_t) tNparts, tSize / tNbins));
+	if (tNparts == 1){
+		correlateSortedArrays(rKeysOne, rIndexOne, rSliceOne, 0, rSizeOne, rKeysTwo, rIndexTwo, 0, rSizeTwo, rNbinsOne, rNbinsTwo, rResult);
+		return;
+	}
+	std::vector<unsigned int> tSplitOne, tSplitTwo;
+	splitSortedArrays(rKeysOne, rSizeOne, rKeysTwo, rSizeTwo, tNparts, tSplitOne, tSplitTwo);
+	std::vector<TSum> tPartial((size_t) tNbins * tNparts, 0);
+#pragma omp parallel for num_threads((int) tNparts)
+	for (int t = 0; t < (int) tNparts; ++t)
+		correlateSortedArrays(rKeysOne, rIndexOne, rSliceOne, tSplitOne[t], tSplitOne[t + 1], rKeysTwo, rIndexTwo, tSplitTwo[t], tSplitTwo[t + 1], rNbinsOne, rNbinsTwo, &tPartial[(size_t) tNbins * t]);  // cannot overflow
+	addPartialHistograms(tPartial, tNbins, tNparts, rResult);
+}
+
+//serial join of the sorted key entries [rFirstOne, rLastOne) of table one and [rFirstTwo, rLastTwo) of table two, rMode: __JOIN_INNER/LEFT/PAIRWISE
+//writes the index pairs to rIndexOne/rIndexTwo (-1: no match in table two) and returns the number of pairs; rIndexOne = 0: only counts
+uint64_t joinSortedArrays(const int64_t* rKeysOne, const unsigned int& rFirstOne, const unsigned int& rLastOne, const int64_t* rKeysTwo, const unsigned int& rFirstTwo, const unsigned int& rLastTwo, const unsigned int& rMode, int64_t* rIndexOne, int64_t* rIndexTwo)
+{
+	const bool tGallop = useGalloping(rLastOne - rFirstOne, rLastTwo - rFirstTwo);
+	uint64_t tNpairs = 0;
+	unsigned int i = rFirstOne;
+	unsigned int j = rFirstTwo;
+	while (i < rLastOne){
+		if (j < rLastTwo && rKeysTwo[j] < rKeysOne[i]){
+			j = advanceSorted(rKeysTwo, j, rLastTwo, rKeysOne[i], false, tGallop);
+			continue;
+		}
+		if (j == rLastTwo || rKeysOne[i] < rKeysTwo[j]){  // entries of table one without match
+			unsigned int tEnd = j == rLastTwo ? rLastOne : advanceSorted(rKeysOne, i, rLastOne, rKeysTwo[j], false, tGallop);
+			if (rMode != __JOIN_INNER){
+				for (; i < tEnd; ++i, ++tNpairs){
+					if (rIndexOne != 0){
+						rIndexOne[tNpairs] = i;
+						rIndexTwo[tNpairs] = -1;
+					}
+				}
+			}
+			i = tEnd;
+			continue;
+		}
+		unsigned int tEndOne = advanceSorted(rKeysOne, i, rLastOne, rKeysOne[i], true, tGallop);  // the entries of one key
+		unsigned int tEndTwo = advanceSorted(rKeysTwo, j, rLastTwo, rKeysTwo[j], true, tGallop);
+		if (rMode == __JOIN_PAIRWISE){
+			for (unsigned int k = 0; i + k < tEndOne; ++k, ++tNpairs){
+				if (rIndexOne != 0){
+					rIndexOne[tNpairs] = i + k;
+					rIndexTwo[tNpairs] = j + k < tEndTwo ? (int64_t) (j + k) : -1;
 				}
-				else
-					return;
 			}
-			else
-				break;
 		}
+		else if (rIndexOne == 0)
+			tNpairs += (uint64_t) (tEndOne - i) * (uint64_t) (tEndTwo - j);
+		else{
+			for (unsigned int k = i; k < tEndOne; ++k){
+				for (unsigned int l = j; l < tEndTwo; ++l, ++tNpairs){
+					rIndexOne[tNpairs] = k;
+					rIndexTwo[tNpairs] = l;
+				}
+			}
+		}
+		i = tEndOne;
+		j = tEndTwo;
 	}
+	return tNpairs;
 }
 
+//join of two tables sorted by key, e.g. the event number columns of hit, cluster or event tables, rMode: __JOIN_INNER, __JOIN_LEFT or __JOIN_PAIRWISE
+//writes the index pairs sorted by index one to rIndexOne/rIndexTwo (-1: no match in table two) and returns the number of pairs; rIndexOne = 0: only counts the pairs
+//parallel: every thread joins one merge path part, the pairs are counted first and then written at the prefix sum of the counts
+uint64_t joinSorted(const int64_t* rKeysOne, const unsigned int& rSizeOne, const int64_t* rKeysTwo, const unsigned int& rSizeTwo, const unsigned int& rMode, int64_t* rIndexOne, int64_t* rIndexTwo, const uint64_t& rResultSize, const unsigned int& rNthreads = 1)
+{
+	if (rMode != __JOIN_INNER && rMode != __JOIN_LEFT && rMode != __JOIN_PAIRWISE)
+		throw std::invalid_argument("Unknown join mode.");
+	const unsigned int tNparts = getNanalysisThreads(rNthreads, (uint64_t) rSizeOne + (uint64_t) rSizeTwo);
+	std::vector<unsigned int> tSplitOne, tSplitTwo;
+	splitSortedArrays(rKeysOne, rSizeOne, rKeysTwo, rSizeTwo, tNparts, tSplitOne, tSplitTwo);
+	std::vector<uint64_t> tOffset(tNparts + 1, 0);
+#pragma omp parallel for num_threads((int) tNparts)
+	for (int t = 0; t < (int) tNparts; ++t)
+		tOffset[t + 1] = joinSortedArrays(rKeysOne, tSplitOne[t], tSplitOne[t + 1], rKeysTwo, tSplitTwo[t], tSplitTwo[t + 1], rMode, 0, 0);
+	for (unsigned int t = 0; t < tNparts; ++t)
+		tOffset[t + 1] += tOffset[t];
+	if (rIndexOne == 0)
+		return tOffset[tNparts];
+	if (tOffset[tNparts] > rResultSize)
+		throw std::out_of_range("The join result arrays are too small.");
+#pragma omp parallel for num_threads((int) tNparts)
+	for (int t = 0; t < (int) tNparts; ++t)
+		joinSortedArrays(rKeysOne, tSplitOne[t], tSplitOne[t + 1], rKeysTwo, tSplitTwo[t], tSplitTwo[t + 1], rMode, rIndexOne + tOffset[t], rIndexTwo + tOffset[t]);
+	return tOffset[tNparts];
+}
 
+//copies the record rIndex[i] of rTable (records of rRecordSize bytes) to the record i of rResult, index -1: the record is set to 0
+void gatherRecords(const char* rTable, const size_t& rRecordSize, const unsigned int& rTableSize, const int64_t* rIndex, const unsigned int& rSize, char* rResult, const unsigned int& rNthreads = 1)
+{
+	for (unsigned int i = 0; i < rSize; ++i){
+		if (rIndex[i] < -1 || rIndex[i] >= (int64_t) rTableSize)
+			throw std::out_of_range("The record index is out of range.");
+	}
+	const unsigned int tNthreads = getNanalysisThreads(rNthreads, rSize);
+#pragma omp parallel for num_threads((int) tNthreads)
+	for (int t = 0; t < (int) tNthreads; ++t){
+		for (size_t i = (uint64_t) rSize * t / tNthreads; i < (uint64_t) rSize * (t + 1) / tNthreads; ++i){
+			if (rIndex[i] == -1)
+				std::fill(rResult + i * rRecordSize, rResult + (i + 1) * rRecordSize, 0);
+			else
+				std::copy(rTable + (size_t) rIndex[i] * rRecordSize, rTable + ((size_t) rIndex[i] + 1) * rRecordSize, rResult + i * rRecordSize);
+		}
+	}
+}
 
+//serial pairwise join of the event entries [rFirstEvent, rLastEvent) with the cluster infos [rFirstCluster, rLastCluster) on their event numbers, see mapCluster
+void mapClusterRange(const int64_t* rEventArray, const unsigned int& rFirstEvent, const unsigned int& rLastEvent, const ClusterInfo* rClusterInfo, const unsigned int& rFirstCluster, const unsigned int& rLastCluster, ClusterInfo* rMappedClusterInfo)
+{
+	const bool tGallop = useGalloping(rLastEvent - rFirstEvent, rLastCluster - rFirstCluster);
+	unsigned int i = rFirstEvent;
+	unsigned int j = rFirstCluster;
+	while (i < rLastEvent && j < rLastCluster){
+		if (eventNumber(rClusterInfo[j]) < rEventArray[i])
+			j = advanceSorted(rClusterInfo, j, rLastCluster, rEventArray[i], false, tGallop);
+		else if (rEventArray[i] < eventNumber(rClusterInfo[j]))
+			i = advanceSorted(rEventArray, i, rLastEvent, eventNumber(rClusterInfo[j]), false, tGallop);
+		else{  // the n-th entry of the event gets the n-th cluster of the event
+			const int64_t tEventNumber = rEventArray[i];
+			for (; i < rLastEvent && rEventArray[i] == tEventNumber && j < rLastCluster && eventNumber(rClusterInfo[j]) == tEventNumber; ++i, ++j)
+				rMappedClusterInfo[i] = rClusterInfo[j];
+			i = advanceSorted(rEventArray, i, rLastEvent, tEventNumber, true, tGallop);
+			j = advanceSorted(rClusterInfo, j, rLastCluster, tEventNumber, true, tGallop);
+		}
+	}
+}
+
+// fast mapping of cluster hits to event numbers: the n-th cluster of an event is copied to the n-th entry of the event in the event array, the other entries are not changed
+void mapCluster(int64_t*& rEventArray, const unsigned int& rEventArraySize, ClusterInfo*& rClusterInfo, const unsigned int& rClusterInfoSize, ClusterInfo*& rMappedClusterInfo, const unsigned int& rMappedClusterInfoSize, const unsigned int& rNthreads = 1)
+{
+	if (rMappedClusterInfoSize < rEventArraySize)
+		throw std::out_of_range("The mapped cluster array is smaller than the event array.");
+	const unsigned int tNparts = getNanalysisThreads(rNthreads, (uint64_t) rEventArraySize + (uint64_t) rClusterInfoSize);
+	std::vector<unsigned int> tSplitEvents, tSplitCluster;
+	splitSortedArrays(rEventArray, rEventArraySize, rClusterInfo, rClusterInfoSize, tNparts, tSplitEvents, tSplitCluster);
+#pragma omp parallel for num_threads((int) tNparts)
+	for (int t = 0; t < (int) tNparts; ++t)
+		mapClusterRange(rEventArray, tSplitEvents[t], tSplitEvents[t + 1], rClusterInfo, tSplitCluster[t], tSplitCluster[t + 1], rMappedClusterInfo);
+}
@@ -1,5 +1,16 @@
 #include "Histogram.h"
 
+#if defined(_MSC_VER) && _MSC_VER < 1800
+//no C99 erf before VS 2013, complementary error function approximation with a fractional error < 1.2e-7 (Numerical Recipes)
+static double erf(double x)
+{
+	double z = fabs(x);
+	double t = 1. / (1. + 0.5 * z);
+	double erfc = t * exp(-z * z - 1.26551223 + t * (1.00002368 + t * (0.37409196 + t * (0.09678418 + t * (-0.18628806 + t * (0.27886807 + t * (-1.13520398 + t * (1.48851587 + t * (-0.82215223 + t * 0.17087277)))))))));
+	return x >= 0. ? 1. - erfc : erfc - 1.;
+}
+#endif
+
 Histogram::Histogram(void)
 {
   setSourceFileName("Histogram()");
@@ -11,12 +22,14 @@ Histogram::~Histogram(void)
 {
 	debug("~Histogram()");
 	deleteOccupancyArray();
+	deleteMeanTotArray();
 	deleteTotArray();
 	deleteTdcArray();
 	deleteTdcTriggerDistanceArray();
 	deleteRelBcidArray();
 	deleteTotPixelArray();
 	deleteTdcPixelArray();
+	deleteTdcPixelMomentsArray();
 }
 
 void Histogram::setStandardSettings()
@@ -26,14 +39,21 @@ void Histogram::setStandardSettings()
 	_parInfo = 0;
 	_lastMetaEventIndex = 0;
 	_metaEventIndex = 0;
-	_occupancy = 0;
+	_occupancyExport = 0;
 	_relBcid = 0;
 	_tot = 0;
 	_meanTot = 0;
+	_totRms = 0;
 	_tdc = 0;
 	_tdcTriggerDistance = 0;
-	_totPixel = 0;
-	_tdcPixel = 0;
+	_tdcPixelExport = 0;
+	_tdcPixelCount = 0;
+	_tdcPixelSum = 0;
+	_tdcPixelSquareSum = 0;
+	_tdcPixelMin = 0;
+	_tdcPixelMax = 0;
+	_tdcPixelBinWidth = 1;
+	_sparseTdcPixelHist = false;
 	_NparameterValues = 1;
 	_createOccHist = false;
 	_createRelBCIDhist = false;
@@ -43,7 +63,44 @@ void Histogram::setStandardSettings()
 	_createTdcTriggerDistanceHist = false;
 	_createTdcPixelHist = false;
 	_createTotPixelHist = false;
+	_createTdcPixelMoments = false;
+	_createDecayingOccupancyHist = false;
+	_decayHalfLife = 10000.;
+	_decayOrigin = 0.;
+	_decayEventNumber = 0.;
+	_decayStarted = false;
+	_createTimeHist = false;
+	_timeHistBinWidth = 1.;
+	_nTimeHistBins = 3600;
+	_nTimeHistColumnRegions = 1;
+	_nTimeHistRowRegions = 1;
+	_lastTimeReadoutIndex = 0;
+	_timeHistFirstBin = 0;
+	_timeHistLastBin = -1;
+	_timeHistLastEventNumber = -1;
+	_timeHistOrigin = 0.;
+	_timeHistOriginSet = false;
+	_nTimeHistLostHits = 0;
+	_sparseOccupancy = false;
+	_pixelMajorOccupancy = false;
+	_resumeStorage = false;
+	_nChips = 1;
+	_nColumns = RAW_DATA_MAX_COLUMN;
+	_nRows = RAW_DATA_MAX_ROW;
+	_occupancyPixelStride = 1;
+	_occupancyParStride = (size_t)_nColumns * (size_t)_nRows;
 	_maxTot = 13;
+	_nThreads = 0;
+	_liveNsteps = 0;
+	_createSnapshots = false;
+	_snapshotIndex = 0;
+	_snapshotReady = 1;
+	_snapshotWork = 2;
+	_snapshotFresh = false;
+	_nSnapshots = 0;
+	_liveMaxInjections = 0;
+	_liveMaxParameter = 0;
+	_liveParameterStep = 0;
 }
 
 void Histogram::createOccupancyHist(bool CreateOccHist)
@@ -78,8 +135,11 @@ void Histogram::createTotHist(bool CreateTotHist)
 void Histogram::createMeanTotHist(bool CreateMeanTotHist)
 {
 	_createMeanTotHist = CreateMeanTotHist;
-	if (_createMeanTotHist)
+	if (_createMeanTotHist){
 		createOccupancyHist(true);
+		if (_occupancy.allocated() && !_totSum.allocated())  // the scan parameters are already set
+			allocateMeanTotArray();
+	}
 	else
 		deleteMeanTotArray();
 }
@@ -111,399 +171,1303 @@ void Histogram::createTdcPixelHist(bool CreateTdcPixelHist)
 	_createTdcPixelHist = CreateTdcPixelHist;
 	if (_createTdcPixelHist){
 		allocateTdcPixelArray();
-		resetTdcPixelArray();
 	}
 	else
 		deleteTdcPixelArray();
 }
 
-void Histogram::createTotPixelHist(bool CreateTotPixelHist)
+void Histogram::createTdcPixelMoments(bool CreateTdcPixelMoments)
 {
-	_createTotPixelHist = CreateTotPixelHist;
-	if (_createTotPixelHist){
-		allocateTotPixelArray();
-		resetTotPixelArray();
+	_createTdcPixelMoments = CreateTdcPixelMoments;
+	if (_createTdcPixelMoments){
+		allocateTdcPixelMomentsArray();
+		resetTdcPixelMomentsArray();
 	}
 	else
-		deleteTotPixelArray();
+		deleteTdcPixelMomentsArray();
 }
 
-void Histogram::setMaxTot(const unsigned int& rMaxTot)
+void Histogram::createDecayingOccupancyHist(bool CreateDecayingOccupancyHist)
 {
-	_maxTot = rMaxTot;
+	_createDecayingOccupancyHist = CreateDecayingOccupancyHist;
+	if (_createDecayingOccupancyHist)
+		resetDecayingOccupancyArray();
+	else{
+		std::vector<double>().swap(_decayingOccupancy);
+		std::vector<double>().swap(_decayTileFactor);
+	}
 }
 
-void Histogram::addHits(HitInfo*& rHitInfo, const unsigned int& rNhits)
+void Histogram::setOccupancyHalfLife(const double& rHalfLife)
 {
-	debug("addHits()");
-	for(unsigned int i = 0; i<rNhits; ++i){
-		if ((rHitInfo[i].event_status & __NO_HIT) == __NO_HIT) // ignore virtual hits
-			continue;
-		unsigned short tColumnIndex = rHitInfo[i].column-1;
-		if(tColumnIndex > RAW_DATA_MAX_COLUMN-1)
-			throw std::out_of_range("Column index out of range.");
-		unsigned int tRowIndex = rHitInfo[i].row-1;
-		if(tRowIndex > RAW_DATA_MAX_ROW-1)
-			throw std::out_of_range("Row index out of range.");
-		unsigned int tTot = rHitInfo[i].tot;
-		if(tTot > 15)
-			throw std::out_of_range("ToT index out of range.");
-		unsigned int tTdc = rHitInfo[i].TDC;
-		if(tTdc >= __N_TDC_VALUES)
-			throw std::out_of_range("TDC value " + IntToStr(tTdc) + " index out of range.");
-		unsigned int tTdcTriggerDistance = rHitInfo[i].TDC_time_stamp; // when using TDC trigger distance, use TDC timestamp 
-		if(tTdcTriggerDistance >= __N_TDC_DIST_VALUES)
-			throw std::out_of_range("TDC distance " + IntToStr(tTdc) + " index out of range.");
-		unsigned int tRelBcid = rHitInfo[i].relative_BCID;
-		if(tRelBcid >= __MAXBCID)
-			throw std::out_of_range("Relative BCID index out of range.");
-
-		unsigned int tParIndex = getParIndex(rHitInfo[i].event_number);
-//		std::cout<<i<<" tParIndex "<<tParIndex<<" rHitInfo[i].event_number "<<rHitInfo[i].event_number<<"\n";
-
-		if(tParIndex >= getNparameters()){
-			error("addHits: tParIndex "+IntToStr(tParIndex)+"\t> "+IntToStr(_NparameterValues));
-			throw std::out_of_range("Parameter index out of range.");
-		}
-		if(_createOccHist){
-			if(tTot <= _maxTot){
-				if(_occupancy!=0)
-					_occupancy[(size_t)tColumnIndex + (size_t)tRowIndex * (size_t)RAW_DATA_MAX_COLUMN + (size_t)tParIndex * (size_t)RAW_DATA_MAX_COLUMN * (size_t)RAW_DATA_MAX_ROW] += 1;
-				else
-					throw std::runtime_error("Occupancy array not initialized. Set scan parameter first!.");
-				if(_createMeanTotHist){
-					if(_meanTot!=0){
-						float tOccupancy = (float)_occupancy[(size_t)tColumnIndex + (size_t)tRowIndex * (size_t)RAW_DATA_MAX_COLUMN + (size_t)tParIndex * (size_t)RAW_DATA_MAX_COLUMN * (size_t)RAW_DATA_MAX_ROW];
-						float tMeanTot = _meanTot[(size_t)tColumnIndex + (size_t)tRowIndex * (size_t)RAW_DATA_MAX_COLUMN + (size_t)tParIndex * (size_t)RAW_DATA_MAX_COLUMN * (size_t)RAW_DATA_MAX_ROW];
-						if(tMeanTot != tMeanTot) // check for NAN, _meanTot initialized with NAN
-							tMeanTot = 0.0;
-						_meanTot[(size_t)tColumnIndex + (size_t)tRowIndex * (size_t)RAW_DATA_MAX_COLUMN + (size_t)tParIndex * (size_t)RAW_DATA_MAX_COLUMN * (size_t)RAW_DATA_MAX_ROW] = (tMeanTot * (tOccupancy - 1) + tTot)/tOccupancy;
-					}
-					else
-						throw std::runtime_error("Mean ToT array not initialized. Set scan parameter first!.");
-				}
-			}
-		}
-		if(_createRelBCIDhist)
-			if(tTot <= _maxTot)
-				_relBcid[tRelBcid] += 1;
-		if(_createTotHist)
-			if(tTot <= _maxTot) //not sure if cut on ToT histogram is unwanted here
-				_tot[tTot] += 1;
-		if(_createTdcHist)
-			_tdc[tTdc] += 1;
-		if(_createTdcTriggerDistanceHist)
-			_tdcTriggerDistance[tTdcTriggerDistance] += 1;
-		if(_createTdcPixelHist){
-			if (_tdcPixel != 0){
-				 if(tTdc >= __N_TDC_PIXEL_VALUES){
-					info("TDC value out of range:" + IntToStr(tTdc) + ">" + IntToStr(__N_TDC_PIXEL_VALUES));
-					tTdc = 0;
-				}
-				_tdcPixel[(size_t)tColumnIndex + (size_t)tRowIndex * (size_t)RAW_DATA_MAX_COLUMN + (size_t)tTdc * (size_t)RAW_DATA_MAX_COLUMN * (size_t)RAW_DATA_MAX_ROW] += 1;
-			}
-			else
-				throw std::runtime_error("Output TDC pixel array array not set.");
-		}
-		if(_createTotPixelHist){
-			if (tTot <= _maxTot)
-				_totPixel[(size_t)tColumnIndex + (size_t)tRowIndex * (size_t)RAW_DATA_MAX_COLUMN + (size_t)tTot * (size_t)RAW_DATA_MAX_COLUMN * (size_t)RAW_DATA_MAX_ROW] += 1;
-		}
-	}
-	//std::cout<<"addHits done"<<std::endl;
+	if(!(rHalfLife > 0.))
+		throw std::invalid_argument("Occupancy half life has to be > 0.");
+	_decayHalfLife = rHalfLife;
+	resetDecayingOccupancyArray();
 }
 
-void Histogram::addClusterSeedHits(ClusterInfo*& rClusterInfo, const unsigned int& rNcluster)
+double Histogram::getOccupancyHalfLife()
 {
-	if(Basis::debugSet())
-		debug("addClusterSeedHits(...,rNcluster="+IntToStr(rNcluster)+")");
-	for(unsigned int i = 0; i<rNcluster; ++i){
-		unsigned short tColumnIndex = rClusterInfo[i].seed_column-1;
-		if(tColumnIndex > RAW_DATA_MAX_COLUMN-1)
-			throw std::out_of_range("Column index out of range.");
-		unsigned int tRowIndex = rClusterInfo[i].seed_row-1;
-		if(tRowIndex > RAW_DATA_MAX_ROW-1)
-			throw std::out_of_range("Row index out of range.");
-
-		unsigned int tParIndex = getParIndex(rClusterInfo[i].event_number);
+	return _decayHalfLife;
+}
 
-		if(tParIndex >= getNparameters()){
-			error("addHits: tParIndex "+IntToStr(tParIndex)+"\t> "+IntToStr(_NparameterValues));
-			throw std::out_of_range("Parameter index out of range.");
-		}
-		if(_createOccHist){
-			if(_occupancy!=0)
-				_occupancy[(size_t)tColumnIndex + (size_t)tRowIndex * (size_t)RAW_DATA_MAX_COLUMN + (size_t)tParIndex * (size_t)RAW_DATA_MAX_COLUMN * (size_t)RAW_DATA_MAX_ROW] += 1;
-			else
-				throw std::runtime_error("Occupancy array not initialized. Set scan parameter first!.");
-		}
+void Histogram::createTimeHist(bool CreateTimeHist)
+{
+	_createTimeHist = CreateTimeHist;
+	if (_createTimeHist){
+		_timeHistEvents.assign(_nTimeHistBins, 0);
+		_timeHistHits.assign(_nTimeHistBins, 0);
+		_timeHistTdc.assign(_nTimeHistBins, 0);
+		_timeHistErrors.assign((size_t)_nTimeHistBins * __N_ERROR_CODES, 0);
+		_timeHistRegions.assign((size_t)_nTimeHistBins * _nTimeHistColumnRegions * _nTimeHistRowRegions, 0);
+		resetTimeHist();
+	}
+	else{
+		std::vector<unsigned int>().swap(_timeHistEvents);
+		std::vector<unsigned int>().swap(_timeHistHits);
+		std::vector<unsigned int>().swap(_timeHistTdc);
+		std::vector<unsigned int>().swap(_timeHistErrors);
+		std::vector<unsigned int>().swap(_timeHistRegions);
 	}
 }
 
-unsigned int Histogram::getParIndex(int64_t& rEventNumber)
+void Histogram::setTimeHistBinning(const double& rBinWidth, const unsigned int& rNbins, const unsigned int& rNcolumnRegions, const unsigned int& rNrowRegions)
 {
-  if(_parInfo == 0)
-    return 0;
-  for(uint64_t i=_lastMetaEventIndex; i<_nMetaEventIndexLength-1; ++i){
-    if(_metaEventIndex[i+1] > (uint64_t) rEventNumber || _metaEventIndex[i+1] < _metaEventIndex[i]){ // second case: meta event data not set yet (std value = 0), event number has to increase
-      _lastMetaEventIndex = i;
-      if (i < _nParInfoLength)
-      	return _parInfo[i];
-      else{
-    	  error("Scan parameter index " + LongIntToStr(i) + " out of range");
-    	  throw std::out_of_range("Scan parameter index out of range.");
-      }
-    }
-  }
-  if(_metaEventIndex[_nMetaEventIndexLength-1] <= (uint64_t) rEventNumber) //last read outs
-    return _parInfo[_nMetaEventIndexLength-1];
-  error("getScanParameter: Correlation issues at event "+LongIntToStr(rEventNumber)+"\n_metaEventIndex[_nMetaEventIndexLength-1] "+LongIntToStr(_metaEventIndex[_nMetaEventIndexLength-1])+"\n_lastMetaEventIndex "+LongIntToStr(_lastMetaEventIndex));
-  throw std::logic_error("Event parameter correlation issues.");
-  return 0;
+	if(!(rBinWidth > 0.) || rNbins == 0)
+		throw std::invalid_argument("Time histogram bin width and number of bins have to be > 0.");
+	if(rNcolumnRegions == 0 || rNrowRegions == 0)
+		throw std::invalid_argument("Number of time histogram regions has to be > 0.");
+	_timeHistBinWidth = rBinWidth;
+	_nTimeHistBins = rNbins;
+	_nTimeHistColumnRegions = rNcolumnRegions;
+	_nTimeHistRowRegions = rNrowRegions;
+	if (_createTimeHist)  // the histograms are reallocated with the new binning, the content is lost
+		createTimeHist(true);
 }
 
-void Histogram::addScanParameter(int*& rParInfo, const unsigned int& rNparInfoLength)
+void Histogram::setTdcPixelHistBinWidth(const unsigned int& rBinWidth)
 {
-	debug("addScanParameter");
-	_nParInfoLength = rNparInfoLength;
-	_parInfo = rParInfo;
-
-	std::vector<unsigned int> tParameterValues;
-
-	for(unsigned int i = 0; i < _nParInfoLength; ++i)
-	  tParameterValues.push_back(_parInfo[i]);
-
-	std::sort(tParameterValues.begin(), tParameterValues.end());  //sort from lowest to highest value
-	std::set<unsigned int> tSet(tParameterValues.begin(), tParameterValues.end());  // delete duplicates
-	tParameterValues.assign(tSet.begin(), tSet.end() );
-
-	for(unsigned int i = 0; i < tParameterValues.size(); ++i)
-		_parameterValues[tParameterValues[i]] = i;
-
-	_NparameterValues = (unsigned int) tSet.size();
-
-	if (_createOccHist){
-		allocateOccupancyArray();
-		resetOccupancyArray();
-		if (_createMeanTotHist){
-			allocateMeanTotArray();
-			resetMeanTotArray();
-		}
-	}
-	if (Basis::debugSet()){
-	  for(unsigned int i=0; i<_nParInfoLength; ++i)
-		 std::cout<<"index "<<i<<"\t parameter index "<<_parInfo[i]<<"\n";
+	if(rBinWidth == 0 || __N_TDC_PIXEL_VALUES % rBinWidth != 0)
+		throw std::invalid_argument("TDC pixel histogram bin width has to divide " + IntToStr(__N_TDC_PIXEL_VALUES) + ".");
+	_tdcPixelBinWidth = rBinWidth;
+	if (_createTdcPixelHist){  // the histogram is reallocated with the new binning, the content is lost
+		allocateTdcPixelArray();
 	}
 }
 
-void Histogram::addMetaEventIndex(uint64_t*& rMetaEventIndex, const unsigned int& rNmetaEventIndexLength)
+unsigned int Histogram::getNtdcPixelHistBins()
 {
-  debug("addMetaEventIndex()");
-  _nMetaEventIndexLength = rNmetaEventIndexLength;
-  _metaEventIndex = rMetaEventIndex;
-  if (Basis::debugSet())
-	  for(unsigned int i=0; i<_nMetaEventIndexLength; ++i)
-		 std::cout<<"index "<<i<<"\t event number "<<_metaEventIndex[i]<<"\n";
+	return __N_TDC_PIXEL_VALUES / _tdcPixelBinWidth;
 }
 
-void Histogram::allocateOccupancyArray()
+void Histogram::setSparseTdcPixelHist(bool SparseTdcPixelHist)
 {
-  debug("allocateOccupancyArray() with "+IntToStr(getNparameters())+" parameters");
-  deleteOccupancyArray();
-  try{
-    _occupancy = new unsigned int[(size_t)RAW_DATA_MAX_COLUMN * (size_t)RAW_DATA_MAX_ROW * (size_t)getNparameters()];
-  }
-  catch(std::bad_alloc& exception){
-    error(std::string("allocateOccupancyArray: ")+std::string(exception.what()));
-  }
+	if(SparseTdcPixelHist && !_storageFileName.empty())
+		throw std::invalid_argument("Memory-mapped histograms cannot be sparse.");
+	_sparseTdcPixelHist = SparseTdcPixelHist;
+	if (_createTdcPixelHist){  // the histogram is reallocated with the new storage, the content is lost
+		allocateTdcPixelArray();
+	}
 }
 
-void Histogram::deleteOccupancyArray()
+bool Histogram::getSparseTdcPixelHist()
 {
-  debug("deleteOccupancyArray()");
-  if (_occupancy != 0)
-    delete[] _occupancy;
-  _occupancy = 0;
+	return _sparseTdcPixelHist;
 }
 
-void Histogram::resetOccupancyArray()
+size_t Histogram::getTdcPixelHistMemory()
 {
-  info("resetOccupancyArray()");
-  if (_occupancy != 0){
-	  for (unsigned int i = 0; i < RAW_DATA_MAX_COLUMN; i++)
-		for (unsigned int j = 0; j < RAW_DATA_MAX_ROW; j++)
-		  for(unsigned int k = 0; k < getNparameters();k++)
-			  _occupancy[(size_t)i + (size_t)j * (size_t)RAW_DATA_MAX_COLUMN + (size_t)k * (size_t)RAW_DATA_MAX_COLUMN * (size_t)RAW_DATA_MAX_ROW] = 0;
-  }
+	return _tdcPixel.getMemory();
 }
 
-void Histogram::allocateMeanTotArray()
+void Histogram::createTotPixelHist(bool CreateTotPixelHist)
 {
-  debug("allocateMeanTotArray() with "+IntToStr(getNparameters())+" parameters");
-  deleteMeanTotArray();
-  try{
-    _meanTot = new float[(size_t)RAW_DATA_MAX_COLUMN * (size_t)RAW_DATA_MAX_ROW * (size_t)getNparameters()];
-  }
-  catch(std::bad_alloc& exception){
-    error(std::string("allocateMeanTotArray: ")+std::string(exception.what()));
-  }
+	_createTotPixelHist = CreateTotPixelHist;
+	if (_createTotPixelHist){
+		allocateTotPixelArray();
+		resetTotPixelArray();
+	}
+	else
+		deleteTotPixelArray();
 }
 
-void Histogram::deleteMeanTotArray()
+void Histogram::setMaxTot(const unsigned int& rMaxTot)
 {
-  debug("deleteMeanTotArray()");
-  if (_meanTot != 0)
-    delete[] _meanTot;
-  _meanTot = 0;
+	_maxTot = rMaxTot;
 }
 
-void Histogram::resetMeanTotArray()
+void Histogram::setSparseOccupancy(bool SparseOccupancy)
 {
-  info("resetMeanTotArray()");
-  if (_meanTot != 0){
-	  for (unsigned int i = 0; i < RAW_DATA_MAX_COLUMN; i++)
-		for (unsigned int j = 0; j < RAW_DATA_MAX_ROW; j++)
-		  for(unsigned int k = 0; k < getNparameters();k++)
-			  _meanTot[(size_t)i + (size_t)j * (size_t)RAW_DATA_MAX_COLUMN + (size_t)k * (size_t)RAW_DATA_MAX_COLUMN * (size_t)RAW_DATA_MAX_ROW] = NAN;
-  }
+	if(SparseOccupancy && !_storageFileName.empty())
+		throw std::invalid_argument("Memory-mapped histograms cannot be sparse.");
+	if(SparseOccupancy == _sparseOccupancy)
+		return;
+	_sparseOccupancy = SparseOccupancy;
+	if(_occupancy.allocated()){  // the histograms are reallocated with the new storage, the content is lost
+		warning("setSparseOccupancy: occupancy histograms are reset");
+		allocateOccupancyArray();
+		if(_totSum.allocated())
+			allocateMeanTotArray();
+	}
 }
 
-void Histogram::resetTdcPixelArray()
+bool Histogram::isMeanTotHist()
 {
-  info("resetTdcPixelArray()");
-  if (_createTdcPixelHist){
-	  if (_tdcPixel != 0){
-		  for (unsigned int i = 0; i < RAW_DATA_MAX_COLUMN; i++)
-			for (unsigned int j = 0; j < RAW_DATA_MAX_ROW; j++)
-			  for(unsigned int k = 0; k < __N_TDC_PIXEL_VALUES;k++)
-				  _tdcPixel[(size_t)i + (size_t)j * (size_t)RAW_DATA_MAX_COLUMN + (size_t)k * (size_t)RAW_DATA_MAX_COLUMN * (size_t)RAW_DATA_MAX_ROW] = 0;
-	  }
-	  else
-		  throw std::runtime_error("Output TDC pixel array array not set.");
-  }
+	return _occupancy.allocated() && _totSum.allocated();
 }
 
-void Histogram::resetTotPixelArray()
+bool Histogram::getSparseOccupancy()
 {
-  info("resetTotPixelArray()");
-  if (_createTotPixelHist){
-	  if (_totPixel != 0){
-		  for (unsigned int i = 0; i < RAW_DATA_MAX_COLUMN; i++)
-			for (unsigned int j = 0; j < RAW_DATA_MAX_ROW; j++)
-			  for(unsigned int k = 0; k < 16;k++)
-				  _totPixel[(size_t)i + (size_t)j * (size_t)RAW_DATA_MAX_COLUMN + (size_t)k * (size_t)RAW_DATA_MAX_COLUMN * (size_t)RAW_DATA_MAX_ROW] = 0;
-	  }
-	  else
-		  throw std::runtime_error("Output ToT pixel array array not set.");
-  }
+	return _sparseOccupancy;
 }
 
-void Histogram::allocateTotArray()
+size_t Histogram::getOccupancyMemory()
 {
-  debug("allocateTotArray()");
-  deleteTotArray();
-  try{
-    _tot = new unsigned int[16];
-  }
-  catch(std::bad_alloc& exception){
-    error(std::string("allocateTotArray: ")+std::string(exception.what()));
-  }
+	return _occupancy.getMemory() + _totSum.getMemory() + _totSquareSum.getMemory();
 }
 
-void Histogram::allocateTdcArray()
+void Histogram::setPixelMajorOccupancy(bool PixelMajorOccupancy)
 {
-	debug("allocateTdcArray()");
-	deleteTdcArray();
-	try{
-	_tdc = new unsigned int[__N_TDC_VALUES];
-	}
-	catch(std::bad_alloc& exception){
-	error(std::string("allocateTdcArray: ")+std::string(exception.what()));
+	if(PixelMajorOccupancy == _pixelMajorOccupancy)
+		return;
+	_pixelMajorOccupancy = PixelMajorOccupancy;
+	if(_occupancy.allocated()){  // the histograms are reallocated with the new layout, the content is lost
+		warning("setPixelMajorOccupancy: occupancy histograms are reset");
+		allocateOccupancyArray();
+		if(_totSum.allocated())
+			allocateMeanTotArray();
 	}
 }
 
-void Histogram::allocateTdcTriggerDistanceArray()
+bool Histogram::getPixelMajorOccupancy()
 {
-	debug("allocateTdcTriggerDistanceArray()");
-	deleteTdcTriggerDistanceArray();
-	try{
-	_tdcTriggerDistance = new unsigned int[__N_TDC_DIST_VALUES];
+	return _pixelMajorOccupancy;
+}
+
+void Histogram::setNchips(const unsigned int& rNchips)
+{
+	if(rNchips != 1 && rNchips != 2 && rNchips != 4)
+		throw std::invalid_argument("Module layout with " + IntToStr(rNchips) + " chips not supported, use 1, 2 or 4 chips.");
+	if(rNchips == _nChips)
+		return;
+	_nChips = rNchips;
+	_nColumns = RAW_DATA_MAX_COLUMN * (rNchips == 1 ? 1 : 2);
+	_nRows = RAW_DATA_MAX_ROW * (rNchips == 4 ? 2 : 1);
+	_liveM.clear();  // the incremental threshold estimation has to be started again
+	_liveMu1.clear();
+	_liveMu2.clear();
+	_liveSplit.clear();
+	if(_pixelMask.enabled()){
+		warning("setNchips: pixel mask of the old module layout cleared");
+		_pixelMask.clear();
 	}
-	catch(std::bad_alloc& exception){
-	error(std::string("allocateTdcTriggerDistanceArray: ")+std::string(exception.what()));
+	if(_occupancy.allocated() || _tdcPixel.allocated() || _totPixel.allocated() || _tdcPixelCount != 0 || !_decayingOccupancy.empty())  // the histograms are reallocated with the new geometry, the content is lost
+		warning("setNchips: pixel histograms are reset");
+	resetDecayingOccupancyArray();
+	clearSnapshots();  // the snapshots of the old layout cannot be returned with the new one
+	if(_occupancy.allocated()){
+		allocateOccupancyArray();
+		if(_totSum.allocated())
+			allocateMeanTotArray();
+	}
+	if(_tdcPixel.allocated())
+		allocateTdcPixelArray();
+	if(_totPixel.allocated())
+		allocateTotPixelArray();
+	if(_tdcPixelCount != 0){
+		allocateTdcPixelMomentsArray();
+		resetTdcPixelMomentsArray();
 	}
 }
 
-void Histogram::resetTotArray()
+void Histogram::setPixelMask(const unsigned char* rMask, const unsigned int& rNcolumns, const unsigned int& rNrows)
 {
-  info("resetTotArray()");
-  if (_createTotHist){
-	  if (_tot != 0){
-		  for (unsigned int i = 0; i < 16; i++)
-			_tot[(size_t)i] = 0;
-	  }
-  }
+	if(rNcolumns != _nColumns || rNrows != _nRows)
+		throw std::invalid_argument("Pixel mask has to have " + IntToStr(_nColumns) + " x " + IntToStr(_nRows) + " pixels.");
+	_pixelMask.set(rMask, rNcolumns, rNrows);
+	info("setPixelMask: " + IntToStr(_pixelMask.getNmasked()) + " pixels masked");
 }
 
-void Histogram::resetTdcArray()
+void Histogram::clearPixelMask()
 {
-  info("resetTdcArray()");
-  if (_createTdcHist){
-	  if (_tdc != 0){
-		  for (unsigned int i = 0; i < __N_TDC_VALUES; i++)
-			_tdc[(size_t)i] = 0;
-	  }
-  }
+	_pixelMask.clear();
 }
 
-void Histogram::resetTdcTriggerDistanceArray()
+void Histogram::getDroppedHits(unsigned int* rDroppedHits)
 {
-	info("resetTdcTriggerDistanceArray()");
-	if (_createTdcTriggerDistanceHist){
-		if (_tdcTriggerDistance != 0){
-			for (unsigned int i = 0; i < __N_TDC_DIST_VALUES; i++)
-			_tdcTriggerDistance[(size_t)i] = 0;
-		}
-	}
+	_pixelMask.getDropped(rDroppedHits, (size_t)_nColumns * (size_t)_nRows);
 }
-	
-void Histogram::deleteTotArray()
+
+uint64_t Histogram::getNdroppedHits()
 {
-  debug("deleteTotArray()");
-  if (_tot != 0)
-    delete[] _tot;
-  _tot = 0;
+	return _pixelMask.getNdropped();
 }
 
-void Histogram::deleteTdcArray()
+unsigned int Histogram::getNchips()
 {
-  debug("deleteTdcArray()");
-  if (_tdc != 0)
-    delete[] _tdc;
-  _tdc = 0;
+	return _nChips;
 }
 
-void Histogram::deleteTdcTriggerDistanceArray()
+unsigned int Histogram::getNcolumns()
 {
-	debug("deleteTdcTriggerDistanceArray()");
-	if (_tdcTriggerDistance != 0)
-	delete[] _tdcTriggerDistance;
-	_tdcTriggerDistance = 0;
+	return _nColumns;
 }
 
-void Histogram::allocateRelBcidArray()
+unsigned int Histogram::getNrows()
 {
-  debug("allocateRelBcidArray");
-  deleteRelBcidArray();
-  try{
-     _relBcid = new unsigned int[__MAXBCID];
-  }
-  catch(std::bad_alloc& exception){
-    error(std::string("allocateRelBcidArray: ")+std::string(exception.what()));
-  }
+	return _nRows;
 }
 
-void Histogram::resetRelBcidArray()
+void Histogram::setStorageFile(const std::string& rFileName, bool Resume)
+{
+	if(Resume && ((_occupancy.allocated() && !_occupancy.mapped()) || (_tdcPixel.allocated() && !_tdcPixel.mapped())))  // the file content would replace the histograms in memory
+		throw std::logic_error("Histograms in memory cannot be resumed from storage files, set the storage file before the histograms are enabled.");
+	_storageFileName = rFileName;
+	_resumeStorage = Resume;
+	if(!rFileName.empty()){  // the memory-mapped histograms are dense
+		_sparseOccupancy = false;
+		_sparseTdcPixelHist = false;
+	}
+	if(!Resume && (_occupancy.allocated() || _tdcPixel.allocated()))
+		warning("setStorageFile: histograms are reset");
+	if(_occupancy.allocated()){  // the histograms are reallocated with the new storage
+		allocateOccupancyArray();
+		if(_totSum.allocated())
+			allocateMeanTotArray();
+	}
+	if(_tdcPixel.allocated())
+		allocateTdcPixelArray();
+}
+
+std::string Histogram::getStorageFile()
+{
+	return _storageFileName;
+}
+
+void Histogram::setNthreads(const unsigned int& rNthreads)
+{
+	_nThreads = rNthreads;
+}
+
+unsigned int Histogram::getNthreads()
+{
+#ifdef _OPENMP
+	if (_nThreads == 0)
+		return (unsigned int) omp_get_max_threads();
+	return _nThreads;
+#else
+	return 1;
+#endif
+}
+
+void Histogram::addHits(HitInfo*& rHitInfo, const unsigned int& rNhits)
+{
+	debug("addHits()");
+	MutexLock tLock(_fillMutex);
+	fillHits(rHitInfo, rNhits);
+	if(_createSnapshots)  // also after the early returns of fillHits, the time histograms can change without real hits
+		publishSnapshot();
+}
+
+void Histogram::fillHits(HitInfo*& rHitInfo, const unsigned int& rNhits)
+{
+	//first all hits are checked, thus the histograms are only filled if the whole batch is valid
+	unsigned int tNrealHits = validateHits(rHitInfo, rNhits);
+	if (tNrealHits == 0 && !_createTimeHist)  // the time histograms also count events without hits
+		return;
+
+	if(_createOccHist && !_occupancy.allocated())
+		throw std::runtime_error("Occupancy array not initialized. Set scan parameter first!.");
+	if(_createOccHist && _createMeanTotHist && !_totSum.allocated())
+		throw std::runtime_error("Mean ToT array not initialized. Set scan parameter first!.");
+	if(_createTdcPixelHist && !_tdcPixel.allocated())
+		throw std::runtime_error("Output TDC pixel array array not set.");
+	if(_createTdcPixelMoments && _tdcPixelCount == 0)
+		throw std::runtime_error("TDC pixel moments array not set.");
+
+	if(_createTimeHist)  // before the pixel mask, the events of masked hits are counted too
+		fillTimeHist(rHitInfo, rNhits);
+	if(tNrealHits == 0)
+		return;
+
+	_hitMasked.clear();
+	if(_pixelMask.enabled() && markMaskedHits(rHitInfo, rNhits) == tNrealHits)  // the fill loops skip the marked hits like virtual hits, thus the batch is not copied
+		return;
+
+	if(_createOccHist && _createSnapshots && !_occupancy.sparse())  // the dense fill loops write via data() and do not mark the tiles
+		markOccupancyTiles(rHitInfo, rNhits);
+
+	//small batches are not worth the thread overhead and the reduction of the partial histograms
+	unsigned int tNthreads = std::min(getNthreads(), rNhits / __MIN_HITS_PER_THREAD);
+	if(tNthreads > 1)
+		fillHistsParallel(rHitInfo, rNhits, tNthreads);
+	else{
+		//one unchecked loop per enabled histogram, no per hit option or range checks needed
+		if(_createOccHist)
+			fillOccupancyDirect(rHitInfo, 0, rNhits, false);
+		if(_createRelBCIDhist)
+			fillRelBcidHist(rHitInfo, 0, rNhits, _relBcid);
+		if(_createTotHist)
+			fillTotHist(rHitInfo, 0, rNhits, _tot);
+		if(_createTdcHist)
+			fillTdcHist(rHitInfo, 0, rNhits, _tdc);
+		if(_createTdcTriggerDistanceHist)
+			fillTdcTriggerDistanceHist(rHitInfo, 0, rNhits, _tdcTriggerDistance);
+	}
+	//the pixel ToT/TDC histograms are too large for thread private copies
+	if(_createTdcPixelHist)
+		fillTdcPixelHist(rHitInfo, rNhits);
+	if(_createTdcPixelMoments)
+		fillTdcPixelMoments(rHitInfo, rNhits);
+	if(_createTotPixelHist)
+		fillTotPixelHist(rHitInfo, rNhits);
+	if(_createDecayingOccupancyHist)
+		fillDecayingOccupancyHist(rHitInfo, rNhits);
+}
+
+unsigned int Histogram::markMaskedHits(HitInfo*& rHitInfo, const unsigned int& rNhits)
+{
+	unsigned int tNmasked = 0;
+	for(unsigned int i = 0; i < rNhits; ++i){
+		if((rHitInfo[i].event_status & __NO_HIT) == __NO_HIT || !_pixelMask.drop(rHitInfo[i].column, rHitInfo[i].row))
+			continue;
+		if(_hitMasked.empty())  // only allocated if a hit is masked
+			_hitMasked.assign(rNhits, 0);
+		_hitMasked[i] = 1;
+		tNmasked++;
+	}
+	return tNmasked;
+}
+
+inline bool Histogram::skipHit(HitInfo*& rHitInfo, const unsigned int& rIndex)
+{
+	return (rHitInfo[rIndex].event_status & __NO_HIT) == __NO_HIT || (!_hitMasked.empty() && _hitMasked[rIndex] != 0);
+}
+
+unsigned int Histogram::validateHits(HitInfo*& rHitInfo, const unsigned int& rNhits)
+{
+	_hitParIndex.resize(rNhits);
+	if(_createTimeHist)
+		_hitTimeBin.resize(rNhits);
+	unsigned int tNrealHits = 0;
+	unsigned int tParIndex = 0;
+	int64_t tLastEventNumber = 0;
+	int64_t tTimeBin = 0;
+	//range check blocks of hits without branches, only a block with an invalid hit is checked hit by hit to throw for the first invalid hit
+	for(unsigned int iBlock = 0; iBlock < rNhits; iBlock += __HIT_BLOCK_SIZE){
+		unsigned int tBlockEnd = std::min(iBlock + __HIT_BLOCK_SIZE, rNhits);
+		bool tInvalid = false;
+		for(unsigned int i = iBlock; i < tBlockEnd; ++i){
+			bool tRealHit = (rHitInfo[i].event_status & __NO_HIT) != __NO_HIT; // virtual hits are ignored
+			tInvalid |= tRealHit & (((unsigned int) (rHitInfo[i].column - 1) > _nColumns - 1) | ((unsigned int) (rHitInfo[i].row - 1) > _nRows - 1) | (rHitInfo[i].tot > 15) | (rHitInfo[i].TDC >= __N_TDC_VALUES) | (rHitInfo[i].TDC_time_stamp >= __N_TDC_DIST_VALUES) | (rHitInfo[i].relative_BCID >= __MAXBCID));
+		}
+		for(unsigned int i = iBlock; i < tBlockEnd; ++i){
+			_hitParIndex[i] = tParIndex; // also set for virtual hits to keep the parameter runs in fillHistsParallel intact
+			if(_createTimeHist){  // the events without hits are counted in the time histograms, thus also set for virtual hits
+				if(i == 0 || rHitInfo[i].event_number != rHitInfo[i-1].event_number)
+					tTimeBin = getTimeBin(rHitInfo[i].event_number);
+				_hitTimeBin[i] = tTimeBin;
+			}
+			if ((rHitInfo[i].event_status & __NO_HIT) == __NO_HIT) // ignore virtual hits
+				continue;
+			if(tInvalid)
+				throwInvalidHit(rHitInfo[i]);
+			if(tNrealHits == 0 || rHitInfo[i].event_number != tLastEventNumber){ // the parameter index can only change with the event number
+				tParIndex = getParIndex(rHitInfo[i].event_number);
+				tLastEventNumber = rHitInfo[i].event_number;
+				if(tParIndex >= getNparameters()){
+					error("addHits: tParIndex "+IntToStr(tParIndex)+"\t> "+IntToStr(_NparameterValues));
+					throw std::out_of_range("Parameter index out of range.");
+				}
+			}
+			_hitParIndex[i] = tParIndex;
+			tNrealHits++;
+		}
+	}
+	return tNrealHits;
+}
+
+void Histogram::throwInvalidHit(const HitInfo& rHit)
+{
+	unsigned short tColumnIndex = rHit.column-1;
+	if(tColumnIndex > _nColumns-1)
+		throw std::out_of_range("Column index out of range.");
+	unsigned int tRowIndex = rHit.row-1;
+	if(tRowIndex > _nRows-1)
+		throw std::out_of_range("Row index out of range.");
+	unsigned int tTot = rHit.tot;
+	if(tTot > 15)
+		throw std::out_of_range("ToT index out of range.");
+	unsigned int tTdc = rHit.TDC;
+	if(tTdc >= __N_TDC_VALUES)
+		throw std::out_of_range("TDC value " + IntToStr(tTdc) + " index out of range.");
+	unsigned int tTdcTriggerDistance = rHit.TDC_time_stamp; // when using TDC trigger distance, use TDC timestamp
+	if(tTdcTriggerDistance >= __N_TDC_DIST_VALUES)
+		throw std::out_of_range("TDC distance " + IntToStr(tTdc) + " index out of range.");
+	unsigned int tRelBcid = rHit.relative_BCID;
+	if(tRelBcid >= __MAXBCID)
+		throw std::out_of_range("Relative BCID index out of range.");
+}
+
+void Histogram::fillHistsParallel(HitInfo*& rHitInfo, const unsigned int& rNhits, const unsigned int& rNthreads)
+{
+	debug("fillHistsParallel(...) with "+IntToStr(rNthreads)+" threads");
+	const size_t tNpixel = (size_t)_nColumns * (size_t)_nRows;
+	const size_t tHist1dSize = (size_t)__MAXBCID + 16 + (size_t)__N_TDC_VALUES + (size_t)__N_TDC_DIST_VALUES; //relative BCID, ToT, TDC and TDC trigger distance histogram of one thread
+
+	//runs of hits with the same parameter index, the hits are sorted by event number thus there are only few runs
+	std::vector<unsigned int> tRunStart(1, 0);
+	unsigned int tMinParIndex = std::numeric_limits<unsigned int>::max();
+	unsigned int tMaxParIndex = 0;
+	for(unsigned int i = 0; i < rNhits; ++i){
+		if(i > 0 && _hitParIndex[i] != _hitParIndex[i-1])
+			tRunStart.push_back(i);
+		if ((rHitInfo[i].event_status & __NO_HIT) == __NO_HIT) // virtual hits do not extend the parameter range
+			continue;
+		tMinParIndex = std::min(tMinParIndex, _hitParIndex[i]);
+		tMaxParIndex = std::max(tMaxParIndex, _hitParIndex[i]);
+	}
+	tRunStart.push_back(rNhits);
+	const unsigned int tNpar = tMaxParIndex - tMinParIndex + 1;
+
+	//hits of many parameters: every thread fills all runs of its parameters directly, the parameter slices are disjoint
+	//otherwise every thread fills thread private partial histograms of the parameter range that are summed up afterwards
+	bool tSliceMode = _createOccHist && tNpar > rNthreads;
+	bool tPartialOcc = _createOccHist && !tSliceMode;
+	if(tSliceMode){
+		//dense arrays are written via data(), the parameter slices are disjoint entries
+		//sparse arrays: in the parameter-major layout every tile belongs to one parameter, thus to one thread
+		//in the pixel-major layout the parameters share tiles, thus the tiles are allocated and marked dirty before by this thread
+		bool tMarked = _occupancy.sparse() && _pixelMajorOccupancy;
+		if(tMarked)
+			markOccupancyTiles(rHitInfo, rNhits);
+#pragma omp parallel for schedule(dynamic) num_threads((int) rNthreads)
+		for(int iPar = 0; iPar < (int) tNpar; ++iPar){
+			for(unsigned int iRun = 0; iRun < tRunStart.size() - 1; ++iRun){
+				if(_hitParIndex[tRunStart[iRun]] != tMinParIndex + (unsigned int) iPar)
+					continue;
+				fillOccupancyDirect(rHitInfo, tRunStart[iRun], tRunStart[iRun+1], tMarked);
+			}
+		}
+	}
+
+	const size_t tPartialOccSize = tPartialOcc ? tNpixel * (size_t)tNpar : 0;
+	const size_t tPartialTotSumSize = tPartialOcc && _createMeanTotHist ? tPartialOccSize : 0;
+	const size_t tPartialPixelStride = _pixelMajorOccupancy ? (size_t)tNpar : 1;  // the partial histograms have the layout of _occupancy
+	const size_t tPartialParStride = _pixelMajorOccupancy ? 1 : tNpixel;
+	_partialOccupancy.resize(tPartialOccSize * rNthreads);
+	_partialTotSum.resize(tPartialTotSumSize * rNthreads);
+	_partialTotSquareSum.resize(tPartialTotSumSize * rNthreads);
+	_partialHists.resize(tHist1dSize * rNthreads);
+
+#pragma omp parallel num_threads((int) rNthreads)
+	{
+#ifdef _OPENMP
+		unsigned int tThread = (unsigned int) omp_get_thread_num();
+#else
+		unsigned int tThread = 0;
+#endif
+		unsigned int tFirstHit = (unsigned int) ((uint64_t) rNhits * tThread / rNthreads);
+		unsigned int tLastHit = (unsigned int) ((uint64_t) rNhits * (tThread + 1) / rNthreads);
+
+		//every thread zeroes its own partial histograms
+		unsigned int* tRelBcid = &_partialHists[tHist1dSize * tThread];
+		unsigned int* tTot = tRelBcid + __MAXBCID;
+		unsigned int* tTdc = tTot + 16;
+		unsigned int* tTdcTriggerDistance = tTdc + __N_TDC_VALUES;
+		std::fill(tRelBcid, tRelBcid + tHist1dSize, 0);
+		if(_createRelBCIDhist)
+			fillRelBcidHist(rHitInfo, tFirstHit, tLastHit, tRelBcid);
+		if(_createTotHist)
+			fillTotHist(rHitInfo, tFirstHit, tLastHit, tTot);
+		if(_createTdcHist)
+			fillTdcHist(rHitInfo, tFirstHit, tLastHit, tTdc);
+		if(_createTdcTriggerDistanceHist)
+			fillTdcTriggerDistanceHist(rHitInfo, tFirstHit, tLastHit, tTdcTriggerDistance);
+
+		if(tPartialOcc){
+			unsigned int* tOccupancy = &_partialOccupancy[tPartialOccSize * tThread];
+			std::fill(tOccupancy, tOccupancy + tPartialOccSize, 0);
+			if(_createMeanTotHist){
+				unsigned int* tTotSum = &_partialTotSum[tPartialTotSumSize * tThread];
+				uint64_t* tTotSquareSum = &_partialTotSquareSum[tPartialTotSumSize * tThread];
+				std::fill(tTotSum, tTotSum + tPartialTotSumSize, 0);
+				std::fill(tTotSquareSum, tTotSquareSum + tPartialTotSumSize, 0);
+				fillOccupancyMeanTotHist(rHitInfo, tFirstHit, tLastHit, tOccupancy, tTotSum, tTotSquareSum, tMinParIndex, tPartialPixelStride, tPartialParStride);
+			}
+			else
+				fillOccupancyHist(rHitInfo, tFirstHit, tLastHit, tOccupancy, tMinParIndex, tPartialPixelStride, tPartialParStride);
+		}
+
+		//integer sums, thus the result does not depend on the summation order and is identical to the serial filling
+		//every thread adds blocks of __HIST_TILE_SIZE pixels, their tiles are disjoint in both layouts
+		//only entries with hits are written to not allocate empty tiles in sparse mode
+#pragma omp barrier
+		if(tPartialOcc){
+#pragma omp for
+			for(int iBlock = 0; iBlock < (int) (tNpixel / __HIST_TILE_SIZE); ++iBlock){
+				for(unsigned int iThread = 0; iThread < rNthreads; ++iThread){
+					for(unsigned int k = 0; k < tNpar; ++k){
+						for(size_t tPixel = (size_t)iBlock * __HIST_TILE_SIZE; tPixel < ((size_t)iBlock + 1) * __HIST_TILE_SIZE; ++tPixel){
+							size_t i = tPixel * tPartialPixelStride + (size_t)k * tPartialParStride;
+							unsigned int tOccupancy = _partialOccupancy[tPartialOccSize * iThread + i];
+							if(tOccupancy == 0)
+								continue;
+							size_t tIndex = getOccupancyIndex(tPixel, tMinParIndex + k);
+							_occupancy[tIndex] += tOccupancy;  // once per pixel with hits and thread, not per hit
+							if(_createMeanTotHist){
+								_totSum[tIndex] += _partialTotSum[tPartialTotSumSize * iThread + i];
+								_totSquareSum[tIndex] += _partialTotSquareSum[tPartialTotSumSize * iThread + i];
+							}
+						}
+					}
+				}
+			}
+		}
+	}
+
+	for(unsigned int iThread = 0; iThread < rNthreads; ++iThread){
+		unsigned int* tRelBcid = &_partialHists[tHist1dSize * iThread];
+		if(_createRelBCIDhist)
+			addArray(tRelBcid, __MAXBCID, _relBcid);
+		if(_createTotHist)
+			addArray(tRelBcid + __MAXBCID, 16, _tot);
+		if(_createTdcHist)
+			addArray(tRelBcid + __MAXBCID + 16, __N_TDC_VALUES, _tdc);
+		if(_createTdcTriggerDistanceHist)
+			addArray(tRelBcid + __MAXBCID + 16 + __N_TDC_VALUES, __N_TDC_DIST_VALUES, _tdcTriggerDistance);
+	}
+}
+
+void Histogram::markOccupancyTiles(HitInfo*& rHitInfo, const unsigned int& rNhits)
+{
+	for(unsigned int i = 0; i < rNhits; ++i){
+		if (skipHit(rHitInfo, i) || rHitInfo[i].tot > _maxTot)
+			continue;
+		size_t tIndex = getOccupancyIndex((size_t)(rHitInfo[i].column-1) + (size_t)(rHitInfo[i].row-1) * (size_t)_nColumns, _hitParIndex[i]);
+		_occupancy.markDirty(tIndex);
+		if(_createMeanTotHist){
+			_totSum.markDirty(tIndex);
+			_totSquareSum.markDirty(tIndex);
+		}
+	}
+}
+
+void Histogram::fillOccupancyDirect(HitInfo*& rHitInfo, const unsigned int& rFirstHit, const unsigned int& rLastHit, const bool& rMarked)
+{
+	if(!_occupancy.sparse()){  // dense and mapped arrays, no per hit tile check
+		unsigned int* tOccupancy = _occupancy.data();
+		unsigned int* tTotSum = _totSum.data();
+		uint64_t* tTotSquareSum = _totSquareSum.data();
+		fillOccupancyArrays(rHitInfo, rFirstHit, rLastHit, tOccupancy, tTotSum, tTotSquareSum);
+	}
+	else if(rMarked){
+		UnmarkedTiles<unsigned int> tOccupancy(_occupancy);
+		UnmarkedTiles<unsigned int> tTotSum(_totSum);
+		UnmarkedTiles<uint64_t> tTotSquareSum(_totSquareSum);
+		fillOccupancyArrays(rHitInfo, rFirstHit, rLastHit, tOccupancy, tTotSum, tTotSquareSum);
+	}
+	else
+		fillOccupancyArrays(rHitInfo, rFirstHit, rLastHit, _occupancy, _totSum, _totSquareSum);
+}
+
+template<class TOccupancy, class TTotSum, class TTotSquareSum> void Histogram::fillOccupancyArrays(HitInfo*& rHitInfo, const unsigned int& rFirstHit, const unsigned int& rLastHit, TOccupancy& rOccupancy, TTotSum& rTotSum, TTotSquareSum& rTotSquareSum)
+{
+	if(_createMeanTotHist)
+		fillOccupancyMeanTotHist(rHitInfo, rFirstHit, rLastHit, rOccupancy, rTotSum, rTotSquareSum, 0, _occupancyPixelStride, _occupancyParStride);
+	else
+		fillOccupancyHist(rHitInfo, rFirstHit, rLastHit, rOccupancy, 0, _occupancyPixelStride, _occupancyParStride);
+}
+
+void Histogram::addArray(const unsigned int* rSource, const unsigned int& rLength, unsigned int* rTarget)
+{
+	for(unsigned int i = 0; i < rLength; ++i)
+		rTarget[i] += rSource[i];
+}
+
+template<class TOccupancy> void Histogram::fillOccupancyHist(HitInfo*& rHitInfo, const unsigned int& rFirstHit, const unsigned int& rLastHit, TOccupancy& rOccupancy, const unsigned int& rParOffset, const size_t& rPixelStride, const size_t& rParStride)
+{
+	const size_t tNcolumns = _nColumns; // local copy, the member cannot be kept in a register across the histogram writes
+	for(unsigned int i = rFirstHit; i<rLastHit; ++i){
+		if (skipHit(rHitInfo, i) || rHitInfo[i].tot > _maxTot)
+			continue;
+		rOccupancy[((size_t)(rHitInfo[i].column-1) + (size_t)(rHitInfo[i].row-1) * tNcolumns) * rPixelStride + (size_t)(_hitParIndex[i] - rParOffset) * rParStride] += 1;
+	}
+}
+
+template<class TOccupancy, class TTotSum, class TTotSquareSum> void Histogram::fillOccupancyMeanTotHist(HitInfo*& rHitInfo, const unsigned int& rFirstHit, const unsigned int& rLastHit, TOccupancy& rOccupancy, TTotSum& rTotSum, TTotSquareSum& rTotSquareSum, const unsigned int& rParOffset, const size_t& rPixelStride, const size_t& rParStride)
+{
+	const size_t tNcolumns = _nColumns;
+	for(unsigned int i = rFirstHit; i<rLastHit; ++i){
+		if (skipHit(rHitInfo, i) || rHitInfo[i].tot > _maxTot)
+			continue;
+		size_t tIndex = ((size_t)(rHitInfo[i].column-1) + (size_t)(rHitInfo[i].row-1) * tNcolumns) * rPixelStride + (size_t)(_hitParIndex[i] - rParOffset) * rParStride;
+		unsigned int tTot = rHitInfo[i].tot;
+		rOccupancy[tIndex] += 1;
+		rTotSum[tIndex] += tTot;
+		rTotSquareSum[tIndex] += tTot * tTot;
+	}
+}
+
+void Histogram::fillRelBcidHist(HitInfo*& rHitInfo, const unsigned int& rFirstHit, const unsigned int& rLastHit, unsigned int* rRelBcid)
+{
+	for(unsigned int i = rFirstHit; i<rLastHit; ++i){
+		if (skipHit(rHitInfo, i) || rHitInfo[i].tot > _maxTot)
+			continue;
+		rRelBcid[rHitInfo[i].relative_BCID] += 1;
+	}
+}
+
+void Histogram::fillTotHist(HitInfo*& rHitInfo, const unsigned int& rFirstHit, const unsigned int& rLastHit, unsigned int* rTot)
+{
+	for(unsigned int i = rFirstHit; i<rLastHit; ++i){
+		if (skipHit(rHitInfo, i) || rHitInfo[i].tot > _maxTot) //not sure if cut on ToT histogram is unwanted here
+			continue;
+		rTot[rHitInfo[i].tot] += 1;
+	}
+}
+
+void Histogram::fillTdcHist(HitInfo*& rHitInfo, const unsigned int& rFirstHit, const unsigned int& rLastHit, unsigned int* rTdc)
+{
+	for(unsigned int i = rFirstHit; i<rLastHit; ++i){
+		if (skipHit(rHitInfo, i))
+			continue;
+		rTdc[rHitInfo[i].TDC] += 1;
+	}
+}
+
+void Histogram::fillTdcTriggerDistanceHist(HitInfo*& rHitInfo, const unsigned int& rFirstHit, const unsigned int& rLastHit, unsigned int* rTdcTriggerDistance)
+{
+	for(unsigned int i = rFirstHit; i<rLastHit; ++i){
+		if (skipHit(rHitInfo, i))
+			continue;
+		rTdcTriggerDistance[rHitInfo[i].TDC_time_stamp] += 1; // when using TDC trigger distance, use TDC timestamp
+	}
+}
+
+void Histogram::fillTdcPixelHist(HitInfo*& rHitInfo, const unsigned int& rNhits)
+{
+	unsigned int tNsaturated = 0;
+	unsigned int tNoutOfRange = 0;
+	if(_tdcPixel.sparse())
+		fillTdcPixelBins(rHitInfo, rNhits, _tdcPixel, tNsaturated, tNoutOfRange);
+	else{
+		if(_createSnapshots){  // the dense array is written via data(), thus the tiles are marked before
+			for(unsigned int i = 0; i<rNhits; ++i){
+				if (!skipHit(rHitInfo, i) && rHitInfo[i].TDC < __N_TDC_PIXEL_VALUES)
+					_tdcPixel.markDirty(getTdcPixelIndex(rHitInfo[i]));
+			}
+		}
+		unsigned short* tTdcPixel = _tdcPixel.data();
+		fillTdcPixelBins(rHitInfo, rNhits, tTdcPixel, tNsaturated, tNoutOfRange);
+	}
+	if(tNsaturated != 0)
+		warning("fillTdcPixelHist: "+IntToStr(tNsaturated)+" hits not added to saturated TDC pixel histogram bins");
+	if(tNoutOfRange != 0)
+		info("fillTdcPixelHist: "+IntToStr(tNoutOfRange)+" hits with TDC values >= "+IntToStr(__N_TDC_PIXEL_VALUES)+" not added to the TDC pixel histogram");
+}
+
+template<class TTdcPixel> void Histogram::fillTdcPixelBins(HitInfo*& rHitInfo, const unsigned int& rNhits, TTdcPixel& rTdcPixel, unsigned int& rNsaturated, unsigned int& rNoutOfRange)
+{
+	for(unsigned int i = 0; i<rNhits; ++i){
+		if (skipHit(rHitInfo, i))
+			continue;
+		if(rHitInfo[i].TDC >= __N_TDC_PIXEL_VALUES){  // not histogrammed, only counted
+			rNoutOfRange++;
+			continue;
+		}
+		unsigned short& tBin = rTdcPixel[getTdcPixelIndex(rHitInfo[i])];
+		if(tBin < std::numeric_limits<unsigned short>::max())  // 16-bit bins saturate instead of wrapping around
+			tBin += 1;
+		else
+			rNsaturated++;
+	}
+}
+
+inline size_t Histogram::getTdcPixelIndex(const HitInfo& rHit)
+{
+	return (size_t)(rHit.column-1) + (size_t)(rHit.row-1) * (size_t)_nColumns + (size_t)(rHit.TDC / _tdcPixelBinWidth) * (size_t)_nColumns * (size_t)_nRows;
+}
+
+void Histogram::fillTdcPixelMoments(HitInfo*& rHitInfo, const unsigned int& rNhits)
+{
+	for(unsigned int i = 0; i<rNhits; ++i){
+		if (skipHit(rHitInfo, i))
+			continue;
+		size_t tPixel = (size_t)(rHitInfo[i].column-1) + (size_t)(rHitInfo[i].row-1) * (size_t)_nColumns;
+		unsigned short tTdc = rHitInfo[i].TDC;
+		if(_tdcPixelCount[tPixel] == 0 || tTdc < _tdcPixelMin[tPixel])
+			_tdcPixelMin[tPixel] = tTdc;
+		if(_tdcPixelCount[tPixel] == 0 || tTdc > _tdcPixelMax[tPixel])
+			_tdcPixelMax[tPixel] = tTdc;
+		_tdcPixelCount[tPixel] += 1;
+		_tdcPixelSum[tPixel] += tTdc;
+		_tdcPixelSquareSum[tPixel] += (uint64_t) tTdc * (uint64_t) tTdc;
+	}
+}
+
+void Histogram::fillTotPixelHist(HitInfo*& rHitInfo, const unsigned int& rNhits)
+{
+	const size_t tNpixel = (size_t)_nColumns * (size_t)_nRows;
+	if(_createSnapshots){  // the ToT pixel array is always dense and written via data(), thus the tiles are marked before
+		for(unsigned int i = 0; i<rNhits; ++i){
+			if (!skipHit(rHitInfo, i) && rHitInfo[i].tot <= _maxTot)
+				_totPixel.markDirty((size_t)(rHitInfo[i].column-1) + (size_t)(rHitInfo[i].row-1) * (size_t)_nColumns + (size_t)rHitInfo[i].tot * tNpixel);
+		}
+	}
+	unsigned short* tTotPixel = _totPixel.data();
+	for(unsigned int i = 0; i<rNhits; ++i){
+		if (skipHit(rHitInfo, i) || rHitInfo[i].tot > _maxTot)
+			continue;
+		tTotPixel[(size_t)(rHitInfo[i].column-1) + (size_t)(rHitInfo[i].row-1) * (size_t)_nColumns + (size_t)rHitInfo[i].tot * tNpixel] += 1;
+	}
+}
+
+void Histogram::fillDecayingOccupancyHist(HitInfo*& rHitInfo, const unsigned int& rNhits)
+{
+	//lazy decay: a hit adds 2^((event number - tile epoch)/half life), thus the stored values never have to be decayed and only a tile whose weights get too large is rescaled
+	const double tMaxTileWeight = ldexp(1., __DECAY_MAX_TILE_EXPONENT);
+	double tWeight = 0.;
+	for(unsigned int i = 0; i<rNhits; ++i){
+		if(i == 0 || rHitInfo[i].event_number != rHitInfo[i-1].event_number){  // the event weight only changes with the event number
+			double tEventNumber = (double) rHitInfo[i].event_number;
+			if(!_decayStarted)
+				_decayOrigin = tEventNumber;
+			else if(tEventNumber - _decayOrigin > _decayHalfLife * __DECAY_MAX_EXPONENT)
+				moveDecayOrigin(tEventNumber);
+			if(!_decayStarted || tEventNumber > _decayEventNumber)
+				_decayEventNumber = tEventNumber;
+			_decayStarted = true;
+			tWeight = pow(2., (tEventNumber - _decayOrigin) / _decayHalfLife);
+		}
+		if (skipHit(rHitInfo, i))
+			continue;
+		size_t tPixel = (size_t)(rHitInfo[i].column-1) + (size_t)(rHitInfo[i].row-1) * (size_t)_nColumns;
+		size_t tTile = tPixel / __HIST_TILE_SIZE;
+		double tHitWeight = tWeight * _decayTileFactor[tTile];
+		if(tHitWeight > tMaxTileWeight){  // the tile epoch is moved to this event
+			for(size_t j = tTile * __HIST_TILE_SIZE; j < (tTile + 1) * __HIST_TILE_SIZE; ++j)
+				_decayingOccupancy[j] /= tHitWeight;
+			_decayTileFactor[tTile] = 1. / tWeight;
+			tHitWeight = 1.;
+		}
+		_decayingOccupancy[tPixel] += tHitWeight;
+	}
+}
+
+void Histogram::moveDecayOrigin(const double& rOrigin)
+{
+	const double tMaxTileFactor = ldexp(1., __DECAY_MAX_EXPONENT);
+	double tShift = pow(2., (rOrigin - _decayOrigin) / _decayHalfLife);
+	for(size_t i = 0; i < _decayTileFactor.size(); ++i){
+		_decayTileFactor[i] *= tShift;
+		if(_decayTileFactor[i] > tMaxTileFactor){  // no hits for more than __DECAY_MAX_EXPONENT half lives, the content is 0 in double precision
+			std::fill(_decayingOccupancy.begin() + i * __HIST_TILE_SIZE, _decayingOccupancy.begin() + (i + 1) * __HIST_TILE_SIZE, 0.);
+			_decayTileFactor[i] = 1.;
+		}
+	}
+	_decayOrigin = rOrigin;
+}
+
+void Histogram::fillTimeHist(HitInfo*& rHitInfo, const unsigned int& rNhits)
+{
+	const unsigned int tNregions = _nTimeHistColumnRegions * _nTimeHistRowRegions;
+	for(unsigned int i = 0; i<rNhits; ++i){
+		if(_hitTimeBin[i] > _timeHistLastBin)
+			advanceTimeHist(_hitTimeBin[i]);
+		bool tRealHit = (rHitInfo[i].event_status & __NO_HIT) != __NO_HIT;
+		bool tCounted = tRealHit && !(_pixelMask.enabled() && _pixelMask.masked((size_t)(rHitInfo[i].column-1) + (size_t)(rHitInfo[i].row-1) * (size_t)_nColumns));  // masked hits are neither histogrammed nor lost
+		if(_hitTimeBin[i] < _timeHistFirstBin){  // already dropped out of the ring or before the first time stamp
+			if(tCounted)
+				_nTimeHistLostHits++;
+			continue;
+		}
+		size_t tBin = (size_t) (_hitTimeBin[i] % (int64_t) _nTimeHistBins);
+		if(rHitInfo[i].event_number != _timeHistLastEventNumber){  // the event status is the same for all hits of the event
+			_timeHistLastEventNumber = rHitInfo[i].event_number;
+			_timeHistEvents[tBin]++;
+			if((rHitInfo[i].event_status & __TDC_WORD) == __TDC_WORD)
+				_timeHistTdc[tBin]++;
+			for(unsigned int iCode = 0; iCode < __N_ERROR_CODES; ++iCode)
+				if((rHitInfo[i].event_status & (1 << iCode)) != 0)
+					_timeHistErrors[(size_t)iCode + tBin * __N_ERROR_CODES]++;
+		}
+		if(!tCounted)
+			continue;
+		_timeHistHits[tBin]++;
+		unsigned int tColumnRegion = (rHitInfo[i].column-1) * _nTimeHistColumnRegions / _nColumns;
+		unsigned int tRowRegion = (rHitInfo[i].row-1) * _nTimeHistRowRegions / _nRows;
+		_timeHistRegions[(size_t)tColumnRegion + (size_t)tRowRegion * _nTimeHistColumnRegions + tBin * tNregions]++;
+	}
+}
+
+void Histogram::advanceTimeHist(const int64_t& rTimeBin)
+{
+	const unsigned int tNregions = _nTimeHistColumnRegions * _nTimeHistRowRegions;
+	int64_t tFirstNewBin = std::max(_timeHistLastBin + 1, rTimeBin - (int64_t) _nTimeHistBins + 1);  // older new bins drop out of the ring right away
+	for(int64_t iBin = tFirstNewBin; iBin <= rTimeBin; ++iBin){
+		size_t tBin = (size_t) (iBin % (int64_t) _nTimeHistBins);
+		_timeHistEvents[tBin] = 0;
+		_timeHistHits[tBin] = 0;
+		_timeHistTdc[tBin] = 0;
+		std::fill(_timeHistErrors.begin() + tBin * __N_ERROR_CODES, _timeHistErrors.begin() + (tBin + 1) * __N_ERROR_CODES, 0);
+		std::fill(_timeHistRegions.begin() + tBin * tNregions, _timeHistRegions.begin() + (tBin + 1) * tNregions, 0);
+	}
+	if(_timeHistLastBin < _timeHistFirstBin)  // empty ring
+		_timeHistFirstBin = std::max(rTimeBin - (int64_t) _nTimeHistBins + 1, (int64_t) 0);
+	else
+		_timeHistFirstBin = std::max(_timeHistFirstBin, rTimeBin - (int64_t) _nTimeHistBins + 1);
+	_timeHistLastBin = rTimeBin;
+}
+
+int64_t Histogram::getTimeBin(const int64_t& rEventNumber)
+{
+	if(_metaEventIndex == 0 || _nMetaEventIndexLength == 0 || _metaTimeStamps.size() < _nMetaEventIndexLength)
+		throw std::runtime_error("Time histograms need the meta event index and the read out time stamps.");
+	uint64_t tReadoutIndex = _nMetaEventIndexLength-1;
+	for(uint64_t i=_lastTimeReadoutIndex; i<_nMetaEventIndexLength-1; ++i){
+		if(_metaEventIndex[i+1] > (uint64_t) rEventNumber || _metaEventIndex[i+1] < _metaEventIndex[i]){ // see getParIndex
+			tReadoutIndex = i;
+			break;
+		}
+	}
+	if(tReadoutIndex == _nMetaEventIndexLength-1 && _metaEventIndex[tReadoutIndex] > (uint64_t) rEventNumber){
+		error("getTimeBin: Correlation issues at event "+LongIntToStr(rEventNumber));
+		throw std::logic_error("Event time stamp correlation issues.");
+	}
+	_lastTimeReadoutIndex = tReadoutIndex;
+	if(!_timeHistOriginSet){
+		_timeHistOrigin = _metaTimeStamps[0];
+		_timeHistOriginSet = true;
+	}
+	double tTimeBin = std::floor((_metaTimeStamps[(size_t)tReadoutIndex] - _timeHistOrigin) / _timeHistBinWidth);
+	return tTimeBin < 0. ? (int64_t) -1 : (int64_t) tTimeBin;  // time stamps before the origin are not histogrammed
+}
+
+void Histogram::addClusterSeedHits(ClusterInfo*& rClusterInfo, const unsigned int& rNcluster)
+{
+	MutexLock tLock(_fillMutex);
+	if(Basis::debugSet())
+		debug("addClusterSeedHits(...,rNcluster="+IntToStr(rNcluster)+")");
+	for(unsigned int i = 0; i<rNcluster; ++i){
+		unsigned short tColumnIndex = rClusterInfo[i].seed_column-1;
+		if(tColumnIndex > _nColumns-1)
+			throw std::out_of_range("Column index out of range.");
+		unsigned int tRowIndex = rClusterInfo[i].seed_row-1;
+		if(tRowIndex > _nRows-1)
+			throw std::out_of_range("Row index out of range.");
+		if(_pixelMask.enabled() && _pixelMask.drop(tColumnIndex + 1, tRowIndex + 1))
+			continue;
+
+		unsigned int tParIndex = getParIndex(rClusterInfo[i].event_number);
+
+		if(tParIndex >= getNparameters()){
+			error("addHits: tParIndex "+IntToStr(tParIndex)+"\t> "+IntToStr(_NparameterValues));
+			throw std::out_of_range("Parameter index out of range.");
+		}
+		if(_createOccHist){
+			if(_occupancy.allocated())
+				_occupancy[getOccupancyIndex((size_t)tColumnIndex + (size_t)tRowIndex * (size_t)_nColumns, tParIndex)] += 1;
+			else
+				throw std::runtime_error("Occupancy array not initialized. Set scan parameter first!.");
+		}
+	}
+	if(_createSnapshots)
+		publishSnapshot();
+}
+
+unsigned int Histogram::getParIndex(int64_t& rEventNumber)
+{
+  if(_parInfo == 0)
+    return mapParIndex(0);
+  for(uint64_t i=_lastMetaEventIndex; i<_nMetaEventIndexLength-1; ++i){
+    if(_metaEventIndex[i+1] > (uint64_t) rEventNumber || _metaEventIndex[i+1] < _metaEventIndex[i]){ // second case: meta event data not set yet (std value = 0), event number has to increase
+      _lastMetaEventIndex = i;
+      if (i < _nParInfoLength)
+      	return mapParIndex(_parInfo[i]);
+      else{
+    	  error("Scan parameter index " + LongIntToStr(i) + " out of range");
+    	  throw std::out_of_range("Scan parameter index out of range.");
+      }
+    }
+  }
+  if(_metaEventIndex[_nMetaEventIndexLength-1] <= (uint64_t) rEventNumber) //last read outs
+    return mapParIndex(_parInfo[_nMetaEventIndexLength-1]);
+  error("getScanParameter: Correlation issues at event "+LongIntToStr(rEventNumber)+"\n_metaEventIndex[_nMetaEventIndexLength-1] "+LongIntToStr(_metaEventIndex[_nMetaEventIndexLength-1])+"\n_lastMetaEventIndex "+LongIntToStr(_lastMetaEventIndex));
+  throw std::logic_error("Event parameter correlation issues.");
+  return 0;
+}
+
+unsigned int Histogram::mapParIndex(const int& rParIndex)
+{
+  if(_parIndexMap.empty())
+    return (unsigned int) rParIndex;
+  return (unsigned int) rParIndex < _parIndexMap.size() ? _parIndexMap[rParIndex] : _NparameterValues;  // an index out of range stays out of range
+}
+
+void Histogram::addScanParameter(int*& rParInfo, const unsigned int& rNparInfoLength)
+{
+	debug("addScanParameter");
+	_nParInfoLength = rNparInfoLength;
+	_parInfo = rParInfo;
+
+	std::vector<unsigned int> tParameterValues;
+
+	for(unsigned int i = 0; i < _nParInfoLength; ++i)
+	  tParameterValues.push_back(_parInfo[i]);
+
+	std::sort(tParameterValues.begin(), tParameterValues.end());  //sort from lowest to highest value
+	std::set<unsigned int> tSet(tParameterValues.begin(), tParameterValues.end());  // delete duplicates
+	tParameterValues.assign(tSet.begin(), tSet.end() );
+
+	_parameterValues.clear();
+	for(unsigned int i = 0; i < tParameterValues.size(); ++i)
+		_parameterValues[tParameterValues[i]] = i;
+	_parIndexMap.clear();
+
+	_NparameterValues = (unsigned int) tSet.size();
+
+	if (_createOccHist){
+		allocateOccupancyArray();  // the arrays are allocated with zeros or the resumed storage file content
+		if (_createMeanTotHist)
+			allocateMeanTotArray();
+	}
+	if (Basis::debugSet()){
+	  for(unsigned int i=0; i<_nParInfoLength; ++i)
+		 std::cout<<"index "<<i<<"\t parameter index "<<_parInfo[i]<<"\n";
+	}
+}
+
+void Histogram::addMetaEventIndex(uint64_t*& rMetaEventIndex, const unsigned int& rNmetaEventIndexLength)
+{
+  debug("addMetaEventIndex()");
+  _nMetaEventIndexLength = rNmetaEventIndexLength;
+  _metaEventIndex = rMetaEventIndex;
+  _lastTimeReadoutIndex = 0;
+  if (Basis::debugSet())
+	  for(unsigned int i=0; i<_nMetaEventIndexLength; ++i)
+		 std::cout<<"index "<<i<<"\t event number "<<_metaEventIndex[i]<<"\n";
+}
+
+void Histogram::setMetaTimeStamps(const double* rTimeStamps, const unsigned int& rNtimeStamps)
+{
+  debug("setMetaTimeStamps()");
+  _metaTimeStamps.assign(rTimeStamps, rTimeStamps + rNtimeStamps);
+  _lastTimeReadoutIndex = 0;
+}
+
+void Histogram::allocateOccupancyArray()
+{
+  debug("allocateOccupancyArray() with "+IntToStr(getNparameters())+" parameters");
+  deleteOccupancyArray();
+  _occupancyPixelStride = _pixelMajorOccupancy ? (size_t)getNparameters() : 1;
+  _occupancyParStride = _pixelMajorOccupancy ? 1 : (size_t)_nColumns * (size_t)_nRows;
+  try{
+    std::vector<int> tParameterValues;
+    getParameterValues(tParameterValues);
+    if(_storageFileName.empty())
+      _occupancy.allocate((size_t)_nColumns * (size_t)_nRows * (size_t)getNparameters(), _sparseOccupancy);
+    else if(_occupancy.allocateMapped((size_t)_nColumns * (size_t)_nRows * (size_t)getNparameters(), _storageFileName + "_occupancy.dat", getNparameters(), _pixelMajorOccupancy, tParameterValues, _resumeStorage))
+      info("allocateOccupancyArray: content of "+_storageFileName+"_occupancy.dat resumed");
+  }
+  catch(std::bad_alloc& exception){
+    error(std::string("allocateOccupancyArray: ")+std::string(exception.what()));
+  }
+}
+
+void Histogram::deleteOccupancyArray()
+{
+  debug("deleteOccupancyArray()");
+  _occupancy.clear();
+  if (_occupancyExport != 0)
+    delete[] _occupancyExport;
+  _occupancyExport = 0;
+}
+
+void Histogram::resetOccupancyArray()
+{
+  info("resetOccupancyArray()");
+  if (_occupancy.allocated())
+	  _occupancy.reset();
+}
+
+void Histogram::allocateMeanTotArray()
+{
+  debug("allocateMeanTotArray() with "+IntToStr(getNparameters())+" parameters");
+  deleteMeanTotArray();
+  try{
+    if(_storageFileName.empty()){
+      _totSum.allocate((size_t)_nColumns * (size_t)_nRows * (size_t)getNparameters(), _sparseOccupancy);
+      _totSquareSum.allocate((size_t)_nColumns * (size_t)_nRows * (size_t)getNparameters(), _sparseOccupancy);
+    }
+    else{
+      std::vector<int> tParameterValues;
+      getParameterValues(tParameterValues);
+      _totSum.allocateMapped((size_t)_nColumns * (size_t)_nRows * (size_t)getNparameters(), _storageFileName + "_tot_sum.dat", getNparameters(), _pixelMajorOccupancy, tParameterValues, _resumeStorage);
+      _totSquareSum.allocateMapped((size_t)_nColumns * (size_t)_nRows * (size_t)getNparameters(), _storageFileName + "_tot_square_sum.dat", getNparameters(), _pixelMajorOccupancy, tParameterValues, _resumeStorage);
+    }
+  }
+  catch(std::bad_alloc& exception){
+    error(std::string("allocateMeanTotArray: ")+std::string(exception.what()));
+    deleteMeanTotArray();
+  }
+}
+
+void Histogram::deleteMeanTotArray()
+{
+  debug("deleteMeanTotArray()");
+  _totSum.clear();
+  _totSquareSum.clear();
+  if (_meanTot != 0)
+    delete[] _meanTot;
+  _meanTot = 0;
+  if (_totRms != 0)
+    delete[] _totRms;
+  _totRms = 0;
+}
+
+void Histogram::resetMeanTotArray()
+{
+  info("resetMeanTotArray()");
+  if (_totSum.allocated()){
+	  _totSum.reset();
+	  _totSquareSum.reset();
+  }
+}
+
+void Histogram::calculateMeanTot(float* rMeanTot)
+{
+  //mean = ToT sum / # hits, pixels without hits are set to NAN
+  for (size_t iTile = 0; iTile < _occupancy.nTiles(); ++iTile){
+	  const unsigned int* tOccupancy = _occupancy.tile(iTile);
+	  const unsigned int* tTotSum = _totSum.tile(iTile);
+	  for (unsigned int i = 0; i < __HIST_TILE_SIZE; ++i){
+		  float& rMean = rMeanTot[getExportIndex(iTile * __HIST_TILE_SIZE + i)];
+		  if (tOccupancy != 0 && tTotSum != 0 && tOccupancy[i] != 0)
+			  rMean = (float) ((double) tTotSum[i] / (double) tOccupancy[i]);
+		  else
+			  rMean = NAN;
+	  }
+  }
+}
+
+void Histogram::calculateTotRms(float* rTotRms)
+{
+  //RMS = sqrt(ToT square sum / # hits - mean^2), pixels without hits are set to NAN
+  for (size_t iTile = 0; iTile < _occupancy.nTiles(); ++iTile){
+	  const unsigned int* tOccupancy = _occupancy.tile(iTile);
+	  const unsigned int* tTotSum = _totSum.tile(iTile);
+	  const uint64_t* tTotSquareSum = _totSquareSum.tile(iTile);
+	  for (unsigned int i = 0; i < __HIST_TILE_SIZE; ++i){
+		  float& rRms = rTotRms[getExportIndex(iTile * __HIST_TILE_SIZE + i)];
+		  if (tOccupancy != 0 && tTotSum != 0 && tTotSquareSum != 0 && tOccupancy[i] != 0){
+			  double tMean = (double) tTotSum[i] / (double) tOccupancy[i];
+			  double tVariance = (double) tTotSquareSum[i] / (double) tOccupancy[i] - tMean * tMean;
+			  rRms = (float) sqrt(std::max(tVariance, 0.));  // rounding can give slightly negative values
+		  }
+		  else
+			  rRms = NAN;
+	  }
+  }
+}
+
+size_t Histogram::getOccupancyIndex(const size_t& rPixel, const unsigned int& rParIndex)
+{
+  return rPixel * _occupancyPixelStride + (size_t)rParIndex * _occupancyParStride;
+}
+
+size_t Histogram::getExportIndex(const size_t& rIndex)
+{
+  if (!_pixelMajorOccupancy)
+	  return rIndex;
+  return rIndex / _occupancyPixelStride + (rIndex % _occupancyPixelStride) * (size_t)_nColumns * (size_t)_nRows;
+}
+
+void Histogram::getOccupancyBlock(const size_t& rPixelBlock, std::vector<const unsigned int*>& rRows, std::vector<unsigned int>& rBuffer)
+{
+  const unsigned int n = getNparameters();
+  const size_t tNpixelTiles = (size_t)_nColumns * (size_t)_nRows / __HIST_TILE_SIZE;
+  rRows.resize(n);
+  if (!_pixelMajorOccupancy){  // the block is one tile for each parameter
+	  for (unsigned int k = 0; k < n; ++k)
+		  rRows[k] = _occupancy.tile(rPixelBlock + (size_t)k * tNpixelTiles);
+	  return;
+  }
+  //the block is n contiguous tiles, the parameters of each pixel are transposed into the buffer
+  rBuffer.resize((size_t)__HIST_TILE_SIZE * n);
+  for (size_t iTile = rPixelBlock * n; iTile < (rPixelBlock + 1) * n; ++iTile){
+	  const unsigned int* tTile = _occupancy.tile(iTile);
+	  for (unsigned int i = 0; i < __HIST_TILE_SIZE; ++i){
+		  size_t tIndex = (iTile - rPixelBlock * n) * __HIST_TILE_SIZE + i;  // = pixel in the block * n + parameter index
+		  rBuffer[(tIndex % n) * __HIST_TILE_SIZE + tIndex / n] = tTile != 0 ? tTile[i] : 0;
+	  }
+  }
+  for (unsigned int k = 0; k < n; ++k)
+	  rRows[k] = &rBuffer[(size_t)k * __HIST_TILE_SIZE];
+}
+
+void Histogram::exportOccupancy(unsigned int* rTarget)
+{
+  if (!_pixelMajorOccupancy){
+	  _occupancy.copyTo(rTarget);
+	  return;
+  }
+  //blocked transpose, the tiles of one pixel block are read once and every parameter row is written contiguously
+  const size_t tNpixel = (size_t)_nColumns * (size_t)_nRows;
+  std::vector<const unsigned int*> tRows;
+  std::vector<unsigned int> tBuffer;
+  for (size_t iBlock = 0; iBlock < tNpixel / __HIST_TILE_SIZE; ++iBlock){
+	  getOccupancyBlock(iBlock, tRows, tBuffer);
+	  for (size_t k = 0; k < tRows.size(); ++k){
+		  unsigned int* tTarget = rTarget + k * tNpixel + iBlock * __HIST_TILE_SIZE;
+		  if (tRows[k] != 0)
+			  std::copy(tRows[k], tRows[k] + __HIST_TILE_SIZE, tTarget);
+		  else
+			  std::fill(tTarget, tTarget + __HIST_TILE_SIZE, 0);
+	  }
+  }
+}
+
+void Histogram::resetTdcPixelArray()
+{
+  info("resetTdcPixelArray()");
+  if (_createTdcPixelHist){
+	  if (_tdcPixel.allocated())
+		  _tdcPixel.reset();
+	  else
+		  throw std::runtime_error("Output TDC pixel array array not set.");
+  }
+}
+
+void Histogram::resetTdcPixelMomentsArray()
+{
+  info("resetTdcPixelMomentsArray()");
+  if (_tdcPixelCount != 0){
+	  std::fill(_tdcPixelCount, _tdcPixelCount + (size_t)_nColumns * (size_t)_nRows, 0);
+	  std::fill(_tdcPixelSum, _tdcPixelSum + (size_t)_nColumns * (size_t)_nRows, 0);
+	  std::fill(_tdcPixelSquareSum, _tdcPixelSquareSum + (size_t)_nColumns * (size_t)_nRows, 0);
+	  std::fill(_tdcPixelMin, _tdcPixelMin + (size_t)_nColumns * (size_t)_nRows, 0);
+	  std::fill(_tdcPixelMax, _tdcPixelMax + (size_t)_nColumns * (size_t)_nRows, 0);
+  }
+}
+
+void Histogram::resetTotPixelArray()
+{
+  info("resetTotPixelArray()");
+  if (_createTotPixelHist){
+	  if (_totPixel.allocated())
+		  _totPixel.reset();
+	  else
+		  throw std::runtime_error("Output ToT pixel array array not set.");
+  }
+}
+
+void Histogram::allocateTotArray()
+{
+  debug("allocateTotArray()");
+  deleteTotArray();
+  try{
+    _tot = new unsigned int[16];
+  }
+  catch(std::bad_alloc& exception){
+    error(std::string("allocateTotArray: ")+std::string(exception.what()));
+  }
+}
+
+void Histogram::allocateTdcArray()
+{
+	debug("allocateTdcArray()");
+	deleteTdcArray();
+	try{
+	_tdc = new unsigned int[__N_TDC_VALUES];
+	}
+	catch(std::bad_alloc& exception){
+	error(std::string("allocateTdcArray: ")+std::string(exception.what()));
+	}
+}
+
+void Histogram::allocateTdcTriggerDistanceArray()
+{
+	debug("allocateTdcTriggerDistanceArray()");
+	deleteTdcTriggerDistanceArray();
+	try{
+	_tdcTriggerDistance = new unsigned int[__N_TDC_DIST_VALUES];
+	}
+	catch(std::bad_alloc& exception){
+	error(std::string("allocateTdcTriggerDistanceArray: ")+std::string(exception.what()));
+	}
+}
+
+void Histogram::resetTotArray()
+{
+  info("resetTotArray()");
+  if (_createTotHist){
+	  if (_tot != 0){
+		  for (unsigned int i = 0; i < 16; i++)
+			_tot[(size_t)i] = 0;
+	  }
+  }
+}
+
+void Histogram::resetTdcArray()
+{
+  info("resetTdcArray()");
+  if (_createTdcHist){
+	  if (_tdc != 0){
+		  for (unsigned int i = 0; i < __N_TDC_VALUES; i++)
+			_tdc[(size_t)i] = 0;
+	  }
+  }
+}
+
+void Histogram::resetTdcTriggerDistanceArray()
+{
+	info("resetTdcTriggerDistanceArray()");
+	if (_createTdcTriggerDistanceHist){
+		if (_tdcTriggerDistance != 0){
+			for (unsigned int i = 0; i < __N_TDC_DIST_VALUES; i++)
+			_tdcTriggerDistance[(size_t)i] = 0;
+		}
+	}
+}
+	
+void Histogram::deleteTotArray()
+{
+  debug("deleteTotArray()");
+  if (_tot != 0)
+    delete[] _tot;
+  _tot = 0;
+}
+
+void Histogram::deleteTdcArray()
+{
+  debug("deleteTdcArray()");
+  if (_tdc != 0)
+    delete[] _tdc;
+  _tdc = 0;
+}
+
+void Histogram::deleteTdcTriggerDistanceArray()
+{
+	debug("deleteTdcTriggerDistanceArray()");
+	if (_tdcTriggerDistance != 0)
+	delete[] _tdcTriggerDistance;
+	_tdcTriggerDistance = 0;
+}
+
+void Histogram::allocateRelBcidArray()
+{
+  debug("allocateRelBcidArray");
+  deleteRelBcidArray();
+  try{
+     _relBcid = new unsigned int[__MAXBCID];
+  }
+  catch(std::bad_alloc& exception){
+    error(std::string("allocateRelBcidArray: ")+std::string(exception.what()));
+  }
+}
+
+void Histogram::resetRelBcidArray()
 {
   info("resetRelBcidArray()");
   if (_createRelBCIDhist){
@@ -514,6 +1478,33 @@ void Histogram::resetRelBcidArray()
   }
 }
   
+void Histogram::resetTimeHist()
+{
+  info("resetTimeHist()");
+  std::fill(_timeHistEvents.begin(), _timeHistEvents.end(), 0);
+  std::fill(_timeHistHits.begin(), _timeHistHits.end(), 0);
+  std::fill(_timeHistTdc.begin(), _timeHistTdc.end(), 0);
+  std::fill(_timeHistErrors.begin(), _timeHistErrors.end(), 0);
+  std::fill(_timeHistRegions.begin(), _timeHistRegions.end(), 0);
+  _timeHistFirstBin = 0;
+  _timeHistLastBin = -1;
+  _timeHistLastEventNumber = -1;
+  _timeHistOriginSet = false;
+  _nTimeHistLostHits = 0;
+}
+
+void Histogram::resetDecayingOccupancyArray()
+{
+  info("resetDecayingOccupancyArray()");
+  if (_createDecayingOccupancyHist){
+	  _decayingOccupancy.assign((size_t)_nColumns * (size_t)_nRows, 0.);
+	  _decayTileFactor.assign(_decayingOccupancy.size() / __HIST_TILE_SIZE, 1.);
+  }
+  _decayOrigin = 0.;
+  _decayEventNumber = 0.;
+  _decayStarted = false;
+}
+
 void Histogram::deleteRelBcidArray()
 {
   debug("deleteRelBcidArray");
@@ -527,7 +1518,7 @@ void Histogram::allocateTotPixelArray()
   debug("allocateTotPixelArray()");
   deleteTotPixelArray();
   try{
-	  _totPixel = new unsigned short[(size_t)RAW_DATA_MAX_COLUMN * (size_t) RAW_DATA_MAX_ROW * 16];
+	  _totPixel.allocate((size_t)_nColumns * (size_t)_nRows * 16);
   }
   catch(std::bad_alloc& exception){
     error(std::string("allocateTotPixelArray: ")+std::string(exception.what()));
@@ -536,30 +1527,64 @@ void Histogram::allocateTotPixelArray()
 
 void Histogram::allocateTdcPixelArray()
 {
-  debug("allocateTdcPixelArray()");
+  debug("allocateTdcPixelArray() with "+IntToStr(getNtdcPixelHistBins())+" bins");
   deleteTdcPixelArray();
   try{
-	  _tdcPixel = new unsigned short[(size_t) RAW_DATA_MAX_COLUMN * (size_t) RAW_DATA_MAX_ROW * (size_t)__N_TDC_VALUES];
+	  if(_storageFileName.empty())
+		  _tdcPixel.allocate((size_t)_nColumns * (size_t)_nRows * (size_t)getNtdcPixelHistBins(), _sparseTdcPixelHist);
+	  else if(_tdcPixel.allocateMapped((size_t)_nColumns * (size_t)_nRows * (size_t)getNtdcPixelHistBins(), _storageFileName + "_tdc_pixel.dat", getNtdcPixelHistBins(), false, std::vector<int>(), _resumeStorage))
+		  info("allocateTdcPixelArray: content of "+_storageFileName+"_tdc_pixel.dat resumed");
   }
   catch(std::bad_alloc& exception){
     error(std::string("allocateTdcPixelArray: ")+std::string(exception.what()));
   }
 }
 
+void Histogram::allocateTdcPixelMomentsArray()
+{
+  debug("allocateTdcPixelMomentsArray()");
+  deleteTdcPixelMomentsArray();
+  try{
+	  _tdcPixelCount = new unsigned int[(size_t)_nColumns * (size_t)_nRows];
+	  _tdcPixelSum = new uint64_t[(size_t)_nColumns * (size_t)_nRows];
+	  _tdcPixelSquareSum = new uint64_t[(size_t)_nColumns * (size_t)_nRows];
+	  _tdcPixelMin = new unsigned short[(size_t)_nColumns * (size_t)_nRows];
+	  _tdcPixelMax = new unsigned short[(size_t)_nColumns * (size_t)_nRows];
+  }
+  catch(std::bad_alloc& exception){
+    error(std::string("allocateTdcPixelMomentsArray: ")+std::string(exception.what()));
+    deleteTdcPixelMomentsArray();
+  }
+}
+
 void Histogram::deleteTotPixelArray()
 {
   debug("deleteTotPixelArray");
-  if (_totPixel != 0)
-    delete[] _totPixel;
-  _totPixel = 0;
+  _totPixel.clear();
 }
 
 void Histogram::deleteTdcPixelArray()
 {
   debug("deleteTdcPixelArray");
-  if (_tdcPixel != 0)
-    delete[] _tdcPixel;
-  _tdcPixel = 0;
+  _tdcPixel.clear();
+  if (_tdcPixelExport != 0)
+    delete[] _tdcPixelExport;
+  _tdcPixelExport = 0;
+}
+
+void Histogram::deleteTdcPixelMomentsArray()
+{
+  debug("deleteTdcPixelMomentsArray");
+  delete[] _tdcPixelCount;
+  _tdcPixelCount = 0;
+  delete[] _tdcPixelSum;
+  _tdcPixelSum = 0;
+  delete[] _tdcPixelSquareSum;
+  _tdcPixelSquareSum = 0;
+  delete[] _tdcPixelMin;
+  _tdcPixelMin = 0;
+  delete[] _tdcPixelMax;
+  _tdcPixelMax = 0;
 }
 
 void Histogram::test()
@@ -588,15 +1613,639 @@ void Histogram::getOccupancy(unsigned int& rNparameterValues, unsigned int*& rOc
 {
   debug("getOccupancy(...)");
   if(copy){
-	  unsigned int tArrayLength = (size_t)(RAW_DATA_MAX_COLUMN-1) + (size_t)(RAW_DATA_MAX_ROW-1) * (size_t)RAW_DATA_MAX_COLUMN + (size_t)(_NparameterValues-1) * (size_t)RAW_DATA_MAX_COLUMN * (size_t)RAW_DATA_MAX_ROW+1;
-	  std::copy(_occupancy, _occupancy+tArrayLength, rOccupancy);
+	  if(_occupancy.allocated())
+		  exportOccupancy(rOccupancy);
+  }
+  else if(_occupancy.sparse() || _pixelMajorOccupancy){  // sparse tiles and the pixel-major layout have to be exported to a dense array
+	  if(_occupancyExport == 0)
+		  _occupancyExport = new unsigned int[_occupancy.size()];
+	  exportOccupancy(_occupancyExport);
+	  rOccupancy = _occupancyExport;
   }
   else
-	  rOccupancy = _occupancy;
+	  rOccupancy = _occupancy.data();
 
   rNparameterValues = _NparameterValues;
 }
 
+void Histogram::createSnapshots(bool CreateSnapshots)
+{
+  MutexLock tLock(_fillMutex);
+  _createSnapshots = CreateSnapshots;
+  clearSnapshots();  // the dense fill loops do not mark the tiles without snapshots, thus the next publishing copies all tiles
+  if (_createSnapshots)
+	  publishSnapshot();  // the first snapshot shows the actual histograms
+}
+
+void Histogram::takeSnapshot()
+{
+  debug("takeSnapshot()");
+  //no copy, the last published buffer becomes the snapshot and the old snapshot buffer is reused for publishing
+  //the locks only cover the buffer index exchange, thus addHits never waits for a snapshot and takeSnapshot never waits for addHits
+  if (!_createSnapshots)
+	  throw std::runtime_error("Snapshots not created. Call createSnapshots first!");
+  MutexLock tLock(_snapshotMutex);
+  MutexLock tPublishLock(_publishMutex);
+  if (_snapshotFresh){  // otherwise the snapshot is still the last published buffer
+	  std::swap(_snapshotIndex, _snapshotReady);
+	  _snapshotFresh = false;
+  }
+  _nSnapshots++;
+}
+
+void Histogram::publishSnapshot()
+{
+  //the publishing buffer is neither the snapshot nor the last published buffer, thus it is written without a lock
+  //the dirty bits of a tile are per buffer, thus only the tiles changed since this buffer was written last are copied
+  if (_occupancy.allocated())
+	  snapshotTiles(_occupancy, _snapshotOccupancy[_snapshotWork], _snapshotWork, _pixelMajorOccupancy);
+  else
+	  _snapshotOccupancy[_snapshotWork].clear();
+  if (_occupancy.allocated() && _totSum.allocated()){
+	  snapshotTiles(_totSum, _snapshotTotSum[_snapshotWork], _snapshotWork, _pixelMajorOccupancy);
+	  snapshotTiles(_totSquareSum, _snapshotTotSquareSum[_snapshotWork], _snapshotWork, _pixelMajorOccupancy);
+  }
+  else{
+	  _snapshotTotSum[_snapshotWork].clear();
+	  _snapshotTotSquareSum[_snapshotWork].clear();
+  }
+  if (_tdcPixel.allocated())
+	  snapshotTiles(_tdcPixel, _snapshotTdcPixel[_snapshotWork], _snapshotWork, false);
+  else
+	  _snapshotTdcPixel[_snapshotWork].clear();
+  if (_totPixel.allocated())
+	  snapshotTiles(_totPixel, _snapshotTotPixel[_snapshotWork], _snapshotWork, false);
+  else
+	  _snapshotTotPixel[_snapshotWork].clear();
+  const size_t tNpixel = (size_t)_nColumns * (size_t)_nRows;
+  snapshotArray(_tot, 16, _snapshotTot[_snapshotWork]);
+  snapshotArray(_tdc, __N_TDC_VALUES, _snapshotTdc[_snapshotWork]);
+  snapshotArray(_tdcTriggerDistance, __N_TDC_DIST_VALUES, _snapshotTdcTriggerDistance[_snapshotWork]);
+  snapshotArray(_relBcid, __MAXBCID, _snapshotRelBcid[_snapshotWork]);
+  snapshotArray(_tdcPixelCount, tNpixel, _snapshotTdcPixelCount[_snapshotWork]);
+  snapshotArray(_tdcPixelSum, tNpixel, _snapshotTdcPixelSum[_snapshotWork]);
+  snapshotArray(_tdcPixelSquareSum, tNpixel, _snapshotTdcPixelSquareSum[_snapshotWork]);
+  snapshotArray(_tdcPixelMin, tNpixel, _snapshotTdcPixelMin[_snapshotWork]);
+  snapshotArray(_tdcPixelMax, tNpixel, _snapshotTdcPixelMax[_snapshotWork]);
+  MutexLock tLock(_publishMutex);
+  std::swap(_snapshotWork, _snapshotReady);
+  _snapshotFresh = true;
+}
+
+void Histogram::clearSnapshots()
+{
+  MutexLock tLock(_snapshotMutex);
+  MutexLock tPublishLock(_publishMutex);
+  _snapshotFresh = false;
+  for (unsigned int i = 0; i < __N_SNAPSHOT_BUFFERS; ++i){
+	  _snapshotOccupancy[i].clear();
+	  _snapshotTot[i].clear();
+	  _snapshotTdc[i].clear();
+	  _snapshotTdcTriggerDistance[i].clear();
+	  _snapshotRelBcid[i].clear();
+	  _snapshotTotPixel[i].clear();
+	  _snapshotTdcPixel[i].clear();
+	  _snapshotTotSum[i].clear();
+	  _snapshotTotSquareSum[i].clear();
+	  _snapshotTdcPixelCount[i].clear();
+	  _snapshotTdcPixelSum[i].clear();
+	  _snapshotTdcPixelSquareSum[i].clear();
+	  _snapshotTdcPixelMin[i].clear();
+	  _snapshotTdcPixelMax[i].clear();
+  }
+}
+
+template<class T> void Histogram::snapshotTiles(TiledArray<T>& rSource, std::vector<T>& rTarget, const unsigned int& rBuffer, const bool& rExportOrder)
+{
+  bool tFullCopy = rTarget.size() != rSource.size();  // new buffer or reallocated histogram
+  if (tFullCopy)
+	  rTarget.assign(rSource.size(), 0);
+#pragma omp parallel for num_threads((int) getNthreads())
+  for (int iTile = 0; iTile < (int) rSource.nTiles(); ++iTile){
+	  if (!rSource.takeDirty((size_t) iTile, rBuffer) && !tFullCopy)
+		  continue;
+	  const T* tTile = rSource.tile((size_t) iTile);
+	  for (unsigned int i = 0; i < __HIST_TILE_SIZE; ++i){
+		  size_t tIndex = (size_t) iTile * __HIST_TILE_SIZE + i;
+		  rTarget[rExportOrder ? getExportIndex(tIndex) : tIndex] = tTile != 0 ? tTile[i] : 0;
+	  }
+  }
+}
+
+template<class T> void Histogram::snapshotArray(const T* rSource, const size_t& rSize, std::vector<T>& rTarget)
+{
+  if (rSource == 0)
+	  rTarget.clear();
+  else
+	  rTarget.assign(rSource, rSource + rSize);  // no reallocation for the same size
+}
+
+unsigned int Histogram::getNsnapshots()
+{
+  MutexLock tLock(_snapshotMutex);
+  return _nSnapshots;
+}
+
+void Histogram::getSnapshotOccupancy(unsigned int& rNparameterValues, unsigned int*& rOccupancy)
+{
+  MutexLock tLock(_snapshotMutex);
+  std::vector<unsigned int>& tSnapshot = _snapshotOccupancy[_snapshotIndex];
+  rNparameterValues = (unsigned int) (tSnapshot.size() / ((size_t)_nColumns * (size_t)_nRows));
+  rOccupancy = tSnapshot.empty() ? 0 : &tSnapshot[0];
+}
+
+void Histogram::getSnapshotTotHist(unsigned int*& rTotHist)
+{
+  MutexLock tLock(_snapshotMutex);
+  rTotHist = _snapshotTot[_snapshotIndex].empty() ? 0 : &_snapshotTot[_snapshotIndex][0];
+}
+
+void Histogram::getSnapshotTdcHist(unsigned int*& rTdcHist)
+{
+  MutexLock tLock(_snapshotMutex);
+  rTdcHist = _snapshotTdc[_snapshotIndex].empty() ? 0 : &_snapshotTdc[_snapshotIndex][0];
+}
+
+void Histogram::getSnapshotTdcTriggerDistanceHist(unsigned int*& rTdcTriggerDistanceHist)
+{
+  MutexLock tLock(_snapshotMutex);
+  rTdcTriggerDistanceHist = _snapshotTdcTriggerDistance[_snapshotIndex].empty() ? 0 : &_snapshotTdcTriggerDistance[_snapshotIndex][0];
+}
+
+void Histogram::getSnapshotRelBcidHist(unsigned int*& rRelBcidHist)
+{
+  MutexLock tLock(_snapshotMutex);
+  rRelBcidHist = _snapshotRelBcid[_snapshotIndex].empty() ? 0 : &_snapshotRelBcid[_snapshotIndex][0];
+}
+
+void Histogram::getSnapshotTotPixelHist(unsigned short*& rTotPixelHist)
+{
+  MutexLock tLock(_snapshotMutex);
+  rTotPixelHist = _snapshotTotPixel[_snapshotIndex].empty() ? 0 : &_snapshotTotPixel[_snapshotIndex][0];
+}
+
+void Histogram::getSnapshotTdcPixelHist(unsigned int& rNbins, unsigned short*& rTdcPixelHist)
+{
+  MutexLock tLock(_snapshotMutex);
+  std::vector<unsigned short>& tSnapshot = _snapshotTdcPixel[_snapshotIndex];
+  rNbins = (unsigned int) (tSnapshot.size() / ((size_t)_nColumns * (size_t)_nRows));
+  rTdcPixelHist = tSnapshot.empty() ? 0 : &tSnapshot[0];
+}
+
+bool Histogram::getSnapshotMeanTot(float* rMeanTot, float* rTotRms)
+{
+  MutexLock tLock(_snapshotMutex);
+  const std::vector<unsigned int>& tOccupancy = _snapshotOccupancy[_snapshotIndex];
+  const std::vector<unsigned int>& tTotSum = _snapshotTotSum[_snapshotIndex];
+  const std::vector<uint64_t>& tTotSquareSum = _snapshotTotSquareSum[_snapshotIndex];
+  if (tTotSum.empty() || tTotSum.size() != tOccupancy.size())
+	  return false;
+  for (size_t i = 0; i < tOccupancy.size(); ++i){  // as calculateMeanTot/calculateTotRms, the snapshot is already in the export order
+	  if (tOccupancy[i] != 0){
+		  double tMean = (double) tTotSum[i] / (double) tOccupancy[i];
+		  double tVariance = (double) tTotSquareSum[i] / (double) tOccupancy[i] - tMean * tMean;
+		  rMeanTot[i] = (float) tMean;
+		  rTotRms[i] = (float) sqrt(std::max(tVariance, 0.));
+	  }
+	  else{
+		  rMeanTot[i] = NAN;
+		  rTotRms[i] = NAN;
+	  }
+  }
+  return true;
+}
+
+bool Histogram::getSnapshotTdcPixelMoments(unsigned int* rCount, float* rMean, float* rRms, unsigned short* rMin, unsigned short* rMax)
+{
+  MutexLock tLock(_snapshotMutex);
+  const std::vector<unsigned int>& tCount = _snapshotTdcPixelCount[_snapshotIndex];
+  if (tCount.empty())
+	  return false;
+  std::copy(tCount.begin(), tCount.end(), rCount);
+  std::copy(_snapshotTdcPixelMin[_snapshotIndex].begin(), _snapshotTdcPixelMin[_snapshotIndex].end(), rMin);
+  std::copy(_snapshotTdcPixelMax[_snapshotIndex].begin(), _snapshotTdcPixelMax[_snapshotIndex].end(), rMax);
+  calculateTdcPixelMoments(tCount.size(), &tCount[0], &_snapshotTdcPixelSum[_snapshotIndex][0], &_snapshotTdcPixelSquareSum[_snapshotIndex][0], rMean, rRms);
+  return true;
+}
+
+void Histogram::setParameterValues(const int* rParameterValues, const unsigned int& rNparameterValues)
+{
+  debug("setParameterValues(...)");
+  if(rNparameterValues != getNparameters())
+	  throw std::invalid_argument("The number of parameter values has to equal the number of parameters.");
+  std::map<int, unsigned int> tParameterValues;
+  for(unsigned int i = 0; i < rNparameterValues; ++i)
+	  tParameterValues[rParameterValues[i]] = i;
+  if(tParameterValues.size() != rNparameterValues)
+	  throw std::invalid_argument("The parameter values have to be unique.");
+  _parameterValues = tParameterValues;
+  _parIndexMap.clear();  // the parameter indices refer to these values
+}
+
+void Histogram::getParameterValues(std::vector<int>& rParameterValues)
+{
+  rParameterValues.resize(getNparameters());
+  if(_parameterValues.size() != getNparameters()){  // no scan parameter: the parameter index
+	  for(unsigned int i = 0; i < getNparameters(); ++i)
+		  rParameterValues[i] = (int) i;
+	  return;
+  }
+  for(std::map<int, unsigned int>::iterator it = _parameterValues.begin(); it != _parameterValues.end(); ++it)
+	  rParameterValues[it->second] = it->first;
+}
+
+void Histogram::merge(Histogram& rHistogram)
+{
+  debug("merge(...)");
+  checkMerge(rHistogram);
+  unsigned int tNsaturated = mergeHistograms(rHistogram);
+  if(tNsaturated != 0)
+	  warning("merge: "+IntToStr(tNsaturated)+" hits not added to saturated ToT or TDC pixel histogram bins");
+}
+
+void Histogram::checkMerge(Histogram& rHistogram)
+{
+  if(&rHistogram == this)
+	  throw std::invalid_argument("A histogram cannot be merged into itself.");
+  if(_nChips != rHistogram._nChips)
+	  throw std::invalid_argument("Histograms of different module layouts cannot be merged.");
+  if(_tdcPixel.allocated() && rHistogram._tdcPixel.allocated() && _tdcPixelBinWidth != rHistogram._tdcPixelBinWidth)
+	  throw std::invalid_argument("TDC pixel histograms with different bin widths cannot be merged.");
+  if(_createOccHist && rHistogram.mergesOccupancy()){
+	  if(!_occupancy.allocated())
+		  throw std::runtime_error("Occupancy array not initialized. Set scan parameter first!.");
+	  if(_totSum.allocated() && !rHistogram._totSum.allocated())  // the mean ToT would be wrong
+		  throw std::invalid_argument("A histogram without mean ToT cannot be merged into one with mean ToT.");
+  }
+}
+
+bool Histogram::mergesOccupancy()
+{
+  return _createOccHist && _occupancy.allocated();
+}
+
+unsigned int Histogram::mergeHistograms(Histogram& rHistogram)
+{
+  //the ToT sums and square sums are merged instead of the mean ToT, thus mean and RMS are exact
+  if(_createOccHist && rHistogram.mergesOccupancy()){
+	  std::vector<unsigned int> tParIndex;
+	  mergeParameterValues(rHistogram, tParIndex);
+	  addOccupancyTiles(rHistogram._occupancy, rHistogram._pixelMajorOccupancy, tParIndex, _occupancy);
+	  if(_totSum.allocated()){
+		  addOccupancyTiles(rHistogram._totSum, rHistogram._pixelMajorOccupancy, tParIndex, _totSum);
+		  addOccupancyTiles(rHistogram._totSquareSum, rHistogram._pixelMajorOccupancy, tParIndex, _totSquareSum);
+	  }
+  }
+  if(_tot != 0 && rHistogram._tot != 0)
+	  addArray(rHistogram._tot, 16, _tot);
+  if(_tdc != 0 && rHistogram._tdc != 0)
+	  addArray(rHistogram._tdc, __N_TDC_VALUES, _tdc);
+  if(_tdcTriggerDistance != 0 && rHistogram._tdcTriggerDistance != 0)
+	  addArray(rHistogram._tdcTriggerDistance, __N_TDC_DIST_VALUES, _tdcTriggerDistance);
+  if(_relBcid != 0 && rHistogram._relBcid != 0)
+	  addArray(rHistogram._relBcid, __MAXBCID, _relBcid);
+  unsigned int tNsaturated = 0;
+  if(_totPixel.allocated() && rHistogram._totPixel.allocated())
+	  tNsaturated += addTilesSaturated(rHistogram._totPixel, _totPixel);
+  if(_tdcPixel.allocated() && rHistogram._tdcPixel.allocated())
+	  tNsaturated += addTilesSaturated(rHistogram._tdcPixel, _tdcPixel);
+  if(_tdcPixelCount != 0 && rHistogram._tdcPixelCount != 0){
+	  for(size_t i = 0; i < (size_t)_nColumns * (size_t)_nRows; ++i){
+		  if(rHistogram._tdcPixelCount[i] == 0)
+			  continue;
+		  if(_tdcPixelCount[i] == 0 || rHistogram._tdcPixelMin[i] < _tdcPixelMin[i])
+			  _tdcPixelMin[i] = rHistogram._tdcPixelMin[i];
+		  if(_tdcPixelCount[i] == 0 || rHistogram._tdcPixelMax[i] > _tdcPixelMax[i])
+			  _tdcPixelMax[i] = rHistogram._tdcPixelMax[i];
+		  _tdcPixelCount[i] += rHistogram._tdcPixelCount[i];
+		  _tdcPixelSum[i] += rHistogram._tdcPixelSum[i];
+		  _tdcPixelSquareSum[i] += rHistogram._tdcPixelSquareSum[i];
+	  }
+  }
+  return tNsaturated;
+}
+
+unsigned int Histogram::addTilesSaturated(const TiledArray<unsigned short>& rSource, TiledArray<unsigned short>& rTarget)
+{
+  unsigned int tNsaturated = 0;
+  for(size_t iTile = 0; iTile < rSource.nTiles(); ++iTile){
+	  const unsigned short* tTile = rSource.tile(iTile);
+	  if(tTile == 0)
+		  continue;
+	  for(unsigned int i = 0; i < __HIST_TILE_SIZE; ++i){
+		  if(tTile[i] == 0)  // only bins with hits are written to not allocate empty tiles in sparse mode
+			  continue;
+		  unsigned short& tBin = rTarget[iTile * __HIST_TILE_SIZE + i];
+		  unsigned int tSum = (unsigned int) tBin + (unsigned int) tTile[i];
+		  if(tSum > std::numeric_limits<unsigned short>::max()){  // saturate like fillTdcPixelHist
+			  tNsaturated += tSum - std::numeric_limits<unsigned short>::max();
+			  tSum = std::numeric_limits<unsigned short>::max();
+		  }
+		  tBin = (unsigned short) tSum;
+	  }
+  }
+  return tNsaturated;
+}
+
+void Histogram::addParameterValues(const std::vector<int>& rParameterValues)
+{
+  std::vector<int> tValues;
+  getParameterValues(tValues);
+  std::map<int, unsigned int> tIndex;
+  for(unsigned int i = 0; i < tValues.size(); ++i)
+	  tIndex[tValues[i]] = i;
+  for(unsigned int i = 0; i < rParameterValues.size(); ++i)
+	  tIndex.insert(std::make_pair(rParameterValues[i], 0));
+  if(tIndex.size() == tValues.size())
+	  return;
+
+  //new parameter values: the histograms are reallocated with the sorted union of the parameter values
+  info("merge: "+IntToStr((unsigned int) (tIndex.size() - tValues.size()))+" parameter values added");
+  unsigned int tNewIndex = 0;
+  for(std::map<int, unsigned int>::iterator it = tIndex.begin(); it != tIndex.end(); ++it)
+	  it->second = tNewIndex++;
+  std::vector<unsigned int> tOldParIndex(tValues.size());
+  for(unsigned int i = 0; i < tValues.size(); ++i)
+	  tOldParIndex[i] = tIndex[tValues[i]];
+  TiledArray<unsigned int> tOccupancy;
+  TiledArray<unsigned int> tTotSum;
+  TiledArray<uint64_t> tTotSquareSum;
+  tOccupancy.swap(_occupancy);
+  tTotSum.swap(_totSum);
+  tTotSquareSum.swap(_totSquareSum);
+  tOccupancy.detach();  // the storage files are reallocated
+  tTotSum.detach();
+  tTotSquareSum.detach();
+  _NparameterValues = (unsigned int) tIndex.size();
+  _parameterValues = tIndex;
+  if(_parIndexMap.empty())  // the indices of _parInfo address the old parameters, thus they are mapped to the new ones
+	  _parIndexMap = tOldParIndex;
+  else{
+	  for(unsigned int i = 0; i < _parIndexMap.size(); ++i)
+		  _parIndexMap[i] = tOldParIndex[_parIndexMap[i]];
+  }
+  allocateOccupancyArray();
+  addOccupancyTiles(tOccupancy, _pixelMajorOccupancy, tOldParIndex, _occupancy);
+  if(tTotSum.allocated()){
+	  allocateMeanTotArray();
+	  addOccupancyTiles(tTotSum, _pixelMajorOccupancy, tOldParIndex, _totSum);
+	  addOccupancyTiles(tTotSquareSum, _pixelMajorOccupancy, tOldParIndex, _totSquareSum);
+  }
+}
+
+void Histogram::mergeParameterValues(Histogram& rHistogram, std::vector<unsigned int>& rParIndex)
+{
+  std::vector<int> tOtherValues;
+  rHistogram.getParameterValues(tOtherValues);
+  addParameterValues(tOtherValues);
+  std::vector<int> tValues;
+  getParameterValues(tValues);
+  std::map<int, unsigned int> tIndex;
+  for(unsigned int i = 0; i < tValues.size(); ++i)
+	  tIndex[tValues[i]] = i;
+  rParIndex.resize(tOtherValues.size());
+  for(unsigned int i = 0; i < tOtherValues.size(); ++i)
+	  rParIndex[i] = tIndex[tOtherValues[i]];
+}
+
+template<class T> void Histogram::addOccupancyTiles(const TiledArray<T>& rSource, const bool& rSourcePixelMajor, const std::vector<unsigned int>& rParIndex, TiledArray<T>& rTarget)
+{
+  const size_t tNpixel = (size_t)_nColumns * (size_t)_nRows;
+  const size_t tNparameters = rParIndex.size();
+  for(size_t iTile = 0; iTile < rSource.nTiles(); ++iTile){
+	  const T* tTile = rSource.tile(iTile);
+	  if(tTile == 0)
+		  continue;
+	  for(unsigned int i = 0; i < __HIST_TILE_SIZE; ++i){
+		  if(tTile[i] == 0)  // only entries with hits are written to not allocate empty tiles in sparse mode
+			  continue;
+		  size_t tIndex = iTile * __HIST_TILE_SIZE + i;
+		  size_t tPixel = rSourcePixelMajor ? tIndex / tNparameters : tIndex % tNpixel;
+		  size_t tParIndex = rSourcePixelMajor ? tIndex % tNparameters : tIndex / tNpixel;
+		  rTarget[getOccupancyIndex(tPixel, rParIndex[tParIndex])] += tTile[i];
+	  }
+  }
+}
+
+void Histogram::reduce(std::vector<Histogram*>& rHistograms)
+{
+  if(rHistograms.size() < 2)
+	  return;
+  //the merges are checked and the parameter values are added serially before, thus the parallel merges do not reallocate the occupancy and do not throw for invalid histograms
+  std::vector<std::vector<int> > tValues(rHistograms.size());  // parameter values of each histogram after its merges
+  for(size_t i = 0; i < rHistograms.size(); ++i){
+	  if(rHistograms[i]->mergesOccupancy())
+		  rHistograms[i]->getParameterValues(tValues[i]);
+  }
+  for(size_t tStride = 1; tStride < rHistograms.size(); tStride *= 2){
+	  for(size_t i = 0; i + tStride < rHistograms.size(); i += 2 * tStride){
+		  rHistograms[i]->checkMerge(*rHistograms[i + tStride]);
+		  if(rHistograms[i]->_createOccHist && rHistograms[i + tStride]->mergesOccupancy())
+			  tValues[i].insert(tValues[i].end(), tValues[i + tStride].begin(), tValues[i + tStride].end());
+	  }
+  }
+  for(size_t i = 0; i < rHistograms.size(); ++i){
+	  if(rHistograms[i]->mergesOccupancy())
+		  rHistograms[i]->addParameterValues(tValues[i]);
+  }
+
+  //exceptions cannot leave a parallel region, the first one (e.g. std::bad_alloc) is thrown again afterwards
+  std::string tError;
+  unsigned int tNsaturated = 0;
+  for(size_t tStride = 1; tStride < rHistograms.size() && tError.empty(); tStride *= 2){
+#pragma omp parallel for schedule(dynamic) num_threads((int) rHistograms[0]->getNthreads()) reduction(+:tNsaturated)
+	  for(int i = 0; i < (int) rHistograms.size(); i += (int) (2 * tStride)){
+		  if((size_t) i + tStride >= rHistograms.size())
+			  continue;
+		  try{
+			  tNsaturated += rHistograms[i]->mergeHistograms(*rHistograms[i + tStride]);
+		  }
+		  catch(std::exception& exception){
+#pragma omp critical
+			  {
+				  if(tError.empty())
+					  tError = exception.what();
+			  }
+		  }
+	  }
+  }
+  if(!tError.empty())
+	  throw std::runtime_error(tError);
+  if(tNsaturated != 0)
+	  rHistograms[0]->warning("reduce: "+rHistograms[0]->IntToStr(tNsaturated)+" hits not added to saturated ToT or TDC pixel histogram bins");
+}
+
+void Histogram::serialize(std::vector<unsigned char>& rBlob)
+{
+  debug("serialize(...)");
+  const size_t tNpixel = (size_t)_nColumns * (size_t)_nRows;
+  std::vector<int> tValues;
+  getParameterValues(tValues);
+  bool tOccupancy = _createOccHist && _occupancy.allocated();
+  //flag bits: occupancy, ToT sums, ToT, TDC, TDC trigger distance, relative BCID, ToT pixel, TDC pixel, TDC pixel moments histogram
+  unsigned int tFlags = (tOccupancy ? 1 : 0) | (tOccupancy && _totSum.allocated() ? 2 : 0) | (_tot != 0 ? 4 : 0) | (_tdc != 0 ? 8 : 0) | (_tdcTriggerDistance != 0 ? 16 : 0) | (_relBcid != 0 ? 32 : 0) | (_totPixel.allocated() ? 64 : 0) | (_tdcPixel.allocated() ? 128 : 0) | (_tdcPixelCount != 0 ? 256 : 0);
+  unsigned int tHeader[5] = {__HIST_BLOB_ID, __HIST_BLOB_VERSION, _nChips, (unsigned int) tValues.size(), tFlags};
+  rBlob.clear();
+  writeBlob(rBlob, tHeader, 5);
+  writeBlob(rBlob, &tValues[0], tValues.size());
+  if(tFlags & 1)
+	  writeBlobTiles(rBlob, _occupancy, _pixelMajorOccupancy);
+  if(tFlags & 2){
+	  writeBlobTiles(rBlob, _totSum, _pixelMajorOccupancy);
+	  writeBlobTiles(rBlob, _totSquareSum, _pixelMajorOccupancy);
+  }
+  if(tFlags & 4)
+	  writeBlob(rBlob, _tot, 16);
+  if(tFlags & 8)
+	  writeBlob(rBlob, _tdc, __N_TDC_VALUES);
+  if(tFlags & 16)
+	  writeBlob(rBlob, _tdcTriggerDistance, __N_TDC_DIST_VALUES);
+  if(tFlags & 32)
+	  writeBlob(rBlob, _relBcid, __MAXBCID);
+  if(tFlags & 64)
+	  writeBlob(rBlob, _totPixel.data(), tNpixel * 16);
+  if(tFlags & 128){
+	  writeBlob(rBlob, &_tdcPixelBinWidth, 1);
+	  writeBlobTiles(rBlob, _tdcPixel, false);
+  }
+  if(tFlags & 256){
+	  writeBlob(rBlob, _tdcPixelCount, tNpixel);
+	  writeBlob(rBlob, _tdcPixelSum, tNpixel);
+	  writeBlob(rBlob, _tdcPixelSquareSum, tNpixel);
+	  writeBlob(rBlob, _tdcPixelMin, tNpixel);
+	  writeBlob(rBlob, _tdcPixelMax, tNpixel);
+  }
+}
+
+void Histogram::mergeSerialized(const unsigned char* rBlob, const size_t& rSize)
+{
+  debug("mergeSerialized(...)");
+  Histogram tHistogram;
+  tHistogram.deserialize(rBlob, rSize);
+  merge(tHistogram);
+}
+
+void Histogram::deserialize(const unsigned char* rBlob, const size_t& rSize)
+{
+  size_t tPosition = 0;
+  unsigned int tHeader[5];  // id, version, number of chips, number of parameters, flags
+  readBlob(rBlob, rSize, tPosition, tHeader, 5);
+  if(tHeader[0] != __HIST_BLOB_ID || tHeader[1] != __HIST_BLOB_VERSION)
+	  throw std::invalid_argument("Not a serialized histogram of version "+IntToStr(__HIST_BLOB_VERSION)+".");
+  if(tHeader[3] == 0)
+	  throw std::invalid_argument("Serialized histogram without parameters.");
+  setNchips(tHeader[2]);
+  const size_t tNpixel = (size_t)_nColumns * (size_t)_nRows;
+  std::vector<int> tValues(tHeader[3]);
+  readBlob(rBlob, rSize, tPosition, &tValues[0], tValues.size());
+  _NparameterValues = tHeader[3];
+  setParameterValues(&tValues[0], tHeader[3]);
+  _sparseOccupancy = true;  // only the tiles in the blob are allocated
+  _sparseTdcPixelHist = true;
+  const unsigned int tFlags = tHeader[4];
+  if(tFlags & 1){
+	  _createOccHist = true;
+	  allocateOccupancyArray();
+	  readBlobTiles(rBlob, rSize, tPosition, _occupancy);
+  }
+  if(tFlags & 2){
+	  _createMeanTotHist = true;
+	  allocateMeanTotArray();
+	  readBlobTiles(rBlob, rSize, tPosition, _totSum);
+	  readBlobTiles(rBlob, rSize, tPosition, _totSquareSum);
+  }
+  if(tFlags & 4){
+	  createTotHist(true);
+	  readBlob(rBlob, rSize, tPosition, _tot, 16);
+  }
+  if(tFlags & 8){
+	  createTdcHist(true);
+	  readBlob(rBlob, rSize, tPosition, _tdc, __N_TDC_VALUES);
+  }
+  if(tFlags & 16){
+	  createTdcTriggerDistanceHist(true);
+	  readBlob(rBlob, rSize, tPosition, _tdcTriggerDistance, __N_TDC_DIST_VALUES);
+  }
+  if(tFlags & 32){
+	  createRelBCIDHist(true);
+	  readBlob(rBlob, rSize, tPosition, _relBcid, __MAXBCID);
+  }
+  if(tFlags & 64){
+	  createTotPixelHist(true);
+	  readBlob(rBlob, rSize, tPosition, _totPixel.data(), tNpixel * 16);
+	  _totPixel.markAllDirty();
+  }
+  if(tFlags & 128){
+	  unsigned int tBinWidth = 0;
+	  readBlob(rBlob, rSize, tPosition, &tBinWidth, 1);
+	  setTdcPixelHistBinWidth(tBinWidth);
+	  createTdcPixelHist(true);
+	  readBlobTiles(rBlob, rSize, tPosition, _tdcPixel);
+  }
+  if(tFlags & 256){
+	  createTdcPixelMoments(true);
+	  readBlob(rBlob, rSize, tPosition, _tdcPixelCount, tNpixel);
+	  readBlob(rBlob, rSize, tPosition, _tdcPixelSum, tNpixel);
+	  readBlob(rBlob, rSize, tPosition, _tdcPixelSquareSum, tNpixel);
+	  readBlob(rBlob, rSize, tPosition, _tdcPixelMin, tNpixel);
+	  readBlob(rBlob, rSize, tPosition, _tdcPixelMax, tNpixel);
+  }
+  if(tPosition != rSize)
+	  throw std::invalid_argument("Serialized histogram with trailing data.");
+}
+
+template<class T> void Histogram::writeBlob(std::vector<unsigned char>& rBlob, const T* rData, const size_t& rSize)
+{
+  const unsigned char* tData = reinterpret_cast<const unsigned char*>(rData);
+  rBlob.insert(rBlob.end(), tData, tData + rSize * sizeof(T));
+}
+
+template<class T> void Histogram::readBlob(const unsigned char* rBlob, const size_t& rBlobSize, size_t& rPosition, T* rData, const size_t& rSize)
+{
+  if(rBlobSize - rPosition < rSize * sizeof(T))
+	  throw std::invalid_argument("Serialized histogram too short.");
+  std::copy(rBlob + rPosition, rBlob + rPosition + rSize * sizeof(T), reinterpret_cast<unsigned char*>(rData));
+  rPosition += rSize * sizeof(T);
+}
+
+template<class T> void Histogram::writeBlobTiles(std::vector<unsigned char>& rBlob, const TiledArray<T>& rSource, const bool& rExportOrder)
+{
+  //number of tiles, then tile index and entries of every tile with entries
+  std::vector<T> tEntries(rSource.size(), 0);
+  for(size_t iTile = 0; iTile < rSource.nTiles(); ++iTile){
+	  const T* tTile = rSource.tile(iTile);
+	  if(tTile == 0)
+		  continue;
+	  for(unsigned int i = 0; i < __HIST_TILE_SIZE; ++i)
+		  tEntries[rExportOrder ? getExportIndex(iTile * __HIST_TILE_SIZE + i) : iTile * __HIST_TILE_SIZE + i] = tTile[i];
+  }
+  std::vector<uint64_t> tTiles;
+  for(size_t iTile = 0; iTile < rSource.nTiles(); ++iTile){
+	  typename std::vector<T>::iterator tBegin = tEntries.begin() + iTile * __HIST_TILE_SIZE;
+	  if(std::count(tBegin, tBegin + __HIST_TILE_SIZE, (T) 0) != __HIST_TILE_SIZE)
+		  tTiles.push_back(iTile);
+  }
+  uint64_t tNtiles = tTiles.size();
+  writeBlob(rBlob, &tNtiles, 1);
+  for(size_t i = 0; i < tTiles.size(); ++i){
+	  writeBlob(rBlob, &tTiles[i], 1);
+	  writeBlob(rBlob, &tEntries[tTiles[i] * __HIST_TILE_SIZE], __HIST_TILE_SIZE);
+  }
+}
+
+template<class T> void Histogram::readBlobTiles(const unsigned char* rBlob, const size_t& rBlobSize, size_t& rPosition, TiledArray<T>& rTarget)
+{
+  uint64_t tNtiles = 0;
+  readBlob(rBlob, rBlobSize, rPosition, &tNtiles, 1);
+  for(uint64_t i = 0; i < tNtiles; ++i){
+	  uint64_t tTile = 0;
+	  readBlob(rBlob, rBlobSize, rPosition, &tTile, 1);
+	  if(tTile >= rTarget.nTiles())
+		  throw std::invalid_argument("Serialized histogram tile index out of range.");
+	  readBlob(rBlob, rBlobSize, rPosition, &rTarget[(size_t) tTile * __HIST_TILE_SIZE], __HIST_TILE_SIZE);  // the write access allocates the tile
+  }
+}
+
 void Histogram::getTotHist(unsigned int*& rTotHist, bool copy)
 {
   debug("getTotHist(...)");
@@ -609,12 +2258,25 @@ void Histogram::getTotHist(unsigned int*& rTotHist, bool copy)
 void Histogram::getMeanTot(unsigned int& rNparameterValues, float*& rMeanTot, bool copy)
 {
   debug("getMeanTot(...)");
-  if(copy){
-	  unsigned int tArrayLength = (size_t)(RAW_DATA_MAX_COLUMN-1) + (size_t)(RAW_DATA_MAX_ROW-1) * (size_t)RAW_DATA_MAX_COLUMN + (size_t)(_NparameterValues-1) * (size_t)RAW_DATA_MAX_COLUMN * (size_t)RAW_DATA_MAX_ROW+1;
-	  std::copy(_meanTot, _meanTot+tArrayLength, rMeanTot);
-  }
-  else
+  if(!copy && _totSum.allocated() && _meanTot == 0)
+	  _meanTot = new float[_totSum.size()];
+  if(!copy)
 	  rMeanTot = _meanTot;
+  if(rMeanTot != 0 && _occupancy.allocated() && _totSum.allocated())
+	  calculateMeanTot(rMeanTot);
+
+  rNparameterValues = _NparameterValues;
+}
+
+void Histogram::getTotRms(unsigned int& rNparameterValues, float*& rTotRms, bool copy)
+{
+  debug("getTotRms(...)");
+  if(!copy && _totSum.allocated() && _totRms == 0)
+	  _totRms = new float[_totSum.size()];
+  if(!copy)
+	  rTotRms = _totRms;
+  if(rTotRms != 0 && _occupancy.allocated() && _totSum.allocated())
+	  calculateTotRms(rTotRms);
 
   rNparameterValues = _NparameterValues;
 }
@@ -650,18 +2312,116 @@ void Histogram::getTotPixelHist(unsigned short*& rTotPixelHist, bool copy)
 {
   debug("getTotPixelHist(...)");
   if(copy)
-   	  std::copy(_totPixel, _totPixel+16, rTotPixelHist);
+   	  std::copy(_totPixel.data(), _totPixel.data()+16, rTotPixelHist);
   else
-	  rTotPixelHist = _totPixel;
+	  rTotPixelHist = _totPixel.data();
 }
 
 void Histogram::getTdcPixelHist(unsigned short*& rTdcPixelHist, bool copy)
 {
   debug("getTdcPixelHist(...)");
-  if(copy)
-   	  std::copy(_tdcPixel, _tdcPixel+__N_TDC_VALUES, rTdcPixelHist);
+  if(copy){
+	  if(_tdcPixel.allocated())
+		  _tdcPixel.copyTo(rTdcPixelHist);
+  }
+  else if(_tdcPixel.sparse()){  // sparse tiles have to be exported to a dense array
+	  if(_tdcPixelExport == 0)
+		  _tdcPixelExport = new unsigned short[_tdcPixel.size()];
+	  _tdcPixel.copyTo(_tdcPixelExport);
+	  rTdcPixelHist = _tdcPixelExport;
+  }
   else
-	  rTdcPixelHist = _tdcPixel;
+	  rTdcPixelHist = _tdcPixel.data();
+}
+
+void Histogram::getTdcPixelMoments(unsigned int* rCount, float* rMean, float* rRms, unsigned short* rMin, unsigned short* rMax)
+{
+  debug("getTdcPixelMoments(...)");
+  if(_tdcPixelCount == 0)
+	  throw std::runtime_error("TDC pixel moments array not set.");
+  const size_t tNpixel = (size_t)_nColumns * (size_t)_nRows;
+  std::copy(_tdcPixelCount, _tdcPixelCount + tNpixel, rCount);
+  std::copy(_tdcPixelMin, _tdcPixelMin + tNpixel, rMin);
+  std::copy(_tdcPixelMax, _tdcPixelMax + tNpixel, rMax);
+  calculateTdcPixelMoments(tNpixel, _tdcPixelCount, _tdcPixelSum, _tdcPixelSquareSum, rMean, rRms);
+}
+
+void Histogram::calculateTdcPixelMoments(const size_t& rNpixel, const unsigned int* rPixelCount, const uint64_t* rPixelSum, const uint64_t* rPixelSquareSum, float* rMean, float* rRms)
+{
+  for (size_t i = 0; i < rNpixel; ++i){
+	  if (rPixelCount[i] != 0){
+		  double tMean = (double) rPixelSum[i] / (double) rPixelCount[i];
+		  double tVariance = (double) rPixelSquareSum[i] / (double) rPixelCount[i] - tMean * tMean;
+		  rMean[i] = (float) tMean;
+		  rRms[i] = (float) sqrt(std::max(tVariance, 0.));  // rounding can give slightly negative values
+	  }
+	  else{
+		  rMean[i] = NAN;
+		  rRms[i] = NAN;
+	  }
+  }
+}
+
+void Histogram::getDecayingOccupancy(float* rOccupancy)
+{
+  debug("getDecayingOccupancy(...)");
+  if(!_createDecayingOccupancyHist)
+	  throw std::runtime_error("Decaying occupancy histogram not created.");
+  double tEventWeight = pow(2., (_decayEventNumber - _decayOrigin) / _decayHalfLife);
+  for(size_t i = 0; i < _decayTileFactor.size(); ++i){  // one decay factor per tile
+	  double tScale = 1. / (tEventWeight * _decayTileFactor[i]);
+	  for(size_t j = i * __HIST_TILE_SIZE; j < (i + 1) * __HIST_TILE_SIZE; ++j)
+		  rOccupancy[j] = (float) (_decayingOccupancy[j] * tScale);
+  }
+}
+
+void Histogram::getTimeHist(unsigned int* rEvents, unsigned int* rHits, unsigned int* rTdc, unsigned int* rErrors, unsigned int* rRegions)
+{
+  debug("getTimeHist(...)");
+  if(!_createTimeHist)
+	  throw std::runtime_error("Time histograms not created.");
+  const unsigned int tNregions = _nTimeHistColumnRegions * _nTimeHistRowRegions;
+  unsigned int tNbins = getNtimeBins();
+  for(unsigned int i = 0; i < tNbins; ++i){
+	  size_t tBin = (size_t) ((_timeHistFirstBin + (int64_t) i) % (int64_t) _nTimeHistBins);
+	  if(rEvents != 0)
+		  rEvents[i] = _timeHistEvents[tBin];
+	  if(rHits != 0)
+		  rHits[i] = _timeHistHits[tBin];
+	  if(rTdc != 0)
+		  rTdc[i] = _timeHistTdc[tBin];
+	  if(rErrors != 0)
+		  std::copy(_timeHistErrors.begin() + tBin * __N_ERROR_CODES, _timeHistErrors.begin() + (tBin + 1) * __N_ERROR_CODES, rErrors + (size_t)i * __N_ERROR_CODES);
+	  if(rRegions != 0)
+		  std::copy(_timeHistRegions.begin() + tBin * tNregions, _timeHistRegions.begin() + (tBin + 1) * tNregions, rRegions + (size_t)i * tNregions);
+  }
+}
+
+unsigned int Histogram::getNtimeBins()
+{
+  if(_timeHistLastBin < _timeHistFirstBin)
+	  return 0;
+  return (unsigned int) (_timeHistLastBin - _timeHistFirstBin + 1);
+}
+
+unsigned int Histogram::getNtimeHistColumnRegions()
+{
+  return _nTimeHistColumnRegions;
+}
+
+unsigned int Histogram::getNtimeHistRowRegions()
+{
+  return _nTimeHistRowRegions;
+}
+
+double Histogram::getTimeHistStart()
+{
+  return _timeHistOrigin + (double) _timeHistFirstBin * _timeHistBinWidth;
+}
+
+uint64_t Histogram::getNtimeHistLostHits()
+{
+  return _nTimeHistLostHits;
 }
 
 void Histogram::calculateThresholdScanArrays(double rMuArray[], double rSigmaArray[], const unsigned int& rMaxInjections, const unsigned int& min_parameter, const unsigned int& max_parameter)
@@ -669,7 +2429,7 @@ void Histogram::calculateThresholdScanArrays(double rMuArray[], double rSigmaArr
   debug("calculateThresholdScanArrays(...)");
   //quick algorithm from M. Mertens, PhD thesis, FZ Juelich 2010
 
-  if(_occupancy==0)
+  if(!_occupancy.allocated())
 	  throw std::runtime_error("Occupancy array not initialized. Set scan parameter first!.");
 
   if (_NparameterValues<2)  //a minimum number of different scans is needed
@@ -681,28 +2441,300 @@ void Histogram::calculateThresholdScanArrays(double rMuArray[], double rSigmaArr
   unsigned int A = rMaxInjections;
   unsigned int d = (int) ( ((double) q_max - (double) q_min)/(double) (n-1));
 
-  for(unsigned int i=0; i<RAW_DATA_MAX_COLUMN; ++i){
-    for(unsigned int j=0; j<RAW_DATA_MAX_ROW; ++j){
-      unsigned int M = 0;
-        
-      for(unsigned int k=0; k<getNparameters(); ++k){
-        M += _occupancy[(size_t)i + (size_t)j * (size_t)RAW_DATA_MAX_COLUMN  + (size_t)k * (size_t)RAW_DATA_MAX_COLUMN * (size_t)RAW_DATA_MAX_ROW];
-      }
-      double threshold = (double) q_max - d*(double)M/(double)A;
-      rMuArray[i+j*RAW_DATA_MAX_COLUMN] = threshold;
-
-      unsigned int mu1 = 0;
-      unsigned int mu2 = 0;
-      for(unsigned int k=0; k<getNparameters(); ++k){
-        if((double) k*d < threshold)
-          mu1 += _occupancy[(size_t)i + (size_t)j * (size_t)RAW_DATA_MAX_COLUMN  + (size_t)k * (size_t)RAW_DATA_MAX_COLUMN * (size_t)RAW_DATA_MAX_ROW];
+  if(_pixelMajorOccupancy){  // the parameters of each pixel are contiguous, thus each pixel is calculated from its own row
+	const int tNpixel = (int) ((size_t)_nColumns * (size_t)_nRows);
+#pragma omp parallel num_threads((int) getNthreads())
+	{
+	std::vector<unsigned int> tBuffer(n);  // only used for sparse tiles
+#pragma omp for
+	for(int iPixel = 0; iPixel < tNpixel; ++iPixel){
+	  const unsigned int* tOccupancy = _occupancy.range((size_t)iPixel * n, n, &tBuffer[0]);
+	  unsigned int M = 0;
+	  for(unsigned int k=0; k<n; ++k)
+		M += tOccupancy[k];
+	  double threshold = (double) q_max - d*(double)M/(double)A;
+	  unsigned int mu1 = 0;
+	  unsigned int mu2 = 0;
+	  for(unsigned int k=0; k<n; ++k){
+		if((double) k*d < threshold)
+		  mu1 += tOccupancy[k];
+		else
+		  mu2 += (A-tOccupancy[k]);
+	  }
+	  rMuArray[iPixel] = threshold;
+	  rSigmaArray[iPixel] = (double)d*(double)(mu1+mu2)/(double)A*sqrt(3.141592653589893238462643383/2);
+	}
+	}
+	return;
+  }
+
+  //the pixels are processed in blocks of __HIST_TILE_SIZE neighboring pixels, that are contiguous for each parameter
+  //thus the inner loops run over contiguous memory and the blocks are independent to be processed in parallel
+  const int tNpixelTiles = (int) ((size_t)_nColumns * (size_t)_nRows / __HIST_TILE_SIZE);
+#pragma omp parallel num_threads((int) getNthreads())
+  {
+  std::vector<const unsigned int*> tRows;
+  std::vector<unsigned int> tBuffer;
+#pragma omp for
+  for(int iTile = 0; iTile < tNpixelTiles; ++iTile){
+    getOccupancyBlock((size_t)iTile, tRows, tBuffer);
+    unsigned int M[__HIST_TILE_SIZE];
+    unsigned int mu1[__HIST_TILE_SIZE];
+    unsigned int mu2[__HIST_TILE_SIZE];
+    double threshold[__HIST_TILE_SIZE];
+    std::fill(M, M + __HIST_TILE_SIZE, 0);
+    std::fill(mu1, mu1 + __HIST_TILE_SIZE, 0);
+    std::fill(mu2, mu2 + __HIST_TILE_SIZE, 0);
+
+    for(unsigned int k=0; k<n; ++k){
+      const unsigned int* tOccupancy = tRows[k];
+      if(tOccupancy == 0)  // not allocated tile in sparse mode, no hits
+        continue;
+      for(unsigned int j=0; j<__HIST_TILE_SIZE; ++j)
+        M[j] += tOccupancy[j];
+    }
+    for(unsigned int j=0; j<__HIST_TILE_SIZE; ++j){
+      threshold[j] = (double) q_max - d*(double)M[j]/(double)A;
+      rMuArray[(size_t)iTile * __HIST_TILE_SIZE + j] = threshold[j];
+    }
+
+    for(unsigned int k=0; k<n; ++k){
+      const unsigned int* tOccupancy = tRows[k];
+      double tCharge = (double) k*d;
+      for(unsigned int j=0; j<__HIST_TILE_SIZE; ++j){
+        unsigned int tHits = tOccupancy != 0 ? tOccupancy[j] : 0;
+        if(tCharge < threshold[j])
+          mu1[j] += tHits;
         else
-          mu2 += (A-_occupancy[(size_t)i + (size_t)j * (size_t)RAW_DATA_MAX_COLUMN  + (size_t)k * (size_t)RAW_DATA_MAX_COLUMN * (size_t)RAW_DATA_MAX_ROW]);
+          mu2[j] += (A-tHits);
       }
-      double noise = (double)d*(double)(mu1+mu2)/(double)A*sqrt(3.141592653589893238462643383/2);
-      rSigmaArray[i+j*RAW_DATA_MAX_COLUMN] = noise;
     }
+    for(unsigned int j=0; j<__HIST_TILE_SIZE; ++j){
+      double noise = (double)d*(double)(mu1[j]+mu2[j])/(double)A*sqrt(3.141592653589893238462643383/2);
+      rSigmaArray[(size_t)iTile * __HIST_TILE_SIZE + j] = noise;
+    }
+  }
+  }
+}
+
+void Histogram::startLiveThreshold(const unsigned int& rMaxInjections, const unsigned int& min_parameter, const unsigned int& max_parameter)
+{
+  debug("startLiveThreshold(...)");
+  if(!_occupancy.allocated())
+	  throw std::runtime_error("Occupancy array not initialized. Set scan parameter first!.");
+  if (_NparameterValues<2)  //a minimum number of different scans is needed
+	  throw std::logic_error("At least two scan parameters needed for the threshold estimation.");
+  const size_t tNpixel = (size_t)_nColumns * (size_t)_nRows;
+  _liveM.assign(tNpixel, 0);
+  _liveMu1.assign(tNpixel, 0);
+  _liveMu2.assign(tNpixel, 0);
+  _liveSplit.assign(tNpixel, 0);
+  _liveNsteps = 0;
+  _liveMaxInjections = rMaxInjections;
+  _liveMaxParameter = max_parameter;
+  _liveParameterStep = (int) ( ((double) max_parameter - (double) min_parameter)/(double) (getNparameters()-1));  // same as in calculateThresholdScanArrays
+}
+
+void Histogram::addLiveThresholdStep()
+{
+  debug("addLiveThresholdStep()");
+  if(_liveM.empty())
+	  throw std::logic_error("Incremental threshold estimation not started.");
+  if(_liveNsteps >= getNparameters())
+	  throw std::out_of_range("All parameter steps already added.");
+
+  //the threshold estimate can only increase with a new step (as long as a pixel has not more hits than injections),
+  //thus only the steps the threshold passed are moved from mu2 to mu1 and the occupancy is not read again otherwise
+  const unsigned int k = _liveNsteps;
+  const unsigned int A = _liveMaxInjections;
+  const unsigned int d = _liveParameterStep;
+  const unsigned int n = getNparameters();
+  const int tNpixel = (int) ((size_t)_nColumns * (size_t)_nRows);
+#pragma omp parallel for num_threads((int) getNthreads())
+  for(int iPixel = 0; iPixel < tNpixel; ++iPixel){
+	const size_t tPixel = (size_t) iPixel;
+	unsigned int tHits = _occupancy.get(getOccupancyIndex(tPixel, k));
+	_liveM[tPixel] += tHits;
+	_liveMu2[tPixel] += (A-tHits);
+	double threshold = (double) _liveMaxParameter - d*(double)(_liveM[tPixel] + A * (n-1-k))/(double)A;  // missing steps counted as fully efficient
+	unsigned int& rSplit = _liveSplit[tPixel];
+	while(rSplit <= k && (double) rSplit*d < threshold){
+	  unsigned int tSplitHits = _occupancy.get(getOccupancyIndex(tPixel, rSplit));
+	  _liveMu2[tPixel] -= (A-tSplitHits);
+	  _liveMu1[tPixel] += tSplitHits;
+	  ++rSplit;
+	}
+	while(rSplit > 0 && !((double) (rSplit-1)*d < threshold)){  // threshold decreased, more hits than injections
+	  unsigned int tSplitHits = _occupancy.get(getOccupancyIndex(tPixel, (rSplit-1)));
+	  _liveMu1[tPixel] -= tSplitHits;
+	  _liveMu2[tPixel] += (A-tSplitHits);
+	  --rSplit;
+	}
+  }
+  _liveNsteps++;
+}
+
+void Histogram::getLiveThreshold(double rMuArray[], double rSigmaArray[])
+{
+  debug("getLiveThreshold(...)");
+  if(_liveM.empty())
+	  throw std::logic_error("Incremental threshold estimation not started.");
+  const unsigned int A = _liveMaxInjections;
+  const unsigned int d = _liveParameterStep;
+  const unsigned int tNmissingSteps = getNparameters() - std::max(_liveNsteps, 1u);
+  for(size_t i = 0; i < _liveM.size(); ++i){
+	if(_liveNsteps == 0){
+	  rMuArray[i] = NAN;
+	  rSigmaArray[i] = NAN;
+	  continue;
+	}
+	rMuArray[i] = (double) _liveMaxParameter - d*(double)(_liveM[i] + A * tNmissingSteps)/(double)A;
+	rSigmaArray[i] = (double)d*(double)(_liveMu1[i]+_liveMu2[i])/(double)A*sqrt(3.141592653589893238462643383/2);
+  }
+}
+
+unsigned int Histogram::getNliveThresholdSteps()
+{
+  return _liveNsteps;
+}
+
+void Histogram::fitScurves(double rThreshold[], double rNoise[], double rChi2[], unsigned char rStatus[], const unsigned int& rMaxInjections, const unsigned int& min_parameter, const unsigned int& max_parameter)
+{
+  debug("fitScurves(...)");
+
+  if(!_occupancy.allocated())
+	  throw std::runtime_error("Occupancy array not initialized. Set scan parameter first!.");
+  if (_NparameterValues<3)  //more data points than the two fit parameters are needed
+	  throw std::logic_error("At least three scan parameters needed for the S-curve fit.");
+
+  const unsigned int n = getNparameters();
+  const double A = (double) rMaxInjections;
+  const double tStep = ((double) max_parameter - (double) min_parameter) / (double) (n-1);
+  const int tNpixelTiles = (int) ((size_t)_nColumns * (size_t)_nRows / __HIST_TILE_SIZE);
+
+  //the occupancy of one pixel tile is transposed into a thread private buffer, thus the fit of each pixel runs on contiguous data
+  //in the pixel-major layout the occupancy of each pixel is already contiguous and only converted
+#pragma omp parallel num_threads((int) getNthreads())
+  {
+	std::vector<double> tOccupancy((size_t)__HIST_TILE_SIZE * n);
+	std::vector<unsigned int> tBuffer(n);  // only used for sparse tiles
+#pragma omp for schedule(dynamic)
+	for(int iTile = 0; iTile < tNpixelTiles; ++iTile){
+	  if(_pixelMajorOccupancy){
+		for(unsigned int j = 0; j < __HIST_TILE_SIZE; ++j){
+		  const unsigned int* tRow = _occupancy.range(((size_t)iTile * __HIST_TILE_SIZE + j) * n, n, &tBuffer[0]);
+		  std::copy(tRow, tRow + n, &tOccupancy[(size_t)j * n]);
+		}
+	  }
+	  else{
+		for(unsigned int k = 0; k < n; ++k){
+		  const unsigned int* tTile = _occupancy.tile((size_t)iTile + (size_t)k * (size_t)tNpixelTiles);
+		  for(unsigned int j = 0; j < __HIST_TILE_SIZE; ++j)
+			tOccupancy[(size_t)j * n + k] = tTile != 0 ? (double) tTile[j] : 0.;
+		}
+	  }
+	  for(unsigned int j = 0; j < __HIST_TILE_SIZE; ++j){
+		const double* tPixelOccupancy = &tOccupancy[(size_t)j * n];
+		size_t tPixel = (size_t)iTile * __HIST_TILE_SIZE + j;
+		//start values from the quick algorithm
+		double M = 0;
+		for(unsigned int k = 0; k < n; ++k)
+		  M += tPixelOccupancy[k];
+		double tThreshold = (double) max_parameter - tStep * M / A;
+		double mu = 0;
+		for(unsigned int k = 0; k < n; ++k){
+		  if((double) min_parameter + (double) k * tStep < tThreshold)
+			mu += tPixelOccupancy[k];
+		  else
+			mu += A - tPixelOccupancy[k];
+		}
+		double tNoise = tStep * mu / A * sqrt(3.141592653589893238462643383/2);
+		if(!(tNoise > 0.))
+		  tNoise = tStep;
+		double tChi2 = NAN;
+		unsigned char tStatus = __SCURVE_FIT_NO_DATA;
+		if(M > 0. && M < A * (double) n)
+		  tStatus = fitScurve(tPixelOccupancy, n, (double) min_parameter, tStep, A, tThreshold, tNoise, tChi2);
+		if(tStatus == __SCURVE_FIT_NO_DATA){
+		  tThreshold = NAN;
+		  tNoise = NAN;
+		}
+		rThreshold[tPixel] = tThreshold;
+		rNoise[tPixel] = tNoise;
+		rChi2[tPixel] = tChi2;
+		rStatus[tPixel] = tStatus;
+	  }
+	}
+  }
+}
+
+unsigned char Histogram::fitScurve(const double* rOccupancy, const unsigned int& rNparameters, const double& rMinParameter, const double& rParameterStep, const double& rMaxInjections, double& rThreshold, double& rNoise, double& rChi2)
+{
+  //model: A/2 * (1 + erf((x - threshold) / (sqrt(2) * noise))), least squares fit of threshold and noise
+  const double tSqrt2 = sqrt(2.);
+  const double tNorm = rMaxInjections / sqrt(2. * 3.141592653589793238462643383);
+  double tLambda = 1e-3;
+  double tChi2 = 0;
+  for(unsigned int k = 0; k < rNparameters; ++k){
+	double tResidual = rOccupancy[k] - rMaxInjections / 2. * (1. + erf((rMinParameter + (double) k * rParameterStep - rThreshold) / (tSqrt2 * rNoise)));
+	tChi2 += tResidual * tResidual;
+  }
+  for(unsigned int iIteration = 0; iIteration < __MAX_SCURVE_FIT_ITERATIONS; ++iIteration){
+	//normal equations J^T J * delta = J^T r
+	double a11 = 0, a12 = 0, a22 = 0, g1 = 0, g2 = 0;
+	for(unsigned int k = 0; k < rNparameters; ++k){
+	  double z = (rMinParameter + (double) k * rParameterStep - rThreshold) / rNoise;
+	  double tGauss = tNorm / rNoise * exp(-0.5 * z * z);
+	  double tResidual = rOccupancy[k] - rMaxInjections / 2. * (1. + erf(z / tSqrt2));
+	  double tDthreshold = -tGauss;
+	  double tDnoise = -tGauss * z;
+	  a11 += tDthreshold * tDthreshold;
+	  a12 += tDthreshold * tDnoise;
+	  a22 += tDnoise * tDnoise;
+	  g1 += tDthreshold * tResidual;
+	  g2 += tDnoise * tResidual;
+	}
+	bool tImproved = false;
+	double tChi2Change = 0;
+	while(!tImproved && tLambda < 1e10){
+	  double b11 = a11 * (1. + tLambda);
+	  double b22 = a22 * (1. + tLambda);
+	  double tDet = b11 * b22 - a12 * a12;
+	  if(!(tDet > 0.)){
+		tLambda *= 10.;
+		continue;
+	  }
+	  double tThreshold = rThreshold + (b22 * g1 - a12 * g2) / tDet;
+	  double tNoise = rNoise + (b11 * g2 - a12 * g1) / tDet;
+	  if(!(tNoise > 0.)){
+		tLambda *= 10.;
+		continue;
+	  }
+	  double tNewChi2 = 0;
+	  for(unsigned int k = 0; k < rNparameters; ++k){
+		double tResidual = rOccupancy[k] - rMaxInjections / 2. * (1. + erf((rMinParameter + (double) k * rParameterStep - tThreshold) / (tSqrt2 * tNoise)));
+		tNewChi2 += tResidual * tResidual;
+	  }
+	  if(tNewChi2 <= tChi2){
+		tChi2Change = tChi2 - tNewChi2;
+		tChi2 = tNewChi2;
+		rThreshold = tThreshold;
+		rNoise = tNoise;
+		tLambda = std::max(tLambda / 10., 1e-12);
+		tImproved = true;
+	  }
+	  else
+		tLambda *= 10.;
+	}
+	if(!(rThreshold == rThreshold) || !(rNoise == rNoise) || !(tChi2 == tChi2))  // NAN check
+	  return __SCURVE_FIT_FAILED;
+	if(!tImproved || tChi2Change <= 1e-10 * tChi2 + 1e-12){  // no further improvement possible
+	  rChi2 = tChi2 / (double) (rNparameters - 2);
+	  return __SCURVE_FIT_CONVERGED;
+	}
   }
+  rChi2 = tChi2 / (double) (rNparameters - 2);
+  return __SCURVE_FIT_NOT_CONVERGED;
 }
 
 void Histogram::setNoScanParameter()
@@ -710,15 +2742,17 @@ void Histogram::setNoScanParameter()
   debug("setNoScanParameter()");
   deleteOccupancyArray();
   _NparameterValues = 1;
+  _parameterValues.clear();
+  _parIndexMap.clear();
   allocateOccupancyArray();
-  resetOccupancyArray();
-  allocateMeanTotArray();
-  resetMeanTotArray();
+  if(_createMeanTotHist)
+	  allocateMeanTotArray();
 }
 
 void Histogram::reset()
 {
 	info("reset()");
+	MutexLock tLock(_fillMutex);
 	resetOccupancyArray();
 	resetTotArray();
 	resetMeanTotArray();
@@ -726,7 +2760,13 @@ void Histogram::reset()
 	resetTdcTriggerDistanceArray();
 	resetTotPixelArray();
 	resetTdcPixelArray();
+	resetTdcPixelMomentsArray();
 	resetRelBcidArray();
+	resetTimeHist();
+	resetDecayingOccupancyArray();
+	_pixelMask.resetDropped();
 	_parInfo = 0;
+	if(_createSnapshots)
+		publishSnapshot();
 }
 
@@ -5,9 +5,15 @@
 #include <algorithm>
 #include <iterator>
 #include <set>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 #include "defines.h"
 #include "Basis.h"
+#include "TiledArray.h"
+#include "Mutex.h"
+#include "PixelMask.h"
 
 class Histogram: public Basis
 {
@@ -18,31 +24,99 @@ public:
 	//get histograms
 	void getOccupancy(unsigned int& rNparameterValues, unsigned int*& rOccupancy, bool copy = false); //returns the occupancy histogram for all hits
 	void getTotHist(unsigned int*& rTotHist, bool copy = false); //returns the tot histogram for all hits
-	void getMeanTot(unsigned int& rNparameterValues, float*& rMeanTot, bool copy = false); //returns mean ToT per scan parameter for each pixel
+	void getMeanTot(unsigned int& rNparameterValues, float*& rMeanTot, bool copy = false); //returns mean ToT per scan parameter for each pixel, calculated from the ToT sums on every call
+	void getTotRms(unsigned int& rNparameterValues, float*& rTotRms, bool copy = false); //returns the ToT RMS per scan parameter for each pixel, calculated from the ToT sums on every call
 	void getTdcHist(unsigned int*& rTdcHist, bool copy = false); //returns the tdc histogram for all hits
 	void getTdcTriggerDistanceHist(unsigned int*& rTdcTriggerDistanceHist, bool copy = false); //returns the tdc trigger distance histogram for all hits
 	void getRelBcidHist(unsigned int*& rRelBcidHist, bool copy = false); //returns the relative BCID histogram for all hits
 	void getTotPixelHist(unsigned short*& rTotPixelHist, bool copy = false); //returns the tot pixel histogram
-	void getTdcPixelHist(unsigned short*& rTdcPixelHist, bool copy = false); //returns the tdc pixel histogram
+	void getTdcPixelHist(unsigned short*& rTdcPixelHist, bool copy = false); //returns the tdc pixel histogram (in total 3d, linearly sorted via col, row, tdc bin)
+	void getTdcPixelMoments(unsigned int* rCount, float* rMean, float* rRms, unsigned short* rMin, unsigned short* rMax); //copies the TDC moments of each pixel into arrays of one entry per pixel, mean and RMS are NAN for pixels without hits
+	void getTimeHist(unsigned int* rEvents, unsigned int* rHits, unsigned int* rTdc, unsigned int* rErrors, unsigned int* rRegions); //copies the getNtimeBins() time bins from the oldest to the newest: events, hits, events with TDC word, events per error code (sorted via error code, time bin) and hits per region (sorted via column region, row region, time bin); 0 pointers are skipped
+	unsigned int getNtimeBins(); //returns the number of filled time bins, at most the ring size
+	unsigned int getNtimeHistColumnRegions();
+	unsigned int getNtimeHistRowRegions();
+	double getTimeHistStart(); //returns the time stamp of the start of the oldest time bin
+	uint64_t getNtimeHistLostHits(); //returns the number of hits of events older than the oldest time bin of the ring
+	void getDecayingOccupancy(float* rOccupancy); //copies the decaying occupancy at the last event number into an array of one entry per pixel (col, row)
+
+	//snapshots for live monitoring, the snapshot arrays do not change while filling continues
+	//addHits, addClusterSeedHits and reset publish the histograms at their end by copying the tiles changed since the publishing buffer was last written (triple buffer, see publishSnapshot)
+	//takeSnapshot can be called from another thread while addHits runs, both only lock to exchange buffer indices, thus neither waits for a copy
+	void createSnapshots(bool CreateSnapshots = true); //publishes the actual histograms and then every batch; off: the snapshot buffers are deleted and the fill loops do not track changed tiles
+	void takeSnapshot(); //makes the last published histograms the snapshot without a copy, the previous snapshot is kept until the next call; throws if the snapshots are not created
+	unsigned int getNsnapshots(); //returns the number of snapshots taken
+	void getSnapshotOccupancy(unsigned int& rNparameterValues, unsigned int*& rOccupancy); //returns the occupancy of the last snapshot (linearly sorted via col, row, parameter in both layouts), 0 if not histogrammed
+	void getSnapshotTotHist(unsigned int*& rTotHist);
+	void getSnapshotTdcHist(unsigned int*& rTdcHist);
+	void getSnapshotTdcTriggerDistanceHist(unsigned int*& rTdcTriggerDistanceHist);
+	void getSnapshotRelBcidHist(unsigned int*& rRelBcidHist);
+	void getSnapshotTotPixelHist(unsigned short*& rTotPixelHist);
+	void getSnapshotTdcPixelHist(unsigned int& rNbins, unsigned short*& rTdcPixelHist);
+	bool getSnapshotMeanTot(float* rMeanTot, float* rTotRms); //calculates the mean ToT and ToT RMS of the last snapshot into arrays of the occupancy size (col, row, parameter), returns false if the ToT sums are not histogrammed
+	bool getSnapshotTdcPixelMoments(unsigned int* rCount, float* rMean, float* rRms, unsigned short* rMin, unsigned short* rMax); //TDC moments of the last snapshot as getTdcPixelMoments, returns false if not histogrammed
+
+	//merging of partial results, e.g. of file segments processed on different nodes
+	void merge(Histogram& rHistogram); //adds the histograms of rHistogram that are enabled here, the occupancy parameters are aligned by the parameter values and missing ones are added (the scan parameter indices are mapped to the new ones); the mean ToT needs the ToT sums of both histograms
+	void serialize(std::vector<unsigned char>& rBlob); //writes all histograms into a binary blob (native byte order), only tiles with entries are written
+	void mergeSerialized(const unsigned char* rBlob, const size_t& rSize); //merges a blob written by serialize
+	static void reduce(std::vector<Histogram*>& rHistograms); //merges all histograms into the first one by a tree reduction, the merges of one tree level run in parallel
+	void setParameterValues(const int* rParameterValues, const unsigned int& rNparameterValues); //scan parameter value of each occupancy parameter index, used to align the parameters in merge; default: the parameter index
+	void getParameterValues(std::vector<int>& rParameterValues);
 
 	//options set/get
 	void createOccupancyHist(bool CreateOccHist = true);
 	void createRelBCIDHist(bool CreateRelBCIDHist = true);
 	void createTotHist(bool CreateTotHist = true);
 	void createMeanTotHist(bool CreateMeanTotHist = true);
+	bool isMeanTotHist(); //true if the ToT sums of the mean ToT histogram are allocated
 	void createTdcHist(bool CreateTdcHist = true);
 	void createTdcTriggerDistanceHist(bool CreateTdcTriggerDistanceHist = true);
 	void createTdcPixelHist(bool CreateTdcPixelHist = true);
 	void createTotPixelHist(bool CreateTotPixelHist = true);
+	void createTdcPixelMoments(bool CreateTdcPixelMoments = true); //count, mean, RMS, min and max of the TDC value for each pixel
+	void setTdcPixelHistBinWidth(const unsigned int& rBinWidth); //number of TDC values per bin of the TDC pixel histogram, has to divide __N_TDC_PIXEL_VALUES (larger TDC values are not histogrammed), resets the histogram
+	unsigned int getNtdcPixelHistBins();
+	void setSparseTdcPixelHist(bool SparseTdcPixelHist = true); //store the TDC pixel histogram in tiles that are allocated on first touch, resets the histogram
+	bool getSparseTdcPixelHist();
+	size_t getTdcPixelHistMemory(); //returns the memory used by the TDC pixel histogram in bytes
 	void setMaxTot(const unsigned int& rMaxTot);
+	void setSparseOccupancy(bool SparseOccupancy = true); //store the occupancy and mean ToT histograms in tiles that are allocated on first touch, has to be set before the scan parameters
+	bool getSparseOccupancy();
+	size_t getOccupancyMemory(); //returns the memory used by the occupancy and mean ToT histograms in bytes
+	void createDecayingOccupancyHist(bool CreateDecayingOccupancyHist = true); //occupancy where every hit decays with the event number, for live displays
+	void setOccupancyHalfLife(const double& rHalfLife); //number of events after which a hit of the decaying occupancy counts half, resets the decaying occupancy
+	double getOccupancyHalfLife();
+	void createTimeHist(bool CreateTimeHist = true); //time-binned event, hit, TDC, error code and region occupancy histograms from the read out time stamps (setMetaTimeStamps)
+	void setTimeHistBinning(const double& rBinWidth, const unsigned int& rNbins, const unsigned int& rNcolumnRegions = 1, const unsigned int& rNrowRegions = 1); //bin width in time stamp units, only the newest rNbins bins are kept (ring), the module columns/rows are split into rNcolumnRegions/rNrowRegions regions; resets the time histograms
+	void setPixelMajorOccupancy(bool PixelMajorOccupancy = true); //store the occupancy and mean ToT histograms with the parameter as fastest index, getOccupancy/getMeanTot still return the col, row, parameter order
+	bool getPixelMajorOccupancy();
+	void setNchips(const unsigned int& rNchips); //module layout of 1 (80 x 336 pixels), 2 (160 x 336) or 4 chips (160 x 672), the hit columns and rows have to be module coordinates (Interpret::setModuleChip), resets the pixel histograms
+	unsigned int getNchips();
+	void setPixelMask(const unsigned char* rMask, const unsigned int& rNcolumns, const unsigned int& rNrows); //hits of pixels with rMask != 0 (sorted via col, row) are not histogrammed and counted per pixel, the mask is cleared if the module layout changes
+	void clearPixelMask();
+	void getDroppedHits(unsigned int* rDroppedHits); //copies the number of dropped hits of each pixel
+	uint64_t getNdroppedHits(); //returns the total number of hits dropped by the pixel mask
+	unsigned int getNcolumns();
+	unsigned int getNrows();
+	void setStorageFile(const std::string& rFileName, bool Resume = false); //stores the occupancy, ToT sums and TDC pixel histogram dense in memory-mapped files rFileName + "_occupancy.dat", "_tot_sum.dat", "_tot_square_sum.dat", "_tdc_pixel.dat" (layout see TiledArray.h), empty name: heap; the sparse options are cleared; Resume: the content of files with the same layout and parameter values is kept, thus the histogram options have to be set before the histograms are enabled, throws if histograms are already in memory
+	std::string getStorageFile();
+	void setNthreads(const unsigned int& rNthreads); //number of threads used in addHits, 0 = OpenMP default
+	unsigned int getNthreads(); //returns the number of threads used in addHits, always 1 if compiled without OpenMP
 
 	void addHits(HitInfo*& rHitInfo, const unsigned int& rNhits);
 	void addClusterSeedHits(ClusterInfo*& rClusterInfo, const unsigned int& rNcluster);
 	void addScanParameter(int*& rParInfo, const unsigned int& rNparInfoLength);
 	void setNoScanParameter();
 	void addMetaEventIndex(uint64_t*& rMetaEventIndex, const unsigned int& rNmetaEventIndexLength);
+	void setMetaTimeStamps(const double* rTimeStamps, const unsigned int& rNtimeStamps); //copies the start time stamp of each read out, same length as the meta event index; the first time stamp is the start of the first time bin
 
 	void calculateThresholdScanArrays(double rMuArray[], double rSigmaArray[], const unsigned int& rMaxInjections, const unsigned int& min_parameter, const unsigned int& max_parameter); //takes the occupancy histograms for different parameters for the threshold arrays
+	void startLiveThreshold(const unsigned int& rMaxInjections, const unsigned int& min_parameter, const unsigned int& max_parameter); //resets the incremental threshold estimation, the scan parameters have to be set
+	void addLiveThresholdStep(); //has to be called when the next parameter step is completely histogrammed, updates the running sums of the incremental threshold estimation
+	void getLiveThreshold(double rMuArray[], double rSigmaArray[]); //threshold and noise from the steps so far, the missing steps are assumed to be fully efficient; equals calculateThresholdScanArrays after the last step
+	unsigned int getNliveThresholdSteps(); //returns the number of parameter steps added to the incremental threshold estimation
+	void fitScurves(double rThreshold[], double rNoise[], double rChi2[], unsigned char rStatus[], const unsigned int& rMaxInjections, const unsigned int& min_parameter, const unsigned int& max_parameter); //fits an error function to the occupancy of each pixel with Levenberg-Marquardt, seeded with the quick threshold algorithm
 
 	unsigned int getNparameters(); //returns the parameter range from _parInfo
 
@@ -52,8 +126,11 @@ public:
 	void resetTdcArray();
 	void resetTdcTriggerDistanceArray();
 	void resetTdcPixelArray();
+	void resetTdcPixelMomentsArray();
 	void resetTotPixelArray();
 	void resetRelBcidArray();
+	void resetTimeHist();
+	void resetDecayingOccupancyArray();
 
 	void reset(); // resets the histograms and keeps the settings
 
@@ -66,6 +143,29 @@ private:
 	void allocateTotArray();
 	void allocateMeanTotArray();
 	void deleteMeanTotArray();
+	void calculateMeanTot(float* rMeanTot); //sets the mean ToT array from _totSum and _occupancy
+	void calculateTotRms(float* rTotRms); //sets the ToT RMS array from _totSum, _totSquareSum and _occupancy
+	size_t getOccupancyIndex(const size_t& rPixel, const unsigned int& rParIndex); //index of _occupancy, _totSum and _totSquareSum for the storage layout
+	size_t getExportIndex(const size_t& rIndex); //index in the col, row, parameter order of the _occupancy index rIndex
+	void getOccupancyBlock(const size_t& rPixelBlock, std::vector<const unsigned int*>& rRows, std::vector<unsigned int>& rBuffer); //sets for every parameter the occupancy of the __HIST_TILE_SIZE pixels of the block, 0 for no hits; rBuffer is used in the pixel-major layout
+	void exportOccupancy(unsigned int* rTarget); //copies the occupancy in the col, row, parameter order
+	void checkMerge(Histogram& rHistogram); //throws if rHistogram cannot be merged, called before anything is changed
+	unsigned int mergeHistograms(Histogram& rHistogram); //merge without checks and warnings, returns the number of hits not added to saturated bins
+	bool mergesOccupancy(); //the occupancy is histogrammed and allocated, thus merged
+	void addParameterValues(const std::vector<int>& rParameterValues); //adds the missing parameter values (reallocates the occupancy and mean ToT arrays and maps the parameter indices of _parInfo to the new ones)
+	void mergeParameterValues(Histogram& rHistogram, std::vector<unsigned int>& rParIndex); //adds the missing parameter values of rHistogram and sets the parameter index here of each of its parameters
+	static unsigned int addTilesSaturated(const TiledArray<unsigned short>& rSource, TiledArray<unsigned short>& rTarget); //adds a 16 bit histogram, bins saturate like in filling, returns the number of hits not added
+	template<class T> void addOccupancyTiles(const TiledArray<T>& rSource, const bool& rSourcePixelMajor, const std::vector<unsigned int>& rParIndex, TiledArray<T>& rTarget); //adds an occupancy like array, source parameter index i is added to rParIndex[i]
+	void deserialize(const unsigned char* rBlob, const size_t& rSize); //sets up a new histogrammer from a blob written by serialize
+	template<class T> void writeBlob(std::vector<unsigned char>& rBlob, const T* rData, const size_t& rSize);
+	template<class T> void readBlob(const unsigned char* rBlob, const size_t& rBlobSize, size_t& rPosition, T* rData, const size_t& rSize); //throws if the blob is too short
+	template<class T> void writeBlobTiles(std::vector<unsigned char>& rBlob, const TiledArray<T>& rSource, const bool& rExportOrder); //writes the tiles with entries in the col, row, parameter order
+	template<class T> void readBlobTiles(const unsigned char* rBlob, const size_t& rBlobSize, size_t& rPosition, TiledArray<T>& rTarget);
+	void clearSnapshots(); //empties all snapshot buffers, the next publishing copies all tiles
+	void publishSnapshot(); //copies the changed tiles and small histograms into the publishing buffer and exchanges it with the published one, called with the fill lock at the end of a batch
+	template<class T> void snapshotTiles(TiledArray<T>& rSource, std::vector<T>& rTarget, const unsigned int& rBuffer, const bool& rExportOrder); //copies the dirty tiles of the buffer, rExportOrder: transpose the pixel-major occupancy layout
+	template<class T> void snapshotArray(const T* rSource, const size_t& rSize, std::vector<T>& rTarget); //copies the whole array, for the small histograms without tiles
+	static void calculateTdcPixelMoments(const size_t& rNpixel, const unsigned int* rPixelCount, const uint64_t* rPixelSum, const uint64_t* rPixelSquareSum, float* rMean, float* rRms); //mean and RMS from the TDC sums, NAN for pixels without hits
 	void allocateTdcArray();
 	void allocateTdcTriggerDistanceArray();
 	void deleteTotArray();
@@ -77,17 +177,62 @@ private:
 	void allocateTdcPixelArray();
 	void deleteTotPixelArray();
 	void deleteTdcPixelArray();
-	
-	unsigned int* _occupancy;			//2d hit histogram for each parameter (in total 3d, linearly sorted via col, row, parameter)
+	void allocateTdcPixelMomentsArray();
+	void deleteTdcPixelMomentsArray();
+
+	unsigned char fitScurve(const double* rOccupancy, const unsigned int& rNparameters, const double& rMinParameter, const double& rParameterStep, const double& rMaxInjections, double& rThreshold, double& rNoise, double& rChi2); //fits one S-curve, threshold and noise have to be set to the start values, returns the fit status
+
+	//addHits helper functions
+	unsigned int validateHits(HitInfo*& rHitInfo, const unsigned int& rNhits); //range checks all hits and sets _hitParIndex, throws for the first invalid hit, returns the number of real hits
+	unsigned int markMaskedHits(HitInfo*& rHitInfo, const unsigned int& rNhits); //sets _hitMasked for the hits of masked pixels and counts them as dropped, returns their number
+	bool skipHit(HitInfo*& rHitInfo, const unsigned int& rIndex); //virtual hit or hit of a masked pixel, tested in the fill loops
+	void throwInvalidHit(const HitInfo& rHit); //throws the out of range exception of the first invalid value of the hit
+	void fillHits(HitInfo*& rHitInfo, const unsigned int& rNhits); //addHits without the fill lock and the publishing
+	void fillHistsParallel(HitInfo*& rHitInfo, const unsigned int& rNhits, const unsigned int& rNthreads); //fills all but the pixel ToT/TDC histograms with rNthreads threads
+	void markOccupancyTiles(HitInfo*& rHitInfo, const unsigned int& rNhits); //marks the occupancy (and ToT sum) tiles of the hits dirty, allocates them in sparse mode
+	void fillOccupancyDirect(HitInfo*& rHitInfo, const unsigned int& rFirstHit, const unsigned int& rLastHit, const bool& rMarked); //fills the occupancy (and ToT sums) without partial histograms, dense arrays via data() (tiles marked by markOccupancyTiles), sparse ones via operator[]; rMarked: the sparse tiles are allocated and marked, thus threads can share them
+	template<class TOccupancy, class TTotSum, class TTotSquareSum> void fillOccupancyArrays(HitInfo*& rHitInfo, const unsigned int& rFirstHit, const unsigned int& rLastHit, TOccupancy& rOccupancy, TTotSum& rTotSum, TTotSquareSum& rTotSquareSum); //fillOccupancyMeanTotHist or fillOccupancyHist with the layout of _occupancy
+	void addArray(const unsigned int* rSource, const unsigned int& rLength, unsigned int* rTarget);
+	template<class TOccupancy> void fillOccupancyHist(HitInfo*& rHitInfo, const unsigned int& rFirstHit, const unsigned int& rLastHit, TOccupancy& rOccupancy, const unsigned int& rParOffset, const size_t& rPixelStride, const size_t& rParStride); //TOccupancy: dense array, sparse TiledArray or UnmarkedTiles, index = pixel * rPixelStride + (parameter index - rParOffset) * rParStride
+	template<class TOccupancy, class TTotSum, class TTotSquareSum> void fillOccupancyMeanTotHist(HitInfo*& rHitInfo, const unsigned int& rFirstHit, const unsigned int& rLastHit, TOccupancy& rOccupancy, TTotSum& rTotSum, TTotSquareSum& rTotSquareSum, const unsigned int& rParOffset, const size_t& rPixelStride, const size_t& rParStride);
+	void fillRelBcidHist(HitInfo*& rHitInfo, const unsigned int& rFirstHit, const unsigned int& rLastHit, unsigned int* rRelBcid);
+	void fillTotHist(HitInfo*& rHitInfo, const unsigned int& rFirstHit, const unsigned int& rLastHit, unsigned int* rTot);
+	void fillTdcHist(HitInfo*& rHitInfo, const unsigned int& rFirstHit, const unsigned int& rLastHit, unsigned int* rTdc);
+	void fillTdcTriggerDistanceHist(HitInfo*& rHitInfo, const unsigned int& rFirstHit, const unsigned int& rLastHit, unsigned int* rTdcTriggerDistance);
+	void fillTdcPixelHist(HitInfo*& rHitInfo, const unsigned int& rNhits);
+	template<class TTdcPixel> void fillTdcPixelBins(HitInfo*& rHitInfo, const unsigned int& rNhits, TTdcPixel& rTdcPixel, unsigned int& rNsaturated, unsigned int& rNoutOfRange); //TTdcPixel: dense array or sparse TiledArray
+	size_t getTdcPixelIndex(const HitInfo& rHit); //index of _tdcPixel, the TDC value has to be < __N_TDC_PIXEL_VALUES
+	void fillTdcPixelMoments(HitInfo*& rHitInfo, const unsigned int& rNhits);
+	void fillTotPixelHist(HitInfo*& rHitInfo, const unsigned int& rNhits);
+	void fillDecayingOccupancyHist(HitInfo*& rHitInfo, const unsigned int& rNhits);
+	void moveDecayOrigin(const double& rOrigin); //sets the decay origin and updates the tile factors, tiles that decayed below the double range are reset
+	void fillTimeHist(HitInfo*& rHitInfo, const unsigned int& rNhits); //uses the time bins of validateHits, the events are counted once also if their hits are added in several calls
+	void advanceTimeHist(const int64_t& rTimeBin); //moves the ring to end at rTimeBin, the bins that drop out of the ring are reset and reused
+	int64_t getTimeBin(const int64_t& rEventNumber); //returns the time bin of the read out of the event
+
+	TiledArray<unsigned int> _occupancy;	//2d hit histogram for each parameter (in total 3d, linearly sorted via col, row, parameter or parameter, col, row in the pixel-major layout)
+	unsigned int* _occupancyExport;		//dense copy of _occupancy returned by getOccupancy in sparse mode
 	unsigned int* _tot;					//ToT histogram
-	float* _meanTot;					//2d hit mean ToT histogram for each parameter
+	TiledArray<unsigned int> _totSum;	//2d hit ToT sum for each parameter, same indexing as _occupancy
+	TiledArray<uint64_t> _totSquareSum;	//2d hit ToT square sum for each parameter, same indexing as _occupancy
+	float* _meanTot;					//2d hit mean ToT histogram for each parameter, set from _totSum in getMeanTot, only allocated if not copied
+	float* _totRms;						//2d hit ToT RMS histogram for each parameter, set from _totSum/_totSquareSum in getTotRms, only allocated if not copied
 	unsigned int* _tdc;					//TDC histogram
 	unsigned int* _tdcTriggerDistance;	//TDC trigger distance histogram
-	unsigned short* _tdcPixel;			//3d pixel TDC histogram (in total 3d, linearly sorted via col, row, tdc value)
-	unsigned short* _totPixel;			//3d pixel ToT histogram (in total 3d, linearly sorted via col, row, tot value)
+	TiledArray<unsigned short> _tdcPixel;	//3d pixel TDC histogram (in total 3d, linearly sorted via col, row, tdc bin)
+	unsigned short* _tdcPixelExport;	//dense copy of _tdcPixel returned by getTdcPixelHist in sparse mode
+	unsigned int* _tdcPixelCount;		//number of TDC values for each pixel
+	uint64_t* _tdcPixelSum;				//TDC value sum for each pixel
+	uint64_t* _tdcPixelSquareSum;		//TDC value square sum for each pixel
+	unsigned short* _tdcPixelMin;		//minimum TDC value for each pixel
+	unsigned short* _tdcPixelMax;		//maximum TDC value for each pixel
+	TiledArray<unsigned short> _totPixel;	//3d pixel ToT histogram (in total 3d, linearly sorted via col, row, tot value), dense tiles
 	unsigned int* _relBcid;				//relative BCID histogram
 
 	unsigned int getParIndex(int64_t& rEventNumber); //returns the parameter index for the given event number
+	unsigned int mapParIndex(const int& rParIndex); //parameter index of an index of _parInfo, see _parIndexMap
+	std::vector<double> _metaTimeStamps;	//start time stamp of each read out
+	uint64_t _lastTimeReadoutIndex;		//for loop speed up of getTimeBin
 
 	unsigned int _nMetaEventIndexLength;//length of the meta data event index array
 	uint64_t* _metaEventIndex;			//event index of meta data array
@@ -97,6 +242,67 @@ private:
 	unsigned int _NparameterValues;		//needed for _occupancy histogram allocation
 
 	std::map<int, unsigned int> _parameterValues; //different parameter values used in ParInfo, key = parameter value, value = index
+	std::vector<unsigned int> _parIndexMap;	//parameter index of each index of _parInfo after merge added parameter values, empty: unchanged
+	unsigned int _nChips;				//number of chips of the module
+	unsigned int _nColumns;				//number of pixel columns of the module
+	unsigned int _nRows;				//number of pixel rows of the module
+	size_t _occupancyPixelStride;		//index step of one pixel in _occupancy, 1 or the number of parameters in the pixel-major layout
+	size_t _occupancyParStride;			//index step of one parameter in _occupancy, number of pixels or 1 in the pixel-major layout
+	PixelMask _pixelMask;				//masked pixels, their hits are not histogrammed
+	std::vector<unsigned char> _hitMasked;	//1 for every hit of the actual addHits call of a masked pixel, empty if no hit is masked
+	std::vector<unsigned int> _hitParIndex;	//parameter index of every hit of the actual addHits call, set by validateHits
+	std::vector<double> _decayingOccupancy;	//decaying occupancy of each pixel, the hits of a tile are weighted relative to the tile epoch: pixel value * 2^(-(last event - tile epoch)/half life)
+	std::vector<double> _decayTileFactor;	//2^((decay origin - tile epoch)/half life) for each tile of __HIST_TILE_SIZE pixels, thus a hit weight is event weight * tile factor
+	double _decayOrigin;					//event number with the weight 1
+	double _decayEventNumber;				//largest event number added to the decaying occupancy
+	bool _decayStarted;						//the origin is set to the first event number
+	std::vector<int64_t> _hitTimeBin;		//time bin of every hit of the actual addHits call, set by validateHits
+	std::vector<unsigned int> _timeHistEvents;	//time histograms, ring of _nTimeHistBins bins, time bin b is stored at b % _nTimeHistBins
+	std::vector<unsigned int> _timeHistHits;
+	std::vector<unsigned int> _timeHistTdc;
+	std::vector<unsigned int> _timeHistErrors;	//__N_ERROR_CODES entries per bin
+	std::vector<unsigned int> _timeHistRegions;	//_nTimeHistColumnRegions * _nTimeHistRowRegions entries per bin
+	int64_t _timeHistFirstBin;				//oldest time bin in the ring
+	int64_t _timeHistLastBin;				//newest time bin in the ring, < _timeHistFirstBin if empty
+	int64_t _timeHistLastEventNumber;		//last counted event, -1 if none
+	double _timeHistOrigin;					//start time stamp of time bin 0
+	bool _timeHistOriginSet;
+	uint64_t _nTimeHistLostHits;
+	std::vector<unsigned int> _liveM;		//incremental threshold estimation: occupancy sum of the steps so far of each pixel
+	std::vector<unsigned int> _liveMu1;		//incremental threshold estimation: occupancy sum of the steps below the threshold of each pixel
+	std::vector<unsigned int> _liveMu2;		//incremental threshold estimation: missing hits sum of the steps above the threshold of each pixel
+	std::vector<unsigned int> _liveSplit;	//incremental threshold estimation: first step above the threshold of each pixel
+	unsigned int _liveNsteps;				//number of steps added to the incremental threshold estimation
+	unsigned int _liveMaxInjections;
+	unsigned int _liveMaxParameter;
+	unsigned int _liveParameterStep;
+	bool _createSnapshots;
+	unsigned int _snapshotIndex;			//snapshot buffer returned by the getSnapshot functions
+	unsigned int _snapshotReady;			//buffer of the last published histograms
+	unsigned int _snapshotWork;				//buffer written by publishSnapshot, only used by the filling thread
+	bool _snapshotFresh;					//histograms were published since the last snapshot
+	unsigned int _nSnapshots;
+	std::vector<unsigned int> _snapshotOccupancy[__N_SNAPSHOT_BUFFERS];	//snapshot buffers of the histograms, the vectors are only resized if the histogram size changes
+	std::vector<unsigned int> _snapshotTot[__N_SNAPSHOT_BUFFERS];
+	std::vector<unsigned int> _snapshotTdc[__N_SNAPSHOT_BUFFERS];
+	std::vector<unsigned int> _snapshotTdcTriggerDistance[__N_SNAPSHOT_BUFFERS];
+	std::vector<unsigned int> _snapshotRelBcid[__N_SNAPSHOT_BUFFERS];
+	std::vector<unsigned short> _snapshotTotPixel[__N_SNAPSHOT_BUFFERS];
+	std::vector<unsigned short> _snapshotTdcPixel[__N_SNAPSHOT_BUFFERS];
+	std::vector<unsigned int> _snapshotTotSum[__N_SNAPSHOT_BUFFERS];
+	std::vector<uint64_t> _snapshotTotSquareSum[__N_SNAPSHOT_BUFFERS];
+	std::vector<unsigned int> _snapshotTdcPixelCount[__N_SNAPSHOT_BUFFERS];
+	std::vector<uint64_t> _snapshotTdcPixelSum[__N_SNAPSHOT_BUFFERS];
+	std::vector<uint64_t> _snapshotTdcPixelSquareSum[__N_SNAPSHOT_BUFFERS];
+	std::vector<unsigned short> _snapshotTdcPixelMin[__N_SNAPSHOT_BUFFERS];
+	std::vector<unsigned short> _snapshotTdcPixelMax[__N_SNAPSHOT_BUFFERS];
+	Mutex _fillMutex;						//locked by addHits, addClusterSeedHits and reset, thus the histograms have one writer and are published between two batches
+	Mutex _snapshotMutex;					//locked while the snapshot buffer index changes or the snapshot is read
+	Mutex _publishMutex;					//locked while the published and the snapshot or publishing buffer index are exchanged
+	std::vector<unsigned int> _partialOccupancy;	//thread private occupancy histograms of fillHistsParallel
+	std::vector<unsigned int> _partialTotSum;		//thread private ToT sums of fillHistsParallel
+	std::vector<uint64_t> _partialTotSquareSum;		//thread private ToT square sums of fillHistsParallel
+	std::vector<unsigned int> _partialHists;		//thread private relative BCID, ToT, TDC and TDC trigger distance histograms of fillHistsParallel
 
 	//config variables
 	bool _createOccHist;
@@ -107,7 +313,22 @@ private:
 	bool _createTdcTriggerDistanceHist;
 	bool _createTdcPixelHist;
 	bool _createTotPixelHist;
+	bool _createTdcPixelMoments;
+	bool _createDecayingOccupancyHist;
+	double _decayHalfLife; //number of events after which a hit counts half in the decaying occupancy
+	bool _createTimeHist;
+	double _timeHistBinWidth; //time stamp units per time bin
+	unsigned int _nTimeHistBins; //ring size of the time histograms
+	unsigned int _nTimeHistColumnRegions;
+	unsigned int _nTimeHistRowRegions;
+	bool _sparseOccupancy;
+	bool _pixelMajorOccupancy;
+	std::string _storageFileName; //prefix of the memory-mapped histogram files, empty: heap
+	bool _resumeStorage; //keep the content of existing histogram files
+	bool _sparseTdcPixelHist;
+	unsigned int _tdcPixelBinWidth; //number of TDC values per TDC pixel histogram bin
 	unsigned int _maxTot; //maximum ToT value (inclusive) considered to be a hit
+	unsigned int _nThreads; //number of threads used in addHits, 0 = OpenMP default
 	
 	int* _parInfo;
 };
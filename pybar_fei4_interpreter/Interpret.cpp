@@ -1,5 +1,10 @@
 #include "Interpret.h"
 
+static bool triggerKeyLess(const TriggerIndexInfo& rOne, const TriggerIndexInfo& rTwo)
+{
+	return rOne.triggerKey < rTwo.triggerKey;
+}
+
 Interpret::Interpret(void)
 {
 	setSourceFileName("Interpret()");
@@ -54,7 +59,16 @@ void Interpret::setStandardSettings()
 	_maxTdcDelay = 255;
 	_alignAtTdcWord = false;
 	_dataWordIndex = 0;
-	_maxTriggerNumber = (2 ^ 31) - 1;
+	_maxTriggerNumber = TRIGGER_NUMBER_MASK_NEW;
+	_nModuleChips = 1;
+	_moduleChip = 0;
+	_noiseWindow = 0;
+	_noiseMaxSigma = 5.;
+	_noiseMaxRate = 0;
+	_noiseAutoMask = false;
+	_nNoisyPixels = 0;
+	_noiseWindowStarted = false;
+	_createTriggerIndex = false;
 }
 
 bool Interpret::interpretRawData(unsigned int* pDataWords, const unsigned int& pNdataWords)
@@ -441,9 +455,16 @@ void Interpret::resetCounters()
 	_nTDCWords = 0;
 	_nOtherWords = 0;
 	_nHits = 0;
+	_nStoredHits = 0;
 	_nSmallHits = 0;
 	_nEmptyEvents = 0;
 	_nMaxHitsPerEvent = 0;
+	_pixelMask.resetDropped();
+	resetNoisyPixelDetection();
+	_triggerIndex.clear();
+	_triggerIndexSorted = true;
+	_lastTriggerKey = 0;
+	_lastIndexTriggerNumber = 0;
 	_firstTriggerNrSet = false;
 	_firstTdcSet = false;
 	_lastTriggerNumber = 0;
@@ -507,6 +528,62 @@ void Interpret::setMaxTot(const unsigned int& rMaxTot)
 	_maxTot = rMaxTot;
 }
 
+void Interpret::setModuleChip(const unsigned int& rNchips, const unsigned int& rChip)
+{
+	if (rNchips != 1 && rNchips != 2 && rNchips != 4)
+		throw std::invalid_argument("Module layout with " + IntToStr(rNchips) + " chips not supported, use 1, 2 or 4 chips.");
+	if (rChip >= rNchips)
+		throw std::out_of_range("Chip " + IntToStr(rChip) + " not in a module with " + IntToStr(rNchips) + " chips.");
+	if (rNchips != _nModuleChips && _pixelMask.enabled()) {
+		warning("setModuleChip: pixel mask of the old module layout cleared");
+		_pixelMask.clear();
+	}
+	bool tNewGeometry = rNchips != _nModuleChips;
+	_nModuleChips = rNchips;
+	_moduleChip = rChip;
+	if (tNewGeometry && _noiseWindow > 0)
+		resetNoisyPixelDetection();
+}
+
+void Interpret::setNoisyPixelDetection(const double& rWindow, const double& rMaxSigma, const double& rMaxRate, bool AutoMask)
+{
+	if (rWindow < 0 || rMaxSigma < 0 || rMaxRate < 0)
+		throw std::invalid_argument("Noisy pixel detection window and limits have to be positive.");
+	if (rWindow > 0 && rMaxSigma == 0 && rMaxRate == 0)
+		throw std::invalid_argument("Noisy pixel detection needs a sigma or a rate limit.");
+	_noiseWindow = rWindow;
+	_noiseMaxSigma = rMaxSigma;
+	_noiseMaxRate = rMaxRate;
+	_noiseAutoMask = AutoMask;
+	resetNoisyPixelDetection();
+}
+
+void Interpret::getNoisyPixels(unsigned char* rNoisyPixels)
+{
+	if (_noisyPixels.size() == (size_t) getNcolumns() * (size_t) getNrows())
+		std::copy(_noisyPixels.begin(), _noisyPixels.end(), rNoisyPixels);
+	else
+		std::fill(rNoisyPixels, rNoisyPixels + (size_t) getNcolumns() * (size_t) getNrows(), 0);
+}
+
+void Interpret::setPixelMask(const unsigned char* rMask, const unsigned int& rNcolumns, const unsigned int& rNrows)
+{
+	if (rNcolumns != getNcolumns() || rNrows != getNrows())
+		throw std::invalid_argument("Pixel mask has to have " + IntToStr(getNcolumns()) + " x " + IntToStr(getNrows()) + " pixels.");
+	_pixelMask.set(rMask, rNcolumns, rNrows);
+	info("setPixelMask: " + IntToStr(_pixelMask.getNmasked()) + " pixels masked");
+}
+
+void Interpret::clearPixelMask()
+{
+	_pixelMask.clear();
+}
+
+void Interpret::getDroppedHits(unsigned int* rDroppedHits)
+{
+	_pixelMask.getDropped(rDroppedHits, (size_t) getNcolumns() * (size_t) getNrows());
+}
+
 void Interpret::setMaxTdcDelay(const unsigned int& rtMaxTdcDelay)
 {
 	_maxTdcDelay = rtMaxTdcDelay;
@@ -523,6 +600,59 @@ void Interpret::setMaxTriggerNumber(const unsigned int& rMaxTriggerNumber)
 	_maxTriggerNumber = rMaxTriggerNumber;
 }
 
+void Interpret::createTriggerIndex(bool CreateTriggerIndex)
+{
+	info("createTriggerIndex()");
+	_createTriggerIndex = CreateTriggerIndex;
+}
+
+void Interpret::getTriggerIndex(TriggerIndexInfo* rTriggerIndex)
+{
+	sortTriggerIndex();
+	if (!_triggerIndex.empty())
+		std::copy(_triggerIndex.begin(), _triggerIndex.end(), rTriggerIndex);
+}
+
+unsigned int Interpret::findTriggerKey(const int64_t& rTriggerKey)
+{
+	sortTriggerIndex();
+	unsigned int tLow = 0;  // all entries below have a smaller key
+	unsigned int tHigh = (unsigned int) _triggerIndex.size();  // all entries from here on have a key >= rTriggerKey
+	for (unsigned int i = 0; i < __MAX_INTERPOLATION_STEPS && tLow < tHigh; ++i) {  // keys increase almost linearly, thus interpolate the position first
+		const int64_t tLowKey = _triggerIndex[tLow].triggerKey;
+		const int64_t tHighKey = _triggerIndex[tHigh - 1].triggerKey;
+		if (rTriggerKey <= tLowKey)
+			return tLow;
+		if (rTriggerKey > tHighKey)
+			return tHigh;
+		unsigned int tPosition = tLow + (unsigned int) ((double) (rTriggerKey - tLowKey) / (double) (tHighKey - tLowKey) * (double) (tHigh - 1 - tLow));
+		if (tPosition >= tHigh)
+			tPosition = tHigh - 1;
+		if (_triggerIndex[tPosition].triggerKey < rTriggerKey)
+			tLow = tPosition + 1;
+		else
+			tHigh = tPosition;
+	}
+	TriggerIndexInfo tSearch;
+	tSearch.triggerKey = rTriggerKey;
+	return (unsigned int) (std::lower_bound(_triggerIndex.begin() + tLow, _triggerIndex.begin() + tHigh, tSearch, triggerKeyLess) - _triggerIndex.begin());  // binary search in the remaining range
+}
+
+void Interpret::findTriggerEvents(const int64_t* rTriggerKeys, const unsigned int& rSize, int64_t* rEventNumber, int64_t* rHitIndex)
+{
+	for (unsigned int i = 0; i < rSize; ++i) {
+		unsigned int tIndex = findTriggerKey(rTriggerKeys[i]);
+		if (tIndex < _triggerIndex.size() && _triggerIndex[tIndex].triggerKey == rTriggerKeys[i]) {
+			rEventNumber[i] = _triggerIndex[tIndex].eventNumber;
+			rHitIndex[i] = _triggerIndex[tIndex].hitIndex;
+		}
+		else {
+			rEventNumber[i] = -1;
+			rHitIndex[i] = -1;
+		}
+	}
+}
+
 void Interpret::alignAtTdcWord(bool alignAtTdcWord)
 {
 	info("alignAtTdcWord()");
@@ -667,6 +797,8 @@ void Interpret::printStatus()
 	std::cout << "_useTriggerTimeStamp " << _useTriggerTimeStamp << "\n";
 	std::cout << "_useTdcTriggerTimeStamp " << _useTdcTriggerTimeStamp << "\n";
 	std::cout << "_maxTdcDelay " << _maxTdcDelay << "\n";
+	std::cout << "_nModuleChips " << _nModuleChips << "\n";
+	std::cout << "_moduleChip " << _moduleChip << "\n";
 
 	std::cout << "\none event variables\n";
 	std::cout << "tNdataWords " << tNdataWords << "\n";
@@ -791,6 +923,9 @@ void Interpret::storeHit(HitInfo& rHit)
 		if (_hitInfo != 0) {
 			_hitInfo[_hitIndex] = rHit;
 			_hitIndex++;
+			_nStoredHits++;
+			if (_noiseWindow > 0 && (rHit.event_status & __NO_HIT) != __NO_HIT)	//the noisy pixel detection counts the stored real hits
+				_noiseCounts[_noiseCountsOffset + (size_t) (rHit.column - 1) + (size_t) (rHit.row - 1) * getNcolumns()]++;
 		}
 		else {
 			throw std::runtime_error("Output hit array not set.");
@@ -835,6 +970,8 @@ void Interpret::addEvent()
 		addEventErrorCode(__MANY_TDC_WORDS);
 	}
 
+	if (_createTriggerIndex)
+		addTriggerIndex();
 	storeEventHits();
 	if (tTotalHits > _nMaxHitsPerEvent)
 		_nMaxHitsPerEvent = tTotalHits;
@@ -868,6 +1005,47 @@ void Interpret::storeEventHits()
 	}
 }
 
+void Interpret::addTriggerIndex()
+{
+	if (!_firstTriggerNrSet)  // events before the first trigger word have no trigger number
+		return;
+	int64_t tPeriod = (int64_t) std::min(_maxTriggerNumber, (unsigned int) TRIGGER_NUMBER_MASK_NEW) + 1;  // trigger number range
+	if (_TriggerFormat == 1)  // TIMESTAMP mode
+		tPeriod = (int64_t) TRIGGER_TIME_STAMP_MASK + 1;
+	else if (_TriggerFormat == 2)  // COMBINED mode, only the trigger number is kept
+		tPeriod = (int64_t) std::min(_maxTriggerNumber, (unsigned int) TRIGGER_NUMBER_MASK_COMBINED) + 1;
+	TriggerIndexInfo tEntry;
+	if (_triggerIndex.empty())
+		tEntry.triggerKey = tEventTriggerNumber;
+	else {  // unwrap the trigger number by taking the shortest distance to the last one, thus a single wrong trigger number does not shift the following keys
+		int64_t tDistance = ((int64_t) tEventTriggerNumber - (int64_t) _lastIndexTriggerNumber) % tPeriod;
+		if (_TriggerFormat == 1){  // time stamps only increase, thus every decrease is a wrap and gaps longer than half the period are kept
+			if (tDistance < 0)
+				tDistance += tPeriod;
+		}
+		else if (tDistance > tPeriod / 2)
+			tDistance -= tPeriod;
+		else if (tDistance <= -tPeriod / 2)
+			tDistance += tPeriod;
+		tEntry.triggerKey = _lastTriggerKey + tDistance;
+		if (tEntry.triggerKey < _triggerIndex.back().triggerKey)
+			_triggerIndexSorted = false;
+	}
+	tEntry.eventNumber = (int64_t) _nEvents;
+	tEntry.hitIndex = (int64_t) _nStoredHits;
+	_triggerIndex.push_back(tEntry);
+	_lastTriggerKey = tEntry.triggerKey;
+	_lastIndexTriggerNumber = tEventTriggerNumber;
+}
+
+void Interpret::sortTriggerIndex()
+{
+	if (_triggerIndexSorted)
+		return;
+	std::stable_sort(_triggerIndex.begin(), _triggerIndex.end(), triggerKeyLess);  // stable to keep the first event of a trigger key first
+	_triggerIndexSorted = true;
+}
+
 void Interpret::correlateMetaWordIndex(const uint64_t& pEventNumber, const unsigned int& pDataWordIndex)
 {
 	if (_metaDataSet && pDataWordIndex == _lastWordIndexSet) { // this check is to speed up the _metaEventIndex access by using the fact that the index has to increase for consecutive events
@@ -885,6 +1063,8 @@ void Interpret::correlateMetaWordIndex(const uint64_t& pEventNumber, const unsig
 //				std::cout<<"correlateMetaWordIndex: pEventNumber "<<pEventNumber<<" _lastWordIndexSet "<<_lastWordIndexSet<<" _lastMetaIndexNotSet "<<_lastMetaIndexNotSet<<"\n";
 //				std::cout<<" finished\n";
 			}
+			if (_noiseWindow > 0)
+				updateNoisyPixelDetection(_metaInfoV2[_lastMetaIndexNotSet - 1].startTimeStamp);
 		}
 		else {
 			_lastWordIndexSet = _metaInfo[_lastMetaIndexNotSet].stopIndex;
@@ -898,8 +1078,78 @@ void Interpret::correlateMetaWordIndex(const uint64_t& pEventNumber, const unsig
 //				std::cout<<"correlateMetaWordIndex: pEventNumber "<<pEventNumber<<" _lastWordIndexSet "<<_lastWordIndexSet<<" _lastMetaIndexNotSet "<<_lastMetaIndexNotSet<<"\n";
 //				std::cout<<" finished\n";
 			}
+			if (_noiseWindow > 0)
+				updateNoisyPixelDetection(_metaInfo[_lastMetaIndexNotSet - 1].timeStamp);
+		}
+	}
+}
+
+void Interpret::resetNoisyPixelDetection()
+{
+	const size_t tNpixel = (size_t) getNcolumns() * (size_t) getNrows();
+	_noiseWindowStarted = false;
+	_noiseCountsOffset = 0;
+	_nNoisyPixels = 0;
+	if (_noiseWindow > 0) {
+		_noiseCounts.assign(2 * tNpixel, 0);
+		_noisyPixels.assign(tNpixel, 0);
+	}
+	else {
+		_noiseCounts.clear();
+		_noisyPixels.clear();
+	}
+}
+
+void Interpret::updateNoisyPixelDetection(const double& rTimeStamp)
+{
+	if (!_noiseWindowStarted) {
+		_noiseWindowStarted = true;
+		_noiseWindowStart = rTimeStamp;
+		_noiseHalfWindowStart = rTimeStamp;
+		return;
+	}
+	if (rTimeStamp - _noiseHalfWindowStart < _noiseWindow / 2.)
+		return;
+
+	//the window are the two half windows, the hit rate mean and RMS are calculated from all not flagged and not masked pixels
+	const size_t tNpixel = _noisyPixels.size();
+	const double tDuration = rTimeStamp - _noiseWindowStart;
+	const size_t tOlderOffset = tNpixel - _noiseCountsOffset;
+	double tSum = 0;
+	double tSquareSum = 0;
+	unsigned int tNpixelUsed = 0;
+	for (size_t i = 0; i < tNpixel; ++i) {
+		if (_noisyPixels[i] != 0 || _pixelMask.masked(i))
+			continue;
+		double tHits = (double) _noiseCounts[i] + (double) _noiseCounts[tNpixel + i];
+		tSum += tHits;
+		tSquareSum += tHits * tHits;
+		tNpixelUsed++;
+	}
+	if (tNpixelUsed != 0 && tDuration > 0) {
+		double tMean = tSum / (double) tNpixelUsed;
+		double tRms = std::sqrt(std::max(tSquareSum / (double) tNpixelUsed - tMean * tMean, 0.));
+		for (size_t i = 0; i < tNpixel; ++i) {
+			if (_noisyPixels[i] != 0)
+				continue;
+			unsigned int tHits = _noiseCounts[i] + _noiseCounts[tNpixel + i];
+			bool tNoisy = (_noiseMaxSigma > 0 && tHits >= __MIN_NOISY_PIXEL_HITS && (double) tHits > tMean + _noiseMaxSigma * tRms) || (_noiseMaxRate > 0 && (double) tHits / tDuration > _noiseMaxRate);
+			if (!tNoisy)
+				continue;
+			_noisyPixels[i] = 1;
+			_nNoisyPixels++;
+			if (Basis::infoSet())
+				info("updateNoisyPixelDetection: noisy pixel column " + IntToStr((unsigned int) (i % getNcolumns() + 1)) + " row " + IntToStr((unsigned int) (i / getNcolumns() + 1)) + " with " + IntToStr(tHits) + " hits in " + DoubleToStr(tDuration) + " s");
+			if (_noiseAutoMask)
+				_pixelMask.add(i, getNcolumns(), getNrows());
 		}
 	}
+
+	//the actual half window becomes the older one
+	std::fill(_noiseCounts.begin() + tOlderOffset, _noiseCounts.begin() + tOlderOffset + tNpixel, 0);
+	_noiseCountsOffset = tOlderOffset;
+	_noiseWindowStart = _noiseHalfWindowStart;
+	_noiseHalfWindowStart = rTimeStamp;
 }
 
 bool Interpret::getTimefromDataHeader(const unsigned int& pSRAMWORD, unsigned int& pLVL1ID, unsigned int& pBCID)
@@ -933,6 +1183,16 @@ bool Interpret::isTdcWord(const unsigned int& pSRAMWORD)
 	return false;
 }
 
+void Interpret::setModuleCoordinates(int& rColumn, int& rRow)
+{
+	if (_moduleChip < 2)	//lower chip row
+		rColumn += (int) (_moduleChip * RAW_DATA_MAX_COLUMN);
+	else {	//upper chip row, rotated
+		rColumn = (int) ((4 - _moduleChip) * RAW_DATA_MAX_COLUMN + 1) - rColumn;
+		rRow = (int) (2 * RAW_DATA_MAX_ROW + 1) - rRow;
+	}
+}
+
 bool Interpret::getHitsfromDataRecord(const unsigned int& pSRAMWORD, int& pColHit1, int& pRowHit1, int& pTotHit1, int& pColHit2, int& pRowHit2, int& pTotHit2)
 {
 	//if (DATA_RECORD_MACRO(pSRAMWORD)){	//SRAM word is data record
@@ -950,7 +1210,11 @@ bool Interpret::getHitsfromDataRecord(const unsigned int& pSRAMWORD, int& pColHi
 	if (DATA_RECORD_TOT1_MACRO(pSRAMWORD) <= _maxTot) {	//ommit late/small hit and no hit TOT values for the TOT(1) hit
 		pColHit1 = DATA_RECORD_COLUMN1_MACRO(pSRAMWORD);
 		pRowHit1 = DATA_RECORD_ROW1_MACRO(pSRAMWORD);
-		pTotHit1 = DATA_RECORD_TOT1_MACRO(pSRAMWORD);
+		if (_nModuleChips != 1)
+			setModuleCoordinates(pColHit1, pRowHit1);
+		if (!_pixelMask.enabled() || !_pixelMask.drop(pColHit1, pRowHit1)) {	//TOT1 stays negative for masked pixels
+			pTotHit1 = DATA_RECORD_TOT1_MACRO(pSRAMWORD);
+		}
 	}
 	if (DATA_RECORD_TOT1_MACRO(pSRAMWORD) == 14) {
 		_nSmallHits++;
@@ -960,7 +1224,11 @@ bool Interpret::getHitsfromDataRecord(const unsigned int& pSRAMWORD, int& pColHi
 	if (DATA_RECORD_TOT2_MACRO(pSRAMWORD) <= _maxTot) {	//ommit late/small hit and no hit (15) tot values for the TOT(2) hit
 		pColHit2 = DATA_RECORD_COLUMN2_MACRO(pSRAMWORD);
 		pRowHit2 = DATA_RECORD_ROW2_MACRO(pSRAMWORD);
-		pTotHit2 = DATA_RECORD_TOT2_MACRO(pSRAMWORD);
+		if (_nModuleChips != 1)
+			setModuleCoordinates(pColHit2, pRowHit2);
+		if (!_pixelMask.enabled() || !_pixelMask.drop(pColHit2, pRowHit2)) {
+			pTotHit2 = DATA_RECORD_TOT2_MACRO(pSRAMWORD);
+		}
 	}
 	if (DATA_RECORD_TOT2_MACRO(pSRAMWORD) == 14) {
 		_nSmallHits++;
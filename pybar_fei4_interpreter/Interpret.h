@@ -3,12 +3,15 @@
 #include <iostream>
 #include <iomanip>
 #include <string>
+#include <vector>
+#include <algorithm>
 #include <ctime>
 #include <cmath>
 #include <string>
 
 #include "Basis.h"
 #include "defines.h"
+#include "PixelMask.h"
 
 #define __DEBUG false
 #define __DEBUG2 false
@@ -55,6 +58,21 @@ public:
 	void useTriggerTimeStamp(bool useTriggerTimeStamp = true);	                    //trigger number is giving you a clock count and not a total count
 	void setTriggerFormat(const unsigned int& rTriggerFormat);							//0: 15 bit time stamp + 16 bit trigger number, 1: 31 bit trigger number, 2: 31 bit time stamp
 	void setMaxTriggerNumber(const unsigned int& rMaxTriggerNumber);
+	void setPixelMask(const unsigned char* rMask, const unsigned int& rNcolumns, const unsigned int& rNrows); //hits of pixels with rMask != 0 (sorted via col, row in module coordinates) are dropped during decoding and counted per pixel
+	void clearPixelMask();
+	void getDroppedHits(unsigned int* rDroppedHits);								//copies the number of dropped hits of each masked pixel
+	uint64_t getNdroppedHits(){return _pixelMask.getNdropped();};					//returns the total number of hits dropped by the pixel mask
+	void setNoisyPixelDetection(const double& rWindow, const double& rMaxSigma = 5., const double& rMaxRate = 0., bool AutoMask = false); //flags pixels with a stored hit rate above mean + rMaxSigma * RMS of all pixels or above rMaxRate (Hz, 0 = off) in sliding windows of rWindow seconds of the meta data time stamps, evaluated every half window; AutoMask: flagged pixels are added to the pixel mask; rWindow = 0: off
+	void getNoisyPixels(unsigned char* rNoisyPixels);								//copies the noisy pixel flags (sorted via col, row in module coordinates), flags stay set until resetCounters
+	unsigned int getNnoisyPixels(){return _nNoisyPixels;};
+	void createTriggerIndex(bool CreateTriggerIndex = true);						//stores the trigger key, event number and first hit index of every event after the first trigger word (TriggerIndexInfo), the trigger numbers (time stamps in TIMESTAMP trigger format) are unwrapped at the maximum trigger number (2^31 for time stamps, always forward) into increasing keys; needs 24 bytes per event
+	unsigned int getNtriggerIndex(){return (unsigned int) _triggerIndex.size();};
+	void getTriggerIndex(TriggerIndexInfo* rTriggerIndex);							//copies the trigger index sorted by trigger key
+	unsigned int findTriggerKey(const int64_t& rTriggerKey);						//returns the first trigger index entry with a key >= rTriggerKey (interpolation search) or getNtriggerIndex()
+	void findTriggerEvents(const int64_t* rTriggerKeys, const unsigned int& rSize, int64_t* rEventNumber, int64_t* rHitIndex); //sets the event number and first hit index of the first event of each trigger key, -1 if the key is not in the index
+	void setModuleChip(const unsigned int& rNchips, const unsigned int& rChip);		//the hits of the chip rChip of a module with 1, 2 or 4 chips get module columns/rows (Histogram::setNchips): chips 0, 1 next to each other in column direction, chips 2, 3 above chips 1, 0 rotated by 180 degree
+	unsigned int getNcolumns(){return RAW_DATA_MAX_COLUMN * (_nModuleChips == 1 ? 1 : 2);};	//number of pixel columns of the module set by setModuleChip
+	unsigned int getNrows(){return RAW_DATA_MAX_ROW * (_nModuleChips == 4 ? 2 : 1);};
 
 	void addEvent(); // increases the event counter, adds the actual hits/error/SR codes
 
@@ -88,11 +106,16 @@ private:
 	void storeHit(HitInfo& rHit); // stores the hit into the output hit array _hitInfo
 	void storeEventHits(); // adds the hits of the actual event to _hitInfo
 	void correlateMetaWordIndex(const uint64_t& pEventNumber, const unsigned int& pDataWordIndex); //writes the event number for the meta data
+	void addTriggerIndex();																	//adds the actual event to the trigger index
+	void sortTriggerIndex();																//sorts the trigger index by trigger key if a key decreased
 
 	// SRAM word check and interpreting methods
 	bool getTimefromDataHeader(const unsigned int& pSRAMWORD, unsigned int& pLVL1ID, unsigned int& pBCID); //returns true if the SRAMword is a data header and if it is sets the BCID and LVL1
 	bool isDataRecord(const unsigned int& pSRAMWORD);										//returns true if data word is a data record (no col, row, ToT limit checks done, only check for data record header)
 	bool isTdcWord(const unsigned int& pSRAMWORD);											//returns true if the data word is a TDC count word
+	void resetNoisyPixelDetection();															//clears the window counts and the noisy pixel flags
+	void updateNoisyPixelDetection(const double& rTimeStamp);									//called at the start of every readout, flags the noisy pixels of the last window every half window
+	void setModuleCoordinates(int& rColumn, int& rRow);										//converts the chip column/row of a hit to the module column/row of the chip set by setModuleChip
 	bool getHitsfromDataRecord(const unsigned int& pSRAMWORD, int& pColHit1, int& pRowHit1, int& pTotHit1, int& pColHit2, int& pRowHit2, int& pTotHit2); //returns true if the SRAMword is a data record with reasonable hit infos and if it is sets pCol,pRow,pTot
 	bool getInfoFromServiceRecord(const unsigned int& pSRAMWORD, unsigned int& pSRcode, unsigned int& pSRcount); //returns true if the SRAMword is a service record and sets pSRcode, pSRcount
 	bool isTriggerWord(const unsigned int& pSRAMWORD);										//returns true if data word is trigger word
@@ -161,6 +184,25 @@ private:
 	std::string _TriggerMode;					//indicates trigger format as string for nicer output
 	bool _useTriggerTimeStamp;					//set to true to use the trigger value as a clock count
 	unsigned int _maxTriggerNumber;				//maximum trigger trigger number
+	unsigned int _nModuleChips;					//number of chips of the module
+	unsigned int _moduleChip;					//position of the chip in the module
+	PixelMask _pixelMask;						//masked pixels, their hits are not stored
+	double _noiseWindow;						//noisy pixel detection window in seconds, 0 = off
+	double _noiseMaxSigma;						//noisy pixel rate limit in RMS of all pixels above the mean
+	double _noiseMaxRate;						//absolute noisy pixel rate limit in Hz, 0 = off
+	bool _noiseAutoMask;						//add noisy pixels to the pixel mask
+	bool _noiseWindowStarted;					//the first readout time stamp was seen
+	double _noiseWindowStart;					//start time stamp of the older half window
+	double _noiseHalfWindowStart;				//start time stamp of the actual half window
+	size_t _noiseCountsOffset;					//offset of the actual half window in _noiseCounts
+	std::vector<unsigned int> _noiseCounts;		//stored hits of each pixel in the older and the actual half window
+	std::vector<unsigned char> _noisyPixels;	//noisy pixel flags
+	unsigned int _nNoisyPixels;					//number of noisy pixels
+	bool _createTriggerIndex;					//true if the trigger index is filled
+	std::vector<TriggerIndexInfo> _triggerIndex;	//trigger key, event number and first hit index of the events
+	bool _triggerIndexSorted;					//false if a trigger key decreased (trigger number error), the index is sorted before the next access
+	int64_t _lastTriggerKey;					//trigger key of the last trigger index entry
+	unsigned int _lastIndexTriggerNumber;		//trigger number of the last trigger index entry
 
 	// one event variables
 	unsigned int tNdataWords;					//number of data words per event
@@ -199,6 +241,7 @@ private:
 	unsigned int _nOtherWords;					//Address or value records
 	unsigned int _nUnknownWords;				//number of unknowns words found
 	unsigned int _nHits;						//total number of hits found
+	uint64_t _nStoredHits;						//total number of hits stored in the hit arrays
 	unsigned int _nSmallHits;					//total number of small hits (ToT code 14)
 	unsigned int _nDataWords;					//total number of data words
 	bool _firstTriggerNrSet;					//true if the first trigger was found
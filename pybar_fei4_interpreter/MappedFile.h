@@ -0,0 +1,89 @@
+#pragma once
+//Read/write shared memory mapping of a whole file, e.g. in a local directory or /dev/shm to share histograms with other processes.
+//The mapping is shared, thus the content is kept in the file if the process dies.
+
+#include <string>
+#include <stdexcept>
+#include <algorithm>
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+class MappedFile
+{
+public:
+	MappedFile(void): _data(0), _size(0){}
+	~MappedFile(void){ unmap(); }
+
+	void* map(const std::string& rFileName, const size_t& rSize) //maps rSize bytes of the file, the file is created or resized if needed, throws if not possible
+	{
+		unmap();
+#ifdef _WIN32
+		HANDLE tFile = CreateFileA(rFileName.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, 0, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, 0);
+		if (tFile == INVALID_HANDLE_VALUE)
+			throw std::runtime_error("Cannot open histogram file " + rFileName + ".");
+		HANDLE tMapping = CreateFileMappingA(tFile, 0, PAGE_READWRITE, (DWORD) ((unsigned long long) rSize >> 32), (DWORD) (rSize & 0xFFFFFFFF), 0);  // extends the file if needed
+		CloseHandle(tFile);
+		if (tMapping == 0)
+			throw std::runtime_error("Cannot map histogram file " + rFileName + ".");
+		void* tData = MapViewOfFile(tMapping, FILE_MAP_ALL_ACCESS, 0, 0, rSize);
+		CloseHandle(tMapping);  // the view keeps the mapping
+		if (tData == 0)
+			throw std::runtime_error("Cannot map histogram file " + rFileName + ".");
+#else
+		int tFile = open(rFileName.c_str(), O_RDWR | O_CREAT, 0644);
+		if (tFile < 0)
+			throw std::runtime_error("Cannot open histogram file " + rFileName + ".");
+		struct stat tStat;
+		if (fstat(tFile, &tStat) != 0 || ((size_t) tStat.st_size != rSize && ftruncate(tFile, (off_t) rSize) != 0)){
+			close(tFile);
+			throw std::runtime_error("Cannot resize histogram file " + rFileName + ".");
+		}
+		void* tData = mmap(0, rSize, PROT_READ | PROT_WRITE, MAP_SHARED, tFile, 0);
+		close(tFile);  // the mapping keeps the file
+		if (tData == MAP_FAILED)
+			throw std::runtime_error("Cannot map histogram file " + rFileName + ".");
+#endif
+		_data = tData;
+		_size = rSize;
+		return _data;
+	}
+	void unmap()
+	{
+		if (_data == 0)
+			return;
+#ifdef _WIN32
+		UnmapViewOfFile(_data);
+#else
+		munmap(_data, _size);
+#endif
+		_data = 0;
+		_size = 0;
+	}
+	void swap(MappedFile& rOther)
+	{
+		std::swap(_data, rOther._data);
+		std::swap(_size, rOther._size);
+	}
+
+	void* data() const { return _data; }
+	bool mapped() const { return _data != 0; }
+
+private:
+	MappedFile(const MappedFile&); //not copyable
+	MappedFile& operator=(const MappedFile&);
+
+	void* _data;
+	size_t _size;
+};
@@ -0,0 +1,54 @@
+#pragma once
+//Mutex for the threads of the calling program, e.g. a Python thread that fills the histograms without the GIL while another one takes snapshots.
+//The OpenMP locks are not used, since these threads are not created by OpenMP.
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+class Mutex
+{
+public:
+#ifdef _WIN32
+	Mutex(void){ InitializeCriticalSection(&_mutex); }
+	~Mutex(void){ DeleteCriticalSection(&_mutex); }
+	void lock(){ EnterCriticalSection(&_mutex); }
+	void unlock(){ LeaveCriticalSection(&_mutex); }
+#else
+	Mutex(void){ pthread_mutex_init(&_mutex, 0); }
+	~Mutex(void){ pthread_mutex_destroy(&_mutex); }
+	void lock(){ pthread_mutex_lock(&_mutex); }
+	void unlock(){ pthread_mutex_unlock(&_mutex); }
+#endif
+
+private:
+	Mutex(const Mutex&); //not copyable
+	Mutex& operator=(const Mutex&);
+
+#ifdef _WIN32
+	CRITICAL_SECTION _mutex;
+#else
+	pthread_mutex_t _mutex;
+#endif
+};
+
+class MutexLock //locks the mutex for its lifetime, thus it is also unlocked if an exception is thrown
+{
+public:
+	MutexLock(Mutex& rMutex): _mutex(rMutex){ _mutex.lock(); }
+	~MutexLock(void){ _mutex.unlock(); }
+
+private:
+	MutexLock(const MutexLock&); //not copyable
+	MutexLock& operator=(const MutexLock&);
+
+	Mutex& _mutex;
+};
@@ -0,0 +1,96 @@
+#pragma once
+//Bitmap of masked pixels with one bit per pixel (3.4 kB for one chip, thus it stays in the cache) and the number of dropped hits of each pixel.
+//The pixel index is column - 1 + (row - 1) * number of columns, the columns and rows have to be range checked before.
+
+#include <vector>
+#include <algorithm>
+
+#include "defines.h"
+
+class PixelMask
+{
+public:
+	PixelMask(void): _nColumns(0), _nRows(0), _nMasked(0), _nDropped(0){}
+
+	void set(const unsigned char* rMask, const unsigned int& rNcolumns, const unsigned int& rNrows) //rMask: one entry per pixel sorted via col, row, != 0 masks the pixel; resets the dropped hit counters
+	{
+		_nColumns = rNcolumns;
+		_nRows = rNrows;
+		const size_t tNpixel = (size_t) rNcolumns * (size_t) rNrows;
+		_bits.assign((tNpixel + 31) / 32, 0);
+		_nMasked = 0;
+		for (size_t i = 0; i < tNpixel; ++i){
+			if (rMask[i] == 0)
+				continue;
+			_bits[i / 32] |= 1u << (i % 32);
+			_nMasked++;
+		}
+		_dropped.assign(tNpixel, 0);
+		_nDropped = 0;
+		if (_nMasked == 0)  // no bit test needed
+			clear();
+	}
+	void clear() //unmasks all pixels
+	{
+		_bits.clear();
+		_dropped.clear();
+		_nColumns = 0;
+		_nRows = 0;
+		_nMasked = 0;
+		_nDropped = 0;
+	}
+	void resetDropped() //sets the dropped hit counters to 0
+	{
+		std::fill(_dropped.begin(), _dropped.end(), 0);
+		_nDropped = 0;
+	}
+
+	void add(const size_t& rPixel, const unsigned int& rNcolumns, const unsigned int& rNrows) //masks one more pixel, an empty mask is set up for the geometry if needed
+	{
+		if (_nColumns != rNcolumns || _nRows != rNrows){
+			_nColumns = rNcolumns;
+			_nRows = rNrows;
+			_bits.assign(((size_t) rNcolumns * (size_t) rNrows + 31) / 32, 0);
+			_dropped.assign((size_t) rNcolumns * (size_t) rNrows, 0);
+			_nMasked = 0;
+			_nDropped = 0;
+		}
+		if (masked(rPixel))
+			return;
+		_bits[rPixel >> 5] |= 1u << (rPixel & 31);
+		_nMasked++;
+	}
+	bool masked(const size_t& rPixel) const { return _nMasked != 0 && (_bits[rPixel >> 5] & (1u << (rPixel & 31))) != 0; }
+
+	bool drop(const unsigned int& rColumn, const unsigned int& rRow) //returns true and counts the hit if the pixel is masked
+	{
+		const size_t tPixel = (size_t) (rColumn - 1) + (size_t) (rRow - 1) * (size_t) _nColumns;
+		if ((_bits[tPixel >> 5] & (1u << (tPixel & 31))) == 0)
+			return false;
+		_dropped[tPixel]++;
+		_nDropped++;
+		return true;
+	}
+
+	void getDropped(unsigned int* rDropped, const size_t& rNpixel) const //copies the dropped hits of each pixel, 0 if no pixel is masked
+	{
+		if (_dropped.size() == rNpixel)
+			std::copy(_dropped.begin(), _dropped.end(), rDropped);
+		else
+			std::fill(rDropped, rDropped + rNpixel, 0);
+	}
+
+	bool enabled() const { return _nMasked != 0; } //at least one pixel masked
+	unsigned int getNmasked() const { return _nMasked; }
+	uint64_t getNdropped() const { return _nDropped; }
+	unsigned int getNcolumns() const { return _nColumns; }
+	unsigned int getNrows() const { return _nRows; }
+
+private:
+	unsigned int _nColumns;				//geometry the mask was set for
+	unsigned int _nRows;
+	unsigned int _nMasked;				//number of masked pixels
+	uint64_t _nDropped;					//total number of dropped hits
+	std::vector<unsigned int> _bits;	//one bit per pixel, set for masked pixels
+	std::vector<unsigned int> _dropped;	//number of dropped hits of each pixel
+};
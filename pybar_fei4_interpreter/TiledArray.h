@@ -0,0 +1,219 @@
+#pragma once
+//Linear histogram array stored in tiles of __HIST_TILE_SIZE entries. In dense mode the tiles point into one
+//contiguous array, in sparse mode a tile is only allocated when it is written the first time.
+//Tiles are never shared, thus threads writing to different tiles do not need any synchronization.
+//Every write access with operator[] marks the tile dirty for all snapshot buffers, a snapshot only copies the tiles that are dirty for its buffer.
+//operator[] is the write access of sparse arrays, dense arrays are written via data() and the written tiles are marked by markDirty (or markAllDirty).
+//Threads that write to the same sparse tiles use UnmarkedTiles instead, the tiles are allocated and marked dirty before by one thread (markDirty).
+//A dense array can be stored in a memory-mapped file instead of the heap (allocateMapped). File layout (native byte order):
+//header of a multiple of __HIST_FILE_HEADER_SIZE bytes: uint32 __HIST_FILE_ID, uint32 __HIST_FILE_VERSION, uint32 entry size in bytes,
+//uint32 number of parameters (or bins), uint32 1 if the parameter is the fastest index else 0, uint32 header size in bytes, uint64 number of entries,
+//int32 value of each parameter (none for bins), zeros; followed by the entries.
+
+#include <vector>
+#include <algorithm>
+#include <new>
+#include <string>
+
+#include "defines.h"
+#include "MappedFile.h"
+
+template<class T> class TiledArray
+{
+public:
+	TiledArray(void): _size(0), _sparse(false), _dense(0){}
+	~TiledArray(void){ clear(); }
+
+	void allocate(const size_t& rSize, const bool& rSparse = false) //allocates rSize entries set to 0, rSize has to be a multiple of __HIST_TILE_SIZE
+	{
+		clear();
+		_sparse = rSparse;
+		_tiles.assign(rSize / __HIST_TILE_SIZE, (T*) 0);
+		_dirty.assign(_tiles.size(), allDirty());
+		if (!_sparse){
+			_dense = new T[rSize];
+			std::fill(_dense, _dense + rSize, 0);
+			for (size_t i = 0; i < _tiles.size(); ++i)
+				_tiles[i] = _dense + i * __HIST_TILE_SIZE;
+		}
+		_size = rSize;
+	}
+	bool allocateMapped(const size_t& rSize, const std::string& rFileName, const unsigned int& rNparameters, const bool& rParameterFastest, const std::vector<int>& rParameterValues, const bool& rResume = false) //allocates rSize entries in the file rFileName, returns true if the entries of the file are kept (rResume and same header, thus also the same parameter values), otherwise they are set to 0
+	{
+		clear();
+		std::vector<unsigned char> tHeader(((8 * sizeof(unsigned int) + rParameterValues.size() * sizeof(int) - 1) / __HIST_FILE_HEADER_SIZE + 1) * __HIST_FILE_HEADER_SIZE, 0);
+		unsigned int tWords[6] = {__HIST_FILE_ID, __HIST_FILE_VERSION, (unsigned int) sizeof(T), rNparameters, rParameterFastest ? 1u : 0u, (unsigned int) tHeader.size()};
+		uint64_t tNentries = (uint64_t) rSize;
+		std::copy((unsigned char*) tWords, (unsigned char*) (tWords + 6), tHeader.begin());
+		std::copy((unsigned char*) &tNentries, (unsigned char*) (&tNentries + 1), tHeader.begin() + sizeof(tWords));
+		if(!rParameterValues.empty())
+			std::copy((const unsigned char*) &rParameterValues[0], (const unsigned char*) (&rParameterValues[0] + rParameterValues.size()), tHeader.begin() + sizeof(tWords) + sizeof(tNentries));
+		unsigned char* tFile = (unsigned char*) _file.map(rFileName, tHeader.size() + rSize * sizeof(T));
+		bool tResumed = rResume && std::equal(tHeader.begin(), tHeader.end(), tFile);
+		if (!tResumed){
+			std::copy(tHeader.begin(), tHeader.end(), tFile);
+			std::fill(tFile + tHeader.size(), tFile + tHeader.size() + rSize * sizeof(T), 0);
+		}
+		_sparse = false;
+		_dense = (T*) (tFile + tHeader.size());
+		_tiles.resize(rSize / __HIST_TILE_SIZE);
+		for (size_t i = 0; i < _tiles.size(); ++i)
+			_tiles[i] = _dense + i * __HIST_TILE_SIZE;
+		_dirty.assign(_tiles.size(), allDirty());
+		_size = rSize;
+		return tResumed;
+	}
+	void detach() //moves the entries of a memory-mapped array to the heap, the file is not changed anymore
+	{
+		if (!_file.mapped())
+			return;
+		T* tDense = new T[_size];
+		std::copy(_dense, _dense + _size, tDense);
+		_file.unmap();
+		_dense = tDense;
+		for (size_t i = 0; i < _tiles.size(); ++i)
+			_tiles[i] = _dense + i * __HIST_TILE_SIZE;
+	}
+	void clear() //deletes all entries
+	{
+		if (_sparse){
+			for (size_t i = 0; i < _tiles.size(); ++i)
+				delete[] _tiles[i];
+		}
+		if (_file.mapped())
+			_file.unmap();
+		else
+			delete[] _dense;
+		_dense = 0;
+		_tiles.clear();
+		_dirty.clear();
+		_size = 0;
+	}
+	void reset() //sets all entries to 0, in sparse mode all tiles are deleted
+	{
+		if (_sparse){
+			for (size_t i = 0; i < _tiles.size(); ++i){
+				delete[] _tiles[i];
+				_tiles[i] = 0;
+			}
+		}
+		else
+			std::fill(_dense, _dense + _size, 0);
+		std::fill(_dirty.begin(), _dirty.end(), allDirty());
+	}
+
+	T& operator[](const size_t& rIndex) //write access, allocates the tile if needed and marks it dirty; per entry overhead, thus dense fill loops write via data()
+	{
+		T* tTile = _tiles[rIndex / __HIST_TILE_SIZE];
+		if (tTile == 0)
+			tTile = allocateTile(rIndex / __HIST_TILE_SIZE);
+		_dirty[rIndex / __HIST_TILE_SIZE] = allDirty();
+		return tTile[rIndex % __HIST_TILE_SIZE];
+	}
+	T get(const size_t& rIndex) const //read access, entries of not allocated tiles are 0
+	{
+		const T* tTile = _tiles[rIndex / __HIST_TILE_SIZE];
+		return tTile == 0 ? 0 : tTile[rIndex % __HIST_TILE_SIZE];
+	}
+	T* tile(const size_t& rTileIndex) const { return _tiles[rTileIndex]; } //returns 0 for a not allocated tile
+	const T* range(const size_t& rIndex, const size_t& rSize, T* rBuffer) const //returns the rSize entries from rIndex on as contiguous array, in dense mode without a copy, in sparse mode copied tile-wise into rBuffer
+	{
+		if (!_sparse)
+			return _dense + rIndex;
+		for (size_t i = 0; i < rSize;){
+			size_t tTile = (rIndex + i) / __HIST_TILE_SIZE;
+			size_t tOffset = (rIndex + i) % __HIST_TILE_SIZE;
+			size_t tNentries = std::min(rSize - i, (size_t) __HIST_TILE_SIZE - tOffset);
+			if (_tiles[tTile] != 0)
+				std::copy(_tiles[tTile] + tOffset, _tiles[tTile] + tOffset + tNentries, rBuffer + i);
+			else
+				std::fill(rBuffer + i, rBuffer + i + tNentries, 0);
+			i += tNentries;
+		}
+		return rBuffer;
+	}
+
+	void copyTo(T* rTarget) const //exports all entries to a dense array of size()
+	{
+		for (size_t i = 0; i < _tiles.size(); ++i){
+			if (_tiles[i] != 0)
+				std::copy(_tiles[i], _tiles[i] + __HIST_TILE_SIZE, rTarget + i * __HIST_TILE_SIZE);
+			else
+				std::fill(rTarget + i * __HIST_TILE_SIZE, rTarget + (i + 1) * __HIST_TILE_SIZE, 0);
+		}
+	}
+
+	void markDirty(const size_t& rIndex) //marks the tile of the entry dirty without changing it, allocates the tile if needed; before or after writes to data()
+	{
+		if (_tiles[rIndex / __HIST_TILE_SIZE] == 0)
+			allocateTile(rIndex / __HIST_TILE_SIZE);
+		_dirty[rIndex / __HIST_TILE_SIZE] = allDirty();
+	}
+	void markAllDirty() //after writes to data()
+	{
+		std::fill(_dirty.begin(), _dirty.end(), allDirty());
+	}
+	bool takeDirty(const size_t& rTileIndex, const unsigned int& rBuffer) //returns if the tile was written since the last call for the snapshot buffer rBuffer and clears its dirty bit
+	{
+		unsigned char tBit = (unsigned char) (1 << rBuffer);
+		if ((_dirty[rTileIndex] & tBit) == 0)
+			return false;
+		_dirty[rTileIndex] &= (unsigned char) ~tBit;
+		return true;
+	}
+
+	void swap(TiledArray& rOther) //exchanges the content, e.g. to keep the entries while the array is reallocated
+	{
+		std::swap(_size, rOther._size);
+		std::swap(_sparse, rOther._sparse);
+		std::swap(_dense, rOther._dense);
+		_tiles.swap(rOther._tiles);
+		_dirty.swap(rOther._dirty);
+		_file.swap(rOther._file);
+	}
+
+	T* data() const { return _dense; } //contiguous array, 0 in sparse mode
+	size_t size() const { return _size; }
+	size_t nTiles() const { return _tiles.size(); }
+	bool allocated() const { return _size != 0; }
+	bool sparse() const { return _sparse; }
+	bool mapped() const { return _file.mapped(); }
+	size_t getMemory() const //returns the allocated memory in bytes
+	{
+		size_t tNtiles = 0;
+		for (size_t i = 0; i < _tiles.size(); ++i)
+			if (_tiles[i] != 0)
+				tNtiles++;
+		return tNtiles * __HIST_TILE_SIZE * sizeof(T) + _tiles.size() * (sizeof(T*) + sizeof(unsigned char));
+	}
+
+private:
+	TiledArray(const TiledArray&); //not copyable
+	TiledArray& operator=(const TiledArray&);
+
+	static unsigned char allDirty() { return (unsigned char) ((1 << __N_SNAPSHOT_BUFFERS) - 1); }
+	T* allocateTile(const size_t& rTileIndex)
+	{
+		T* tTile = new T[__HIST_TILE_SIZE];
+		std::fill(tTile, tTile + __HIST_TILE_SIZE, 0);
+		_tiles[rTileIndex] = tTile;
+		return tTile;
+	}
+
+	size_t _size;				//number of entries
+	bool _sparse;				//tiles are allocated on first write
+	T* _dense;					//contiguous array in dense mode
+	std::vector<T*> _tiles;		//pointer to the tiles, 0 for not allocated tiles in sparse mode
+	std::vector<unsigned char> _dirty;	//one bit per snapshot buffer for each tile, set on write access
+	MappedFile _file;			//file of the entries if memory-mapped
+};
+
+template<class T> class UnmarkedTiles //write access to the entries of a TiledArray without marking the tiles dirty, for threads that share tiles; the tiles have to be allocated and marked dirty before (TiledArray::markDirty)
+{
+public:
+	UnmarkedTiles(TiledArray<T>& rArray): _array(rArray){}
+	T& operator[](const size_t& rIndex){ return _array.tile(rIndex / __HIST_TILE_SIZE)[rIndex % __HIST_TILE_SIZE]; }
+
+private:
+	TiledArray<T>& _array;
+};
@@ -2,6 +2,7 @@
 # cython: boundscheck=False
 # cython: wraparound=False
 
+import warnings
 import numpy as np
 cimport numpy as cnp
 from numpy cimport ndarray
@@ -15,44 +16,134 @@ from pybar_fei4_interpreter.data_struct import MetaTable, MetaTableV2
 
 cnp.import_array()  # if array is used it has to be imported, otherwise possible runtime error
 
+ctypedef fused hist_index_t:  # supported index types of the histogram functions
+    cnp.uint8_t
+    cnp.uint16_t
+    cnp.int32_t
+    cnp.int64_t
+
+ctypedef fused hist_bin_t:  # supported bin types of the histogram functions, float64 for weighted histograms
+    cnp.uint32_t
+    cnp.uint64_t
+    cnp.float64_t
+
+ctypedef fused group_value_t:  # supported value types of the group-by reductions
+    cnp.uint8_t
+    cnp.uint16_t
+    cnp.uint32_t
+    cnp.uint64_t
+    cnp.int32_t
+    cnp.int64_t
+    cnp.float32_t
+    cnp.float64_t
+
+ctypedef fused group_sum_t:  # result types of the group sums
+    cnp.int64_t
+    cnp.uint64_t
+    cnp.float64_t
+
+cdef extern from "defines.h":
+    const unsigned int __GROUP_SUM
+    const unsigned int __GROUP_MIN
+    const unsigned int __GROUP_MAX
+    const unsigned int __GROUP_FIRST
+    const unsigned int __GROUP_LAST
+    const unsigned int __JOIN_INNER
+    const unsigned int __JOIN_LEFT
+    const unsigned int __JOIN_PAIRWISE
+
+group_operations = {'sum': __GROUP_SUM, 'min': __GROUP_MIN, 'max': __GROUP_MAX, 'first': __GROUP_FIRST, 'last': __GROUP_LAST}  # count: get_n_cluster_in_events
+join_modes = {'inner': __JOIN_INNER, 'left': __JOIN_LEFT, 'pairwise': __JOIN_PAIRWISE}
+
 cdef extern from "AnalysisFunctions.h":
     cdef cppclass ClusterInfo:
         ClusterInfo()
-    unsigned int getNclusterInEvents(int64_t*& rEventNumber, const unsigned int& rSize, int64_t*& rResultEventNumber, unsigned int*& rResultCount)
-    unsigned int getEventsInBothArrays(int64_t*& rEventArrayOne, const unsigned int& rSizeArrayOne, int64_t*& rEventArrayTwo, const unsigned int& rSizeArrayTwo, int64_t*& rEventArrayIntersection)
-    unsigned int getMaxEventsInBothArrays(int64_t*& rEventArrayOne, const unsigned int& rSizeArrayOne, int64_t*& rEventArrayTwo, const unsigned int& rSizeArrayTwo, int64_t*& rEventArrayIntersection, const unsigned int& rSizeArrayResult) except +
-    void in1d_sorted(int64_t*& rEventArrayOne, const unsigned int& rSizeArrayOne, int64_t*& rEventArrayTwo, const unsigned int& rSizeArrayTwo, uint8_t*& rSelection)
-    void histogram_1d(int*& x, const unsigned int& rSize, const unsigned int& rNbinsX, uint32_t*& rResult) except +
-    void histogram_2d(int*& x, int*& y, const unsigned int& rSize, const unsigned int& rNbinsX, const unsigned int& rNbinsY, uint32_t*& rResult) except +
-    void histogram_3d(int*& x, int*& y, int*& z, const unsigned int& rSize, const unsigned int& rNbinsX, const unsigned int& rNbinsY, const unsigned int& rNbinsZ, uint32_t*& rResult) except +
-    void mapCluster(int64_t*& rEventArray, const unsigned int& rEventArraySize, ClusterInfo*& rClusterInfo, const unsigned int& rClusterInfoSize, ClusterInfo*& rMappedClusterInfo, const unsigned int& rMappedClusterInfoSize) except +
-
-def get_n_cluster_in_events(cnp.ndarray[cnp.int64_t, ndim=1] event_numbers, cnp.ndarray[cnp.int64_t, ndim=1] result_event_numbers, cnp.ndarray[cnp.uint32_t, ndim=1] result_cluster_count):
-    return getNclusterInEvents(<int64_t*&> event_numbers.data, <const unsigned int&> event_numbers.shape[0], <int64_t*&> result_event_numbers.data, <unsigned int*&> result_cluster_count.data)
-
-def get_events_in_both_arrays(cnp.ndarray[cnp.int64_t, ndim=1] array_one, cnp.ndarray[cnp.int64_t, ndim=1] array_two, cnp.ndarray[cnp.int64_t, ndim=1] array_result):
-    return getEventsInBothArrays(<int64_t*&> array_one.data, <const unsigned int&> array_one.shape[0], <int64_t*&> array_two.data, <const unsigned int&> array_two.shape[0], <int64_t*&> array_result.data)
-
-def get_max_events_in_both_arrays(cnp.ndarray[cnp.int64_t, ndim=1] array_one, cnp.ndarray[cnp.int64_t, ndim=1] array_two, cnp.ndarray[cnp.int64_t, ndim=1] array_result):
-    return getMaxEventsInBothArrays(<int64_t*&> array_one.data, <const unsigned int&> array_one.shape[0], <int64_t*&> array_two.data, <const unsigned int&> array_two.shape[0], <int64_t*&> array_result.data, <const unsigned int&> array_result.shape[0])
-
-def get_in1d_sorted(cnp.ndarray[cnp.int64_t, ndim=1] array_one, cnp.ndarray[cnp.int64_t, ndim=1] array_two, cnp.ndarray[cnp.uint8_t, ndim=1] array_result):
-    in1d_sorted(<int64_t*&> array_one.data, <const unsigned int&> array_one.shape[0], <int64_t*&> array_two.data, <const unsigned int&> array_two.shape[0], <uint8_t*&> array_result.data)
+    unsigned int getNclusterInEvents(int64_t*& rEventNumber, const unsigned int& rSize, int64_t*& rResultEventNumber, unsigned int*& rResultCount, const unsigned int& rNthreads)
+    unsigned int reduceGroups[TValue, TResult](const int64_t* rKeys, const TValue* rValues, const unsigned int& rSize, const unsigned int& rOperation, int64_t* rResultKeys, TResult* rResult, const unsigned int& rNthreads) except +
+    unsigned int getEventsInBothArrays(int64_t*& rEventArrayOne, const unsigned int& rSizeArrayOne, int64_t*& rEventArrayTwo, const unsigned int& rSizeArrayTwo, int64_t*& rEventArrayIntersection, const unsigned int& rNthreads)
+    unsigned int getMaxEventsInBothArrays(int64_t*& rEventArrayOne, const unsigned int& rSizeArrayOne, int64_t*& rEventArrayTwo, const unsigned int& rSizeArrayTwo, int64_t*& rEventArrayIntersection, const unsigned int& rSizeArrayResult, const unsigned int& rNthreads) except +
+    void in1d_sorted(int64_t*& rEventArrayOne, const unsigned int& rSizeArrayOne, int64_t*& rEventArrayTwo, const unsigned int& rSizeArrayTwo, uint8_t*& rSelection, const unsigned int& rNthreads)
+    void histogram_1d[TIndex, TBin](const TIndex* x, const unsigned int& rSize, const unsigned int& rNbinsX, TBin* rResult, const double* rWeights, const unsigned int& rNthreads) except +
+    void histogram_2d[TIndex, TBin](const TIndex* x, const TIndex* y, const unsigned int& rSize, const unsigned int& rNbinsX, const unsigned int& rNbinsY, TBin* rResult, const double* rWeights, const unsigned int& rNthreads) except +
+    void histogram_3d[TIndex, TBin](const TIndex* x, const TIndex* y, const TIndex* z, const unsigned int& rSize, const unsigned int& rNbinsX, const unsigned int& rNbinsY, const unsigned int& rNbinsZ, TBin* rResult, const double* rWeights, const unsigned int& rNthreads) except +
+    void correlationHistogram[TIndex, TBin](const int64_t* rKeysOne, const TIndex* rIndexOne, const unsigned int* rSliceOne, const unsigned int& rSizeOne, const int64_t* rKeysTwo, const TIndex* rIndexTwo, const unsigned int& rSizeTwo, const unsigned int& rNbinsOne, const unsigned int& rNbinsTwo, const unsigned int& rNslices, TBin* rResult, const unsigned int& rNthreads) except +
+    uint64_t joinSorted(const int64_t* rKeysOne, const unsigned int& rSizeOne, const int64_t* rKeysTwo, const unsigned int& rSizeTwo, const unsigned int& rMode, int64_t* rIndexOne, int64_t* rIndexTwo, const uint64_t& rResultSize, const unsigned int& rNthreads) except +
+    void gatherRecords(const char* rTable, const size_t& rRecordSize, const unsigned int& rTableSize, const int64_t* rIndex, const unsigned int& rSize, char* rResult, const unsigned int& rNthreads) except +
+    void mapCluster(int64_t*& rEventArray, const unsigned int& rEventArraySize, ClusterInfo*& rClusterInfo, const unsigned int& rClusterInfoSize, ClusterInfo*& rMappedClusterInfo, const unsigned int& rMappedClusterInfoSize, const unsigned int& rNthreads) except +
+
+def get_n_cluster_in_events(cnp.ndarray[cnp.int64_t, ndim=1] event_numbers, cnp.ndarray[cnp.int64_t, ndim=1] result_event_numbers, cnp.ndarray[cnp.uint32_t, ndim=1] result_cluster_count, n_threads=0):
+    return getNclusterInEvents(<int64_t*&> event_numbers.data, <const unsigned int&> event_numbers.shape[0], <int64_t*&> result_event_numbers.data, <unsigned int*&> result_cluster_count.data, <const unsigned int&> n_threads)
+
+def reduce_group_sums(cnp.ndarray[cnp.int64_t, ndim=1] keys, cnp.ndarray[group_value_t, ndim=1] values, cnp.ndarray[cnp.int64_t, ndim=1] result_keys, cnp.ndarray[group_sum_t, ndim=1] result, n_threads=0):
+    return reduceGroups(<const int64_t*> keys.data, <const group_value_t*> values.data, <const unsigned int&> keys.shape[0], __GROUP_SUM, <int64_t*> result_keys.data, <group_sum_t*> result.data, <const unsigned int&> n_threads)
+
+def reduce_group_values(cnp.ndarray[cnp.int64_t, ndim=1] keys, cnp.ndarray[group_value_t, ndim=1] values, const unsigned int& operation, cnp.ndarray[cnp.int64_t, ndim=1] result_keys, cnp.ndarray[group_value_t, ndim=1] result, n_threads=0):  # min, max, first, last: the result has the value type
+    return reduceGroups(<const int64_t*> keys.data, <const group_value_t*> values.data, <const unsigned int&> keys.shape[0], operation, <int64_t*> result_keys.data, <group_value_t*> result.data, <const unsigned int&> n_threads)
+
+def get_events_in_both_arrays(cnp.ndarray[cnp.int64_t, ndim=1] array_one, cnp.ndarray[cnp.int64_t, ndim=1] array_two, cnp.ndarray[cnp.int64_t, ndim=1] array_result, n_threads=0):  # n_threads = 0: OpenMP default
+    return getEventsInBothArrays(<int64_t*&> array_one.data, <const unsigned int&> array_one.shape[0], <int64_t*&> array_two.data, <const unsigned int&> array_two.shape[0], <int64_t*&> array_result.data, <const unsigned int&> n_threads)
+
+def get_max_events_in_both_arrays(cnp.ndarray[cnp.int64_t, ndim=1] array_one, cnp.ndarray[cnp.int64_t, ndim=1] array_two, cnp.ndarray[cnp.int64_t, ndim=1] array_result, n_threads=0):
+    return getMaxEventsInBothArrays(<int64_t*&> array_one.data, <const unsigned int&> array_one.shape[0], <int64_t*&> array_two.data, <const unsigned int&> array_two.shape[0], <int64_t*&> array_result.data, <const unsigned int&> array_result.shape[0], <const unsigned int&> n_threads)
+
+def get_in1d_sorted(cnp.ndarray[cnp.int64_t, ndim=1] array_one, cnp.ndarray[cnp.int64_t, ndim=1] array_two, cnp.ndarray[cnp.uint8_t, ndim=1] array_result, n_threads=0):
+    in1d_sorted(<int64_t*&> array_one.data, <const unsigned int&> array_one.shape[0], <int64_t*&> array_two.data, <const unsigned int&> array_two.shape[0], <uint8_t*&> array_result.data, <const unsigned int&> n_threads)
     return (array_result == 1)
 
-def hist_1d(cnp.ndarray[cnp.int32_t, ndim=1] x, const unsigned int& n_x, cnp.ndarray[cnp.uint32_t, ndim=1] array_result):
-    histogram_1d(<int*&> x.data, <const unsigned int&> x.shape[0], <const unsigned int&> n_x, <uint32_t*&> array_result.data) 
-
-def hist_2d(cnp.ndarray[cnp.int32_t, ndim=1] x, cnp.ndarray[cnp.int32_t, ndim=1] y, const unsigned int& n_x, const unsigned int& n_y, cnp.ndarray[cnp.uint32_t, ndim=1] array_result):
-    histogram_2d(<int*&> x.data, <int*&> y.data, <const unsigned int&> x.shape[0], <const unsigned int&> n_x, <const unsigned int&> n_y, <uint32_t*&> array_result.data)
-    
-def hist_3d(cnp.ndarray[cnp.int32_t, ndim=1] x, cnp.ndarray[cnp.int32_t, ndim=1] y, cnp.ndarray[cnp.int32_t, ndim=1] z, const unsigned int& n_x, const unsigned int& n_y, const unsigned int& n_z, cnp.ndarray[cnp.uint32_t, ndim=1] array_result, throw_exception = True):
-    histogram_3d(<int*&> x.data, <int*&> y.data, <int*&> z.data, <const unsigned int&> x.shape[0], <const unsigned int&> n_x, <const unsigned int&> n_y, <const unsigned int&> n_z, <uint32_t*&> array_result.data)
-    
-def map_cluster(cnp.ndarray[cnp.int64_t, ndim=1] event_array, cnp.ndarray[numpy_cluster_info, ndim=1] cluster_hit_info, cnp.ndarray[numpy_cluster_info, ndim=1] mapped_cluster_hit_info):    
-    mapCluster(<int64_t*&> event_array.data, <const unsigned int&> event_array.shape[0], <ClusterInfo *&> cluster_hit_info.data, <const unsigned int &> cluster_hit_info.shape[0], <ClusterInfo *&> mapped_cluster_hit_info.data, <const unsigned int &> mapped_cluster_hit_info.shape[0])
-    
-    
-    
-    
-    
\ No newline at end of file
+def hist_1d(cnp.ndarray[hist_index_t, ndim=1] x, const unsigned int& n_x, cnp.ndarray[hist_bin_t, ndim=1] array_result, cnp.ndarray[cnp.float64_t, ndim=1] weights=None, n_threads=0):  # weights: None = 1 per entry, n_threads = 0: OpenMP default
+    cdef const double* weights_data = NULL
+    if weights is not None:
+        if weights.shape[0] != x.shape[0]:
+            raise ValueError('The histogram needs one weight per entry')
+        weights_data = <const double*> weights.data
+    histogram_1d(<const hist_index_t*> x.data, <const unsigned int&> x.shape[0], <const unsigned int&> n_x, <hist_bin_t*> array_result.data, weights_data, <const unsigned int&> n_threads)
+
+def hist_2d(cnp.ndarray[hist_index_t, ndim=1] x, cnp.ndarray[hist_index_t, ndim=1] y, const unsigned int& n_x, const unsigned int& n_y, cnp.ndarray[hist_bin_t, ndim=1] array_result, cnp.ndarray[cnp.float64_t, ndim=1] weights=None, n_threads=0):
+    cdef const double* weights_data = NULL
+    if y.shape[0] != x.shape[0]:
+        raise ValueError('The histogram needs indices of the same length')
+    if weights is not None:
+        if weights.shape[0] != x.shape[0]:
+            raise ValueError('The histogram needs one weight per entry')
+        weights_data = <const double*> weights.data
+    histogram_2d(<const hist_index_t*> x.data, <const hist_index_t*> y.data, <const unsigned int&> x.shape[0], <const unsigned int&> n_x, <const unsigned int&> n_y, <hist_bin_t*> array_result.data, weights_data, <const unsigned int&> n_threads)
+
+def hist_3d(cnp.ndarray[hist_index_t, ndim=1] x, cnp.ndarray[hist_index_t, ndim=1] y, cnp.ndarray[hist_index_t, ndim=1] z, const unsigned int& n_x, const unsigned int& n_y, const unsigned int& n_z, cnp.ndarray[hist_bin_t, ndim=1] array_result, throw_exception=True, cnp.ndarray[cnp.float64_t, ndim=1] weights=None, n_threads=0):  # throw_exception is deprecated: indices out of range always raise
+    cdef const double* weights_data = NULL
+    if not throw_exception:
+        warnings.warn('hist_3d: throw_exception is deprecated and ignored, indices out of range always raise', DeprecationWarning)
+    if y.shape[0] != x.shape[0] or z.shape[0] != x.shape[0]:
+        raise ValueError('The histogram needs indices of the same length')
+    if weights is not None:
+        if weights.shape[0] != x.shape[0]:
+            raise ValueError('The histogram needs one weight per entry')
+        weights_data = <const double*> weights.data
+    histogram_3d(<const hist_index_t*> x.data, <const hist_index_t*> y.data, <const hist_index_t*> z.data, <const unsigned int&> x.shape[0], <const unsigned int&> n_x, <const unsigned int&> n_y, <const unsigned int&> n_z, <hist_bin_t*> array_result.data, weights_data, <const unsigned int&> n_threads)
+
+def hist_correlation(cnp.ndarray[cnp.int64_t, ndim=1] keys_one, cnp.ndarray[hist_index_t, ndim=1] index_one, cnp.ndarray[cnp.int64_t, ndim=1] keys_two, cnp.ndarray[hist_index_t, ndim=1] index_two, const unsigned int& n_one, const unsigned int& n_two, cnp.ndarray[hist_bin_t, ndim=1] array_result, cnp.ndarray[cnp.uint32_t, ndim=1] slice_one=None, const unsigned int& n_slices=1, n_threads=0):  # slice_one: None = one slice
+    cdef const unsigned int* slice_one_data = NULL
+    if slice_one is not None:
+        slice_one_data = <const unsigned int*> slice_one.data
+    correlationHistogram(<const int64_t*> keys_one.data, <const hist_index_t*> index_one.data, slice_one_data, <const unsigned int&> keys_one.shape[0], <const int64_t*> keys_two.data, <const hist_index_t*> index_two.data, <const unsigned int&> keys_two.shape[0], n_one, n_two, n_slices, <hist_bin_t*> array_result.data, <const unsigned int&> n_threads)
+
+def map_cluster(cnp.ndarray[cnp.int64_t, ndim=1] event_array, cnp.ndarray[numpy_cluster_info, ndim=1] cluster_hit_info, cnp.ndarray[numpy_cluster_info, ndim=1] mapped_cluster_hit_info, n_threads=0):
+    mapCluster(<int64_t*&> event_array.data, <const unsigned int&> event_array.shape[0], <ClusterInfo *&> cluster_hit_info.data, <const unsigned int &> cluster_hit_info.shape[0], <ClusterInfo *&> mapped_cluster_hit_info.data, <const unsigned int &> mapped_cluster_hit_info.shape[0], <const unsigned int&> n_threads)
+
+def join_sorted(cnp.ndarray[cnp.int64_t, ndim=1] keys_one, cnp.ndarray[cnp.int64_t, ndim=1] keys_two, const unsigned int& mode, cnp.ndarray[cnp.int64_t, ndim=1] index_one=None, cnp.ndarray[cnp.int64_t, ndim=1] index_two=None, n_threads=0):  # index arrays None: only counts the pairs
+    cdef int64_t* index_one_data = NULL
+    cdef int64_t* index_two_data = NULL
+    cdef uint64_t result_size = 0
+    if index_one is not None and index_two is not None:
+        index_one_data = <int64_t*> index_one.data
+        index_two_data = <int64_t*> index_two.data
+        result_size = min(index_one.shape[0], index_two.shape[0])
+    return joinSorted(<const int64_t*> keys_one.data, <const unsigned int&> keys_one.shape[0], <const int64_t*> keys_two.data, <const unsigned int&> keys_two.shape[0], mode, index_one_data, index_two_data, result_size, <const unsigned int&> n_threads)
+
+def gather_records(ndarray table, cnp.ndarray[cnp.int64_t, ndim=1] index, ndarray result, n_threads=0):  # contiguous record arrays of the same type, index -1 gives a record set to 0
+    if table.dtype != result.dtype:
+        raise ValueError('Table and result have to be of the same type')
+    if not table.flags.c_contiguous or not result.flags.c_contiguous:
+        raise ValueError('Table and result have to be C-contiguous arrays')
+    if result.shape[0] < index.shape[0]:
+        raise IndexError('The result array is smaller than the index array')
+    gatherRecords(<const char*> table.data, <const size_t&> table.dtype.itemsize, <const unsigned int&> table.shape[0], <const int64_t*> index.data, <const unsigned int&> index.shape[0], <char*> result.data, <const unsigned int&> n_threads)
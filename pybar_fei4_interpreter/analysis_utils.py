@@ -9,18 +9,19 @@ from pybar_fei4_interpreter import analysis_functions
 from pybar_fei4_interpreter import data_struct
 
 
-def in1d_events(ar1, ar2):
+def in1d_events(ar1, ar2, n_threads=0):
     """
     Does the same than np.in1d but uses the fact that ar1 and ar2 are sorted and the c++ library. Is therefore much much faster.
+    Large arrays are processed with n_threads threads (0: OpenMP default), the result does not depend on it.
 
     """
     ar1 = np.ascontiguousarray(ar1)  # change memory alignement for c++ library
     ar2 = np.ascontiguousarray(ar2)  # change memory alignement for c++ library
     tmp = np.empty_like(ar1, dtype=np.uint8)  # temporary result array filled by c++ library, bool type is not supported with cython/numpy
-    return analysis_functions.get_in1d_sorted(ar1, ar2, tmp)
+    return analysis_functions.get_in1d_sorted(ar1, ar2, tmp, n_threads)
 
 
-def get_max_events_in_both_arrays(events_one, events_two):
+def get_max_events_in_both_arrays(events_one, events_two, n_threads=0):
     """
     Calculates the maximum count of events that exist in both arrays.
 
@@ -28,24 +29,24 @@ def get_max_events_in_both_arrays(events_one, events_two):
     events_one = np.ascontiguousarray(events_one)  # change memory alignement for c++ library
     events_two = np.ascontiguousarray(events_two)  # change memory alignement for c++ library
     event_result = np.empty(shape=(events_one.shape[0] + events_two.shape[0], ), dtype=events_one.dtype)
-    count = analysis_functions.get_max_events_in_both_arrays(events_one, events_two, event_result)
+    count = analysis_functions.get_max_events_in_both_arrays(events_one, events_two, event_result, n_threads)
     return event_result[:count]
 
 
-def map_cluster(events, cluster):
+def map_cluster(events, cluster, n_threads=0):
     """
-    Maps the cluster hits on events. Not existing hits in events have all values set to 0
+    Maps the cluster hits on events: the n-th cluster of an event is set at the n-th entry of this event in events (pairwise join, see join_sorted). Not existing hits in events have all values set to 0
 
     """
     cluster = np.ascontiguousarray(cluster)
     events = np.ascontiguousarray(events)
     mapped_cluster = np.zeros((events.shape[0], ), dtype=dtype_from_descr(data_struct.ClusterInfoTable))
     mapped_cluster = np.ascontiguousarray(mapped_cluster)
-    analysis_functions.map_cluster(events, cluster, mapped_cluster)
+    analysis_functions.map_cluster(events, cluster, mapped_cluster, n_threads)
     return mapped_cluster
 
 
-def get_events_in_both_arrays(events_one, events_two):
+def get_events_in_both_arrays(events_one, events_two, n_threads=0):
     """
     Calculates the events that exist in both arrays.
 
@@ -53,11 +54,81 @@ def get_events_in_both_arrays(events_one, events_two):
     events_one = np.ascontiguousarray(events_one)  # change memory alignement for c++ library
     events_two = np.ascontiguousarray(events_two)  # change memory alignement for c++ library
     event_result = np.empty_like(events_one)
-    count = analysis_functions.get_events_in_both_arrays(events_one, events_two, event_result)
+    count = analysis_functions.get_events_in_both_arrays(events_one, events_two, event_result, n_threads)
     return event_result[:count]
 
 
-def hist_1d_index(x, shape):
+def join_sorted(table_one, table_two, how='inner', key='event_number', gather=False, n_threads=0):
+    """
+    Joins two tables sorted by key with the C++ library, e.g. the hit and cluster tables of a telescope plane by their event number.
+    The tables are record arrays of any type with the key column or key arrays. Galloping search skips the keys without match, thus small tables are joined fast to large ones.
+
+    Parameters
+    ----------
+    table_one, table_two : numpy.array
+        record arrays with a key column or int64 key arrays, sorted by key
+    how : string
+        inner: all pairs of entries with equal keys (one-to-many if the keys of table_one are unique, e.g. an event table)
+        left: inner join and every entry of table_one without match
+        pairwise: every entry of table_one paired with the entry of the same position within its key in table_two (as map_cluster)
+    key : string
+        name of the key column of record arrays
+    gather : bool
+        return the joined records instead of the indices, the records of table_two without match are set to 0
+    n_threads : int
+        number of threads for large tables, 0: OpenMP default
+
+    Returns
+    -------
+    tuple of numpy.array
+        The indices of the pairs in table_one and table_two (-1: no match), or the records of the pairs if gather is set.
+    """
+    if how not in analysis_functions.join_modes:
+        raise ValueError('Unknown join %s' % how)
+    keys_one = np.ascontiguousarray(table_one[key] if table_one.dtype.names else table_one, dtype=np.int64)  # change memory alignement for c++ library
+    keys_two = np.ascontiguousarray(table_two[key] if table_two.dtype.names else table_two, dtype=np.int64)
+    n_pairs = analysis_functions.join_sorted(keys_one, keys_two, analysis_functions.join_modes[how], None, None, n_threads)
+    index_one, index_two = np.empty(n_pairs, dtype=np.int64), np.empty(n_pairs, dtype=np.int64)
+    analysis_functions.join_sorted(keys_one, keys_two, analysis_functions.join_modes[how], index_one, index_two, n_threads)
+    if not gather:
+        return index_one, index_two
+    table_one, table_two = np.ascontiguousarray(table_one), np.ascontiguousarray(table_two)
+    records_one, records_two = np.empty(n_pairs, dtype=table_one.dtype), np.empty(n_pairs, dtype=table_two.dtype)
+    analysis_functions.gather_records(table_one, index_one, records_one, n_threads)
+    analysis_functions.gather_records(table_two, index_two, records_two, n_threads)
+    return records_one, records_two
+
+
+def _hist_index_arrays(*indices):
+    """
+    Returns the index arrays contiguous with one index type supported by the C++ histogram functions (uint8, uint16, int32, int64), thus supported types are not copied.
+
+    """
+    dtype = np.result_type(*indices)
+    if dtype not in (np.uint8, np.uint16, np.int32, np.int64):
+        dtype = np.int32 if dtype.itemsize < 4 else np.int64
+    return [np.ascontiguousarray(index, dtype=dtype) for index in indices]
+
+
+def _hist_result(shape, weights, dtype, indices):
+    """
+    Returns the zeroed linear histogram and the contiguous weights, weighted histograms have float64 bins.
+    The index arrays and the weights have to have the same length, the C++ loops do not check it.
+
+    """
+    if any(index.shape[0] != indices[0].shape[0] for index in indices):
+        raise ValueError('The histogram needs indices of the same length')
+    if weights is not None:
+        weights = np.ascontiguousarray(weights, dtype=np.float64)
+        if weights.shape[0] != indices[0].shape[0]:
+            raise ValueError('The histogram needs one weight per entry')
+        return np.zeros(shape=np.prod(shape), dtype=np.float64), weights
+    if np.dtype(dtype) not in (np.uint32, np.uint64):
+        raise ValueError('The histogram bins have to be uint32 or uint64')
+    return np.zeros(shape=np.prod(shape), dtype=dtype), None
+
+
+def hist_1d_index(x, shape, weights=None, dtype=np.uint32, n_threads=0):
     """
     Fast 1d histogram of 1D indices with C++ inner loop optimization.
     Is more than 2 orders faster than np.histogram().
@@ -67,6 +138,12 @@ def hist_1d_index(x, shape):
     x : array like
     shape : tuple
         tuple with x dimensions: (x,)
+    weights : array like
+        weight of each entry, the histogram has float64 bins then. Default: every entry counts 1.
+    dtype : numpy.dtype
+        uint32 (throws on overflow) or uint64 bins of the unweighted histogram
+    n_threads : int
+        number of threads for large arrays, 0: OpenMP default
 
     Returns
     -------
@@ -76,14 +153,13 @@ def hist_1d_index(x, shape):
     if len(shape) != 1:
         raise InvalidInputError('The shape has to describe a 1-d histogram')
 
-    # change memory alignment for c++ library
-    x = np.ascontiguousarray(x.astype(np.int32))
-    result = np.zeros(shape=shape, dtype=np.uint32)
-    analysis_functions.hist_1d(x, shape[0], result)
+    x, = _hist_index_arrays(x)  # change memory alignment for c++ library
+    result, weights = _hist_result(shape, weights, dtype, (x,))
+    analysis_functions.hist_1d(x, shape[0], result, weights, n_threads)
     return result
 
 
-def hist_2d_index(x, y, shape):
+def hist_2d_index(x, y, shape, weights=None, dtype=np.uint32, n_threads=0):
     """
     Fast 2d histogram of 2D indices with C++ inner loop optimization.
     Is more than 2 orders faster than np.histogram2d().
@@ -94,6 +170,8 @@ def hist_2d_index(x, y, shape):
     y : array like
     shape : tuple
         tuple with x,y dimensions: (x, y)
+    weights, dtype, n_threads :
+        see hist_1d_index
 
     Returns
     -------
@@ -103,15 +181,13 @@ def hist_2d_index(x, y, shape):
     if len(shape) != 2:
         raise InvalidInputError('The shape has to describe a 2-d histogram')
 
-    # change memory alignment for c++ library
-    x = np.ascontiguousarray(x.astype(np.int32))
-    y = np.ascontiguousarray(y.astype(np.int32))
-    result = np.zeros(shape=shape, dtype=np.uint32).ravel()  # ravel hist in c-style, 3D --> 1D
-    analysis_functions.hist_2d(x, y, shape[0], shape[1], result)
+    x, y = _hist_index_arrays(x, y)  # change memory alignment for c++ library
+    result, weights = _hist_result(shape, weights, dtype, (x, y))  # ravel hist in c-style, 3D --> 1D
+    analysis_functions.hist_2d(x, y, shape[0], shape[1], result, weights, n_threads)
     return np.reshape(result, shape)  # rebuilt 3D hist from 1D hist
 
 
-def hist_3d_index(x, y, z, shape):
+def hist_3d_index(x, y, z, shape, weights=None, dtype=np.uint32, n_threads=0):
     """
     Fast 3d histogram of 3D indices with C++ inner loop optimization.
     Is more than 2 orders faster than np.histogramdd().
@@ -123,6 +199,8 @@ def hist_3d_index(x, y, z, shape):
     z : array like
     shape : tuple
         tuple with x,y,z dimensions: (x, y, z)
+    weights, dtype, n_threads :
+        see hist_1d_index
 
     Returns
     -------
@@ -131,16 +209,67 @@ def hist_3d_index(x, y, z, shape):
     """
     if len(shape) != 3:
         raise InvalidInputError('The shape has to describe a 3-d histogram')
-    # change memory alignment for c++ library
-    x = np.ascontiguousarray(x.astype(np.int32))
-    y = np.ascontiguousarray(y.astype(np.int32))
-    z = np.ascontiguousarray(z.astype(np.int32))
-    result = np.zeros(shape=shape, dtype=np.uint32).ravel()  # ravel hist in c-style, 3D --> 1D
-    analysis_functions.hist_3d(x, y, z, shape[0], shape[1], shape[2], result)
+    x, y, z = _hist_index_arrays(x, y, z)  # change memory alignment for c++ library
+    result, weights = _hist_result(shape, weights, dtype, (x, y, z))  # ravel hist in c-style, 3D --> 1D
+    analysis_functions.hist_3d(x, y, z, shape[0], shape[1], shape[2], result, weights=weights, n_threads=n_threads)
     return np.reshape(result, shape)  # rebuilt 3D hist from 1D hist
 
 
-def get_n_cluster_in_events(event_numbers):
+def hist_correlation(keys_one, index_one, keys_two, index_two, shape, slice_one=None, dtype=np.uint32, n_threads=0):
+    """
+    Fast correlation histogram of two tables sorted by key with the C++ library, e.g. the column (or row) correlation of the hits of two telescope planes with the event number as key.
+    Every pair of entries with the same key is added to the bin (index_one, index_two) without creating the pairs, thus without the temporary arrays of a join.
+
+    Parameters
+    ----------
+    keys_one, keys_two : array like
+        sorted keys, e.g. the event numbers
+    index_one, index_two : array like
+        histogram index of each entry starting from 0, e.g. column - 1
+    shape : tuple
+        (n_one, n_two) or (n_slices, n_one, n_two) with slice_one
+    slice_one : array like
+        slice of each entry of table one, e.g. a time slice from the read out of the event. Default: one slice
+    dtype : numpy.dtype
+        uint32 (throws on overflow) or uint64 bins
+    n_threads : int
+        number of threads for large tables, 0: OpenMP default
+
+    Returns
+    -------
+    np.ndarray with given shape
+
+    """
+    if len(shape) != (2 if slice_one is None else 3):
+        raise ValueError('The shape has to describe a 2-d correlation histogram or a 3-d one with slices')
+    keys_one = np.ascontiguousarray(keys_one, dtype=np.int64)  # change memory alignment for c++ library
+    keys_two = np.ascontiguousarray(keys_two, dtype=np.int64)
+    index_one, index_two = _hist_index_arrays(index_one, index_two)
+    if slice_one is not None:
+        slice_one = np.ascontiguousarray(slice_one, dtype=np.uint32)
+    if keys_one.shape != index_one.shape or keys_two.shape != index_two.shape or (slice_one is not None and slice_one.shape != keys_one.shape):
+        raise ValueError('The correlation needs one index (and slice) per key')
+    result, _ = _hist_result(shape, None, dtype, (index_one,))
+    analysis_functions.hist_correlation(keys_one, index_one, keys_two, index_two, shape[-2], shape[-1], result, slice_one, 1 if slice_one is None else shape[0], n_threads)
+    return np.reshape(result, shape)
+
+
+def get_hit_correlations(hits_one, hits_two, n_columns=(80, 80), n_rows=(336, 336), slice_one=None, n_slices=1, dtype=np.uint32, n_threads=0):
+    """
+    Column and row correlation histograms of two hit arrays sorted by event number (e.g. DUT and telescope plane), see hist_correlation.
+
+    Returns
+    -------
+    tuple of np.ndarray
+        The column correlation with the shape n_columns and the row correlation with the shape n_rows, with n_slices as first dimension if slice_one is given.
+    """
+    slices = () if slice_one is None else (n_slices, )
+    column_correlation = hist_correlation(hits_one['event_number'], hits_one['column'].astype(np.int32) - 1, hits_two['event_number'], hits_two['column'].astype(np.int32) - 1, slices + tuple(n_columns), slice_one, dtype, n_threads)
+    row_correlation = hist_correlation(hits_one['event_number'], hits_one['row'].astype(np.int32) - 1, hits_two['event_number'], hits_two['row'].astype(np.int32) - 1, slices + tuple(n_rows), slice_one, dtype, n_threads)
+    return column_correlation, row_correlation
+
+
+def get_n_cluster_in_events(event_numbers, n_threads=0):
     '''Calculates the number of cluster in every given event.
     An external C++ library is used since there is no sufficient solution in python possible.
     Because of np.bincount # BUG #225 for values > int32 and the different handling under 32/64 bit operating systems.
@@ -149,6 +278,8 @@ def get_n_cluster_in_events(event_numbers):
     ----------
     event_numbers : numpy.array
         List of event numbers to be checked.
+    n_threads : int
+        number of threads for large arrays, 0: OpenMP default
 
     Returns
     -------
@@ -160,5 +291,145 @@ def get_n_cluster_in_events(event_numbers):
     event_numbers = np.ascontiguousarray(event_numbers)  # change memory alignement for c++ library
     result_event_numbers = np.empty_like(event_numbers)
     result_count = np.empty_like(event_numbers, dtype=np.uint32)
-    result_size = analysis_functions.get_n_cluster_in_events(event_numbers, result_event_numbers, result_count)
+    result_size = analysis_functions.get_n_cluster_in_events(event_numbers, result_event_numbers, result_count, n_threads)
     return np.vstack((result_event_numbers[:result_size], result_count[:result_size])).T
+
+
+def reduce_groups(keys, values=None, operation='count', n_threads=0):
+    '''Group-by reduction of a value column over the groups of equal consecutive keys with the C++ library.
+    With the sorted event number column as keys this gives e.g. the hit multiplicity (count), the summed ToT (sum of tot) or the maximum cluster size (max of size) of every event.
+
+    Parameters
+    ----------
+    keys : numpy.array
+        int64 key of every entry, usually the sorted event number column.
+    values : numpy.array
+        value of every entry, not needed for count.
+    operation : string
+        count, sum, min, max, first or last
+    n_threads : int
+        number of threads for large arrays, 0: OpenMP default
+
+    Returns
+    -------
+    tuple of numpy.array
+        The key of every group and the result of every group. Counts are uint32, sums are int64 (uint64 for unsigned, float64 for float values), the other results have the value type.
+    '''
+    keys = np.ascontiguousarray(keys, dtype=np.int64)  # change memory alignement for c++ library
+    result_keys = np.empty_like(keys)
+    if operation == 'count':
+        result = np.empty_like(keys, dtype=np.uint32)
+        result_size = analysis_functions.get_n_cluster_in_events(keys, result_keys, result, n_threads)
+        return result_keys[:result_size], result[:result_size]
+    if operation not in analysis_functions.group_operations:
+        raise ValueError('Unknown group operation %s' % operation)
+    if values is None or len(values) != len(keys):
+        raise ValueError('The group reduction needs one value per key')
+    values = np.ascontiguousarray(values)
+    if values.dtype not in (np.uint8, np.uint16, np.uint32, np.uint64, np.int32, np.int64, np.float32, np.float64):
+        values = values.astype(np.float64 if values.dtype.kind == 'f' else np.int64)
+    if operation == 'sum':
+        result = np.empty_like(keys, dtype=np.float64 if values.dtype.kind == 'f' else (np.uint64 if values.dtype.kind == 'u' else np.int64))
+        result_size = analysis_functions.reduce_group_sums(keys, values, result_keys, result, n_threads)
+    else:
+        result = np.empty_like(keys, dtype=values.dtype)
+        result_size = analysis_functions.reduce_group_values(keys, values, analysis_functions.group_operations[operation], result_keys, result, n_threads)
+    return result_keys[:result_size], result[:result_size]
+
+
+class ChunkedGroupReduction(object):
+    '''Chunk-streaming reduce_groups for keys that are read in chunks, e.g. the event numbers of a hit table read from disk.
+    The last group of a chunk can continue in the next chunk, thus its key and partial result are carried to the next call and only the completed groups are returned.
+    The number of cluster in every event (get_n_cluster_in_events) is the count reduction.
+
+    Example
+    -------
+    reduction = ChunkedGroupReduction('sum')
+    for hits in chunks:
+        event_numbers, tot_sums = reduction.add(hits['event_number'], hits['tot'])
+    event_numbers, tot_sums = reduction.finish()  # the last group
+    '''
+    _combine = {'count': np.add, 'sum': np.add, 'min': np.minimum, 'max': np.maximum, 'first': lambda carried, new: carried, 'last': lambda carried, new: new}
+
+    def __init__(self, operation='count', n_threads=0):
+        if operation not in self._combine:
+            raise ValueError('Unknown group operation %s' % operation)
+        self._operation = operation
+        self._n_threads = n_threads
+        self._carry = None  # key and partial result of the open group
+
+    def add(self, keys, values=None):
+        '''Reduces the next chunk, returns the keys and results of the groups completed by it.'''
+        result_keys, result = reduce_groups(keys, values, self._operation, self._n_threads)
+        if result_keys.shape[0] == 0:
+            return result_keys, result
+        if self._carry is not None:
+            if self._carry[0][0] == result_keys[0]:  # the open group continues
+                result[:1] = self._combine[self._operation](self._carry[1], result[:1])
+            else:
+                result_keys, result = np.concatenate((self._carry[0], result_keys)), np.concatenate((self._carry[1].astype(result.dtype), result))
+        self._carry = result_keys[-1:].copy(), result[-1:].copy()
+        return result_keys[:-1], result[:-1]
+
+    def finish(self):
+        '''Returns the key and result of the last group and resets the carry state.'''
+        if self._carry is None:
+            return np.empty(0, dtype=np.int64), np.empty(0, dtype=np.uint32 if self._operation == 'count' else np.int64)
+        carry, self._carry = self._carry, None
+        return carry
+
+
+class ChunkedSortedJoin(object):
+    '''Chunk-streaming version of a function of two arrays sorted by event number, e.g. get_events_in_both_arrays, in1d_events, map_cluster, join_sorted or get_hit_correlations (the histograms of the calls add up).
+    The chunks of both arrays are buffered until they are complete: only the events below the last event number of both buffers are passed to the function, the other entries are carried to the next call.
+    Thus events straddling chunk borders are neither split nor counted twice. The buffers only stay at about the chunk size if both arrays are read at about the same event number,
+    an array that ends earlier has to be marked with last_one / last_two, otherwise the other array is buffered completely.
+    Functions returning the indices of the entries of both arrays (join_sorted) need indices=True, then the indices (not -1) are shifted by the entries passed to the function before.
+
+    Example
+    -------
+    join = ChunkedSortedJoin(map_cluster)
+    for events, cluster in chunks:
+        mapped_cluster = join.add(events, cluster)
+    mapped_cluster = join.finish()  # the remaining events
+    '''
+    def __init__(self, function, key='event_number', indices=False):
+        self._function = function
+        self._key = key
+        self._indices = indices
+        self._buffers = [None, None]
+        self._last = [False, False]  # no more chunks of the array
+        self._offsets = [0, 0]  # entries passed to the function
+
+    def _keys(self, array):
+        return array[self._key] if array.dtype.names else array
+
+    def add(self, chunk_one=None, chunk_two=None, last_one=False, last_two=False):
+        '''Adds the next chunks of one or both arrays, returns the function result of the events that are complete in both arrays (None until both arrays have a chunk).
+        last_one / last_two: the chunk is the last one of the array (or the array ended before), thus all its events are complete and only the other array bounds the events passed to the function.'''
+        for index, chunk in enumerate((chunk_one, chunk_two)):
+            if chunk is not None:
+                self._buffers[index] = chunk if self._buffers[index] is None else np.concatenate((self._buffers[index], chunk))
+        self._last = [self._last[0] or last_one, self._last[1] or last_two]
+        if any(buffer is None for buffer in self._buffers):
+            return None
+        open_keys = [self._keys(buffer) for buffer, last in zip(self._buffers, self._last) if not last]
+        if not open_keys:  # both arrays are complete
+            splits = [buffer.shape[0] for buffer in self._buffers]
+        elif any(keys.shape[0] == 0 for keys in open_keys):
+            splits = [0, 0]
+        else:
+            bound = min(keys[-1] for keys in open_keys)  # events below are complete in both arrays
+            splits = [np.searchsorted(self._keys(buffer), bound, side='left') for buffer in self._buffers]
+        result = self._function(self._buffers[0][:splits[0]], self._buffers[1][:splits[1]])
+        if self._indices:
+            result = tuple(np.where(index != -1, index + offset, index) for index, offset in zip(result, self._offsets))
+        self._offsets = [offset + split for offset, split in zip(self._offsets, splits)]
+        self._buffers = [buffer[split:].copy() for buffer, split in zip(self._buffers, splits)]
+        return result
+
+    def finish(self):
+        '''Returns the function result of the remaining entries of both arrays and resets the state, to be called after the last chunks.'''
+        result = self.add(last_one=True, last_two=True)
+        self._buffers, self._last, self._offsets = [None, None], [False, False], [0, 0]
+        return result
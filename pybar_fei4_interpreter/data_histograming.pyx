@@ -6,9 +6,14 @@ cimport numpy as cnp
 from libcpp cimport bool as cpp_bool  # to be able to use bool variables, as cpp_bool according to http://code.google.com/p/cefpython/source/browse/cefpython/cefpython.pyx?spec=svne037c69837fa39ae220806c2faa1bbb6ae4500b9&r=e037c69837fa39ae220806c2faa1bbb6ae4500b9
 from data_struct cimport numpy_hit_info, numpy_meta_data, numpy_meta_data_v2, numpy_par_info, numpy_cluster_info
 from libc.stdint cimport uint64_t
+from libcpp.vector cimport vector
+from libcpp.string cimport string
 
 cnp.import_array()  # if array is used it has to be imported, otherwise possible runtime error
 
+cdef extern from "defines.h":
+    const unsigned int __N_ERROR_CODES
+
 cdef extern from "Basis.h":
     cdef cppclass Basis:
         Basis()
@@ -30,33 +35,96 @@ cdef extern from "Histogram.h":
         void createOccupancyHist(cpp_bool CreateOccHist)
         void createRelBCIDHist(cpp_bool CreateRelBCIDHist)
         void createMeanTotHist(cpp_bool CreateMeanTotHist)
+        cpp_bool isMeanTotHist()
         void createTotHist(cpp_bool CreateTotHist)
         void createTdcHist(cpp_bool CreateTdcHist)
         void createTdcTriggerDistanceHist(cpp_bool CreateTdcTriggerDistanceHist)
-        void createTdcPixelHist(cpp_bool CreateTdcPixelHist)
+        void createTdcPixelHist(cpp_bool CreateTdcPixelHist) except +
         void createTotPixelHist(cpp_bool CreateTotPixelHist)
+        void createTdcPixelMoments(cpp_bool CreateTdcPixelMoments)
+        void createDecayingOccupancyHist(cpp_bool CreateDecayingOccupancyHist)
+        void setOccupancyHalfLife(const double& rHalfLife) except +
+        double getOccupancyHalfLife()
+        void createTimeHist(cpp_bool CreateTimeHist)
+        void setTimeHistBinning(const double& rBinWidth, const unsigned int& rNbins, const unsigned int& rNcolumnRegions, const unsigned int& rNrowRegions) except +
+        void setTdcPixelHistBinWidth(const unsigned int& rBinWidth) except +
+        unsigned int getNtdcPixelHistBins()
+        void setSparseTdcPixelHist(cpp_bool SparseTdcPixelHist) except +
+        cpp_bool getSparseTdcPixelHist()
+        size_t getTdcPixelHistMemory()
         void setMaxTot(const unsigned int& rMaxTot)
+        void setSparseOccupancy(cpp_bool SparseOccupancy) except +
+        cpp_bool getSparseOccupancy()
+        size_t getOccupancyMemory()
+        void setPixelMajorOccupancy(cpp_bool PixelMajorOccupancy) except +
+        void setStorageFile(const string& rFileName, cpp_bool Resume) except +
+        string getStorageFile()
+        void setNchips(const unsigned int& rNchips) except +
+        unsigned int getNchips()
+        unsigned int getNcolumns()
+        unsigned int getNrows()
+        void setPixelMask(const unsigned char* rMask, const unsigned int& rNcolumns, const unsigned int& rNrows) except +
+        void clearPixelMask()
+        void getDroppedHits(unsigned int* rDroppedHits)
+        uint64_t getNdroppedHits()
+        void merge(Histogram& rHistogram) except +
+        void serialize(vector[unsigned char]& rBlob)
+        void mergeSerialized(const unsigned char* rBlob, const size_t& rSize) except +
+        @staticmethod
+        void reduce(vector[Histogram*]& rHistograms) except +
+        void setParameterValues(const int* rParameterValues, const unsigned int& rNparameterValues) except +
+        void getParameterValues(vector[int]& rParameterValues)
+        void createSnapshots(cpp_bool CreateSnapshots) nogil
+        void takeSnapshot() nogil except +
+        unsigned int getNsnapshots()
+        void getSnapshotOccupancy(unsigned int& rNparameterValues, unsigned int*& rOccupancy)
+        void getSnapshotTotHist(unsigned int*& rTotHist)
+        void getSnapshotTdcHist(unsigned int*& rTdcHist)
+        void getSnapshotTdcTriggerDistanceHist(unsigned int*& rTdcTriggerDistanceHist)
+        void getSnapshotRelBcidHist(unsigned int*& rRelBcidHist)
+        void getSnapshotTotPixelHist(unsigned short*& rTotPixelHist)
+        void getSnapshotTdcPixelHist(unsigned int& rNbins, unsigned short*& rTdcPixelHist)
+        cpp_bool getSnapshotMeanTot(float* rMeanTot, float* rTotRms)
+        cpp_bool getSnapshotTdcPixelMoments(unsigned int* rCount, float* rMean, float* rRms, unsigned short* rMin, unsigned short* rMax)
+        cpp_bool getPixelMajorOccupancy()
+        void setNthreads(const unsigned int& rNthreads)
+        unsigned int getNthreads()
 
         void getOccupancy(unsigned int& rNparameterValues, unsigned int*& rOccupancy, cpp_bool copy)  # returns the occupancy histogram for all hits
         void getTotHist(unsigned int*& rTotHist, cpp_bool copy)  # returns the tot histogram for all hits
         void getMeanTot(unsigned int& rNparameterValues, float*& rOccupancy, cpp_bool copy)
+        void getTotRms(unsigned int& rNparameterValues, float*& rTotRms, cpp_bool copy)
         void getTdcHist(unsigned int*& rTdcHist, cpp_bool copy)
         void getTdcTriggerDistanceHist(unsigned int*& rTdcTriggerDistanceHist, cpp_bool copy)
         void getRelBcidHist(unsigned int*& rRelBcidHist, cpp_bool copy)  # returns the relative BCID histogram for all hits
         void getTdcPixelHist(unsigned short*& rTdcPixelHist, cpp_bool copy)  # returns the tdc pixel histogram for all hits
         void getTotPixelHist(unsigned short*& rTotPixelHist, cpp_bool copy)  # returns the tot pixel histogram for all hits
+        void getTdcPixelMoments(unsigned int* rCount, float* rMean, float* rRms, unsigned short* rMin, unsigned short* rMax) except +  # returns the TDC moments for each pixel
+        void getDecayingOccupancy(float* rOccupancy) except +
+        void getTimeHist(unsigned int* rEvents, unsigned int* rHits, unsigned int* rTdc, unsigned int* rErrors, unsigned int* rRegions) except +
+        unsigned int getNtimeBins()
+        unsigned int getNtimeHistColumnRegions()
+        unsigned int getNtimeHistRowRegions()
+        double getTimeHistStart()
+        uint64_t getNtimeHistLostHits()
 
-        void addHits(HitInfo*& rHitInfo, const unsigned int& rNhits) except +
-        void addClusterSeedHits(ClusterInfo*& rClusterInfo, const unsigned int& rNcluster) except +
+        void addHits(HitInfo*& rHitInfo, const unsigned int& rNhits) nogil except +
+        void addClusterSeedHits(ClusterInfo*& rClusterInfo, const unsigned int& rNcluster) nogil except +
         void addScanParameter(int*& rParInfo, const unsigned int& rNparInfoLength) except +
-        void setNoScanParameter()
+        void setNoScanParameter() except +
         void addMetaEventIndex(uint64_t*& rMetaEventIndex, const unsigned int& rNmetaEventIndexLength) except +
+        void setMetaTimeStamps(const double* rTimeStamps, const unsigned int& rNtimeStamps)
 
         unsigned int getMinParameter()  # returns the minimum parameter from _parInfo
         unsigned int getMaxParameter()  # returns the maximum parameter from _parInfo
         unsigned int getNparameters()  # returns the parameter range from _parInfo
 
         void calculateThresholdScanArrays(double rMuArray[], double rSigmaArray[], const unsigned int& rMaxInjections, const unsigned int& min_parameter, const unsigned int& max_parameter)  # takes the occupancy histograms for different parameters for the threshold arrays
+        void startLiveThreshold(const unsigned int& rMaxInjections, const unsigned int& min_parameter, const unsigned int& max_parameter) except +
+        void addLiveThresholdStep() except +
+        void getLiveThreshold(double rMuArray[], double rSigmaArray[]) except +
+        unsigned int getNliveThresholdSteps()
+        void fitScurves(double rThreshold[], double rNoise[], double rChi2[], unsigned char rStatus[], const unsigned int& rMaxInjections, const unsigned int& min_parameter, const unsigned int& max_parameter) except +  # fits the occupancy S-curve of each pixel
 
         void reset() except +
         void test()
@@ -111,22 +179,98 @@ cdef class PyDataHistograming:
         self.thisptr.createTdcPixelHist(<cpp_bool> toggle)
     def create_tot_pixel_hist(self,toggle):
         self.thisptr.createTotPixelHist(<cpp_bool> toggle)
+    def create_tdc_pixel_moments(self,toggle):
+        self.thisptr.createTdcPixelMoments(<cpp_bool> toggle)
+    def create_decaying_occupancy_hist(self, toggle):
+        self.thisptr.createDecayingOccupancyHist(<cpp_bool> toggle)
+    def set_occupancy_half_life(self, half_life):  # in events, resets the decaying occupancy
+        self.thisptr.setOccupancyHalfLife(<const double&> half_life)
+    def get_occupancy_half_life(self):
+        return self.thisptr.getOccupancyHalfLife()
+    def create_time_hist(self, toggle):  # needs the meta event index and the read out time stamps
+        self.thisptr.createTimeHist(<cpp_bool> toggle)
+    def set_time_hist_binning(self, bin_width, n_bins, n_column_regions=1, n_row_regions=1):  # only the newest n_bins time bins are kept; resets the time histograms
+        self.thisptr.setTimeHistBinning(<const double&> bin_width, <const unsigned int&> n_bins, <const unsigned int&> n_column_regions, <const unsigned int&> n_row_regions)
+    def set_tdc_pixel_hist_bin_width(self, bin_width):  # resets the TDC pixel histogram
+        self.thisptr.setTdcPixelHistBinWidth(<const unsigned int&> bin_width)
+    def get_n_tdc_pixel_hist_bins(self):
+        return self.thisptr.getNtdcPixelHistBins()
+    def set_sparse_tdc_pixel_hist(self, toggle):  # resets the TDC pixel histogram
+        self.thisptr.setSparseTdcPixelHist(<cpp_bool> toggle)
+    def get_sparse_tdc_pixel_hist(self):
+        return <cpp_bool> self.thisptr.getSparseTdcPixelHist()
+    def get_tdc_pixel_hist_memory(self):
+        return self.thisptr.getTdcPixelHistMemory()
     def set_max_tot(self, max_tot):
         self.thisptr.setMaxTot(<const unsigned int&> max_tot)
+    def set_sparse_occupancy(self, toggle):  # has to be set before the scan parameters
+        self.thisptr.setSparseOccupancy(<cpp_bool> toggle)
+    def get_sparse_occupancy(self):
+        return <cpp_bool> self.thisptr.getSparseOccupancy()
+    def get_occupancy_memory(self):
+        return self.thisptr.getOccupancyMemory()
+    def set_pixel_major_occupancy(self, toggle):  # parameter as fastest index for per pixel analyses, has to be set before the scan parameters
+        self.thisptr.setPixelMajorOccupancy(<cpp_bool> toggle)
+    def get_pixel_major_occupancy(self):
+        return <cpp_bool> self.thisptr.getPixelMajorOccupancy()
+    def set_storage_file(self, file_name, resume=False):  # memory-mapped histogram files file_name + '_occupancy.dat', ... that other processes can read, empty name: heap; resume: keep the content of files with the same layout and parameter values, has to be set before the histograms are enabled
+        self.thisptr.setStorageFile(<string> file_name.encode('utf-8'), <cpp_bool> resume)
+    def get_storage_file(self):
+        return self.thisptr.getStorageFile().decode('utf-8')
+    def set_n_chips(self, n_chips):  # module layout of 1 (80 x 336 pixels), 2 (160 x 336) or 4 chips (160 x 672), the hits need module columns/rows; resets the pixel histograms
+        self.thisptr.setNchips(<const unsigned int&> n_chips)
+    def get_n_chips(self):
+        return self.thisptr.getNchips()
+    def get_n_columns(self):
+        return self.thisptr.getNcolumns()
+    def get_n_rows(self):
+        return self.thisptr.getNrows()
+    def set_pixel_mask(self, mask):  # hits of pixels with mask != 0 (2d array col, row) are not histogrammed, None: no mask; cleared by set_n_chips
+        cdef cnp.ndarray[cnp.uint8_t, ndim=1] mask_array
+        if mask is None:
+            self.thisptr.clearPixelMask()
+            return
+        mask = np.asarray(mask)
+        if mask.ndim != 2:
+            raise ValueError('Pixel mask has to be a 2d array (col, row)')
+        mask_array = (mask != 0).ravel(order='F').astype(np.uint8)
+        self.thisptr.setPixelMask(<const unsigned char*> mask_array.data, <const unsigned int&> mask.shape[0], <const unsigned int&> mask.shape[1])
+    def get_dropped_hits(self):  # number of not histogrammed hits of each masked pixel (col, row)
+        cdef cnp.ndarray[cnp.uint32_t, ndim=1] dropped_hits = np.zeros(self.thisptr.getNcolumns() * self.thisptr.getNrows(), dtype=np.uint32)
+        self.thisptr.getDroppedHits(<unsigned int*> dropped_hits.data)
+        return dropped_hits.reshape((self.thisptr.getNcolumns(), self.thisptr.getNrows()), order='F')
+    def get_n_dropped_hits(self):
+        return self.thisptr.getNdroppedHits()
+    def set_n_threads(self, n_threads):  # 0 = OpenMP default
+        self.thisptr.setNthreads(<const unsigned int&> n_threads)
+    def get_n_threads(self):
+        return self.thisptr.getNthreads()
     def get_occupancy(self):
+        cdef cnp.ndarray[cnp.uint32_t, ndim=1] occupancy
+        if self.thisptr.getSparseOccupancy() or self.thisptr.getPixelMajorOccupancy():  # the tiles are copied (transposed) into a new dense array instead of a dense array held by the histogrammer
+            occupancy = np.zeros(self.thisptr.getNcolumns() * self.thisptr.getNrows() * self.thisptr.getNparameters(), dtype=np.uint32)
+            self.thisptr.getOccupancy(Nparameter, <unsigned int*&> occupancy.data, <cpp_bool> True)
+            return occupancy.reshape((self.thisptr.getNcolumns(), self.thisptr.getNrows(), Nparameter), order='F')  # make linear array to 3d array (col,row,parameter)
         self.thisptr.getOccupancy(Nparameter, <unsigned int*&> data_32, <cpp_bool> False)
         if data_32 != NULL:
-            array = data_to_numpy_array_uint32(data_32, 80 * 336 * Nparameter)
-            return array.reshape((80, 336, Nparameter), order='F')  # make linear array to 3d array (col,row,parameter)
+            array = data_to_numpy_array_uint32(data_32, self.thisptr.getNcolumns() * self.thisptr.getNrows() * Nparameter)
+            return array.reshape((self.thisptr.getNcolumns(), self.thisptr.getNrows(), Nparameter), order='F')  # make linear array to 3d array (col,row,parameter)
     def get_tot_hist(self):
         self.thisptr.getTotHist(<unsigned int*&> data_32, <cpp_bool> False)
         if data_32 != NULL:
             return data_to_numpy_array_uint32(data_32, 16)
-    def get_mean_tot(self):
-        self.thisptr.getMeanTot(Nparameter, <float*&> data_float, <cpp_bool> False)
-        if data_float != NULL:
-            array = data_to_numpy_array_float(data_float, 80 * 336 * Nparameter)
-            return array.reshape((80, 336, Nparameter), order='F')  # make linear array to 3d array (col,row,parameter)
+    def get_mean_tot(self):  # calculated from the ToT sums on every call into a new array, None if the mean ToT histogram is not created
+        if not self.thisptr.isMeanTotHist():
+            return None
+        cdef cnp.ndarray[cnp.float32_t, ndim=1] mean_tot = np.full(self.thisptr.getNcolumns() * self.thisptr.getNrows() * self.thisptr.getNparameters(), np.nan, dtype=np.float32)
+        self.thisptr.getMeanTot(Nparameter, <float*&> mean_tot.data, <cpp_bool> True)
+        return mean_tot.reshape((self.thisptr.getNcolumns(), self.thisptr.getNrows(), Nparameter), order='F')  # make linear array to 3d array (col,row,parameter)
+    def get_tot_rms(self):  # calculated from the ToT sums on every call into a new array, None if the mean ToT histogram is not created
+        if not self.thisptr.isMeanTotHist():
+            return None
+        cdef cnp.ndarray[cnp.float32_t, ndim=1] tot_rms = np.full(self.thisptr.getNcolumns() * self.thisptr.getNrows() * self.thisptr.getNparameters(), np.nan, dtype=np.float32)
+        self.thisptr.getTotRms(Nparameter, <float*&> tot_rms.data, <cpp_bool> True)
+        return tot_rms.reshape((self.thisptr.getNcolumns(), self.thisptr.getNrows(), Nparameter), order='F')  # make linear array to 3d array (col,row,parameter)
     def get_tdc_hist(self):
         self.thisptr.getTdcHist(<unsigned int*&> data_32, <cpp_bool> False)
         if data_32 != NULL:
@@ -142,28 +286,156 @@ cdef class PyDataHistograming:
     def get_tot_pixel_hist(self):
         self.thisptr.getTotPixelHist(<cnp.uint16_t*&> data_16, <cpp_bool> False)
         if data_16 != NULL:
-            array = data_to_numpy_array_uint16(data_16, 80 * 336 * 16)
-            return array.reshape((80, 336, 16), order='F')  # make linear array to 3d array (col,row,parameter)
+            array = data_to_numpy_array_uint16(data_16, self.thisptr.getNcolumns() * self.thisptr.getNrows() * 16)
+            return array.reshape((self.thisptr.getNcolumns(), self.thisptr.getNrows(), 16), order='F')  # make linear array to 3d array (col,row,parameter)
     def get_tdc_pixel_hist(self):
+        cdef cnp.ndarray[cnp.uint16_t, ndim=1] tdc_pixel_hist
+        n_bins = self.thisptr.getNtdcPixelHistBins()
+        if self.thisptr.getSparseTdcPixelHist():  # the tiles are copied into a new dense array instead of a dense array held by the histogrammer
+            tdc_pixel_hist = np.zeros(self.thisptr.getNcolumns() * self.thisptr.getNrows() * n_bins, dtype=np.uint16)
+            self.thisptr.getTdcPixelHist(<unsigned short*&> tdc_pixel_hist.data, <cpp_bool> True)
+            return tdc_pixel_hist.reshape((self.thisptr.getNcolumns(), self.thisptr.getNrows(), n_bins), order='F')
         self.thisptr.getTdcPixelHist(<cnp.uint16_t*&> data_16, <cpp_bool> False)
         if data_16 != NULL:
-            array = data_to_numpy_array_uint16(data_16, 80 * 336 * 4096)
-            return array.reshape((80, 336, 4096), order='F')
-    def add_hits(self, cnp.ndarray[numpy_hit_info, ndim=1] hit_info):
-        self.thisptr.addHits(<HitInfo*&> hit_info.data, <const unsigned int&> hit_info.shape[0])
+            array = data_to_numpy_array_uint16(data_16, self.thisptr.getNcolumns() * self.thisptr.getNrows() * n_bins)
+            return array.reshape((self.thisptr.getNcolumns(), self.thisptr.getNrows(), n_bins), order='F')
+    def get_tdc_pixel_moments(self):  # returns count, mean, RMS, min and max TDC value of each pixel
+        cdef cnp.ndarray[cnp.uint32_t, ndim=1] count = np.zeros(self.thisptr.getNcolumns() * self.thisptr.getNrows(), dtype=np.uint32)
+        cdef cnp.ndarray[cnp.float32_t, ndim=1] mean = np.zeros(self.thisptr.getNcolumns() * self.thisptr.getNrows(), dtype=np.float32)
+        cdef cnp.ndarray[cnp.float32_t, ndim=1] rms = np.zeros(self.thisptr.getNcolumns() * self.thisptr.getNrows(), dtype=np.float32)
+        cdef cnp.ndarray[cnp.uint16_t, ndim=1] tdc_min = np.zeros(self.thisptr.getNcolumns() * self.thisptr.getNrows(), dtype=np.uint16)
+        cdef cnp.ndarray[cnp.uint16_t, ndim=1] tdc_max = np.zeros(self.thisptr.getNcolumns() * self.thisptr.getNrows(), dtype=np.uint16)
+        self.thisptr.getTdcPixelMoments(<unsigned int*> count.data, <float*> mean.data, <float*> rms.data, <unsigned short*> tdc_min.data, <unsigned short*> tdc_max.data)
+        return tuple(array.reshape((self.thisptr.getNcolumns(), self.thisptr.getNrows()), order='F') for array in (count, mean, rms, tdc_min, tdc_max))  # make linear array to 2d array (col,row)
+    def get_decaying_occupancy(self):  # occupancy decayed to the last event number (col, row)
+        cdef cnp.ndarray[cnp.float32_t, ndim=1] occupancy = np.zeros(self.thisptr.getNcolumns() * self.thisptr.getNrows(), dtype=np.float32)
+        self.thisptr.getDecayingOccupancy(<float*> occupancy.data)
+        return occupancy.reshape((self.thisptr.getNcolumns(), self.thisptr.getNrows()), order='F')
+    def get_time_hist(self):  # returns the start time stamp of the oldest bin and per time bin: events, hits, events with TDC word, events per error code (time bin, error code) and hits per region (column region, row region, time bin)
+        cdef unsigned int n_bins = self.thisptr.getNtimeBins()
+        cdef cnp.ndarray[cnp.uint32_t, ndim=1] events = np.zeros(n_bins, dtype=np.uint32)
+        cdef cnp.ndarray[cnp.uint32_t, ndim=1] hits = np.zeros(n_bins, dtype=np.uint32)
+        cdef cnp.ndarray[cnp.uint32_t, ndim=1] tdc = np.zeros(n_bins, dtype=np.uint32)
+        cdef cnp.ndarray[cnp.uint32_t, ndim=1] errors = np.zeros(n_bins * __N_ERROR_CODES, dtype=np.uint32)
+        cdef unsigned int n_column_regions = self.thisptr.getNtimeHistColumnRegions(), n_row_regions = self.thisptr.getNtimeHistRowRegions()
+        cdef cnp.ndarray[cnp.uint32_t, ndim=1] regions = np.zeros(n_bins * n_column_regions * n_row_regions, dtype=np.uint32)
+        self.thisptr.getTimeHist(<unsigned int*> events.data, <unsigned int*> hits.data, <unsigned int*> tdc.data, <unsigned int*> errors.data, <unsigned int*> regions.data)
+        return self.thisptr.getTimeHistStart(), events, hits, tdc, errors.reshape((n_bins, __N_ERROR_CODES)), regions.reshape((n_column_regions, n_row_regions, n_bins), order='F')
+    def get_n_time_hist_lost_hits(self):  # hits of events older than the oldest time bin
+        return self.thisptr.getNtimeHistLostHits()
+    def merge(self, PyDataHistograming histograming):  # adds the histograms of another histogrammer, the parameters are aligned by the parameter values
+        self.thisptr.merge(histograming.thisptr[0])
+    def to_bytes(self):  # all histograms as binary blob (native byte order) for merge_bytes
+        cdef vector[unsigned char] blob
+        self.thisptr.serialize(blob)
+        return (<char*> &blob[0])[:blob.size()]
+    def merge_bytes(self, bytes blob):
+        self.thisptr.mergeSerialized(<const unsigned char*> <const char*> blob, <const size_t&> len(blob))
+    def set_parameter_values(self, cnp.ndarray[cnp.int32_t, ndim=1] parameter_values):  # scan parameter value of each parameter index, has to be set after the scan parameters
+        self.thisptr.setParameterValues(<const int*> parameter_values.data, <const unsigned int&> parameter_values.shape[0])
+    def get_parameter_values(self):
+        cdef vector[int] parameter_values
+        self.thisptr.getParameterValues(parameter_values)
+        return np.array(parameter_values, dtype=np.int32)
+    def create_snapshots(self, toggle):  # publishes the histograms at the end of every add_hits batch for take_snapshot
+        cdef cpp_bool create = toggle
+        with nogil:
+            self.thisptr.createSnapshots(create)
+    def take_snapshot(self):  # the histograms published at the end of the last finished add_hits batch, no copy; the get_snapshot arrays of the previous snapshot stay unchanged until the next call; can be called while another thread is in add_hits without waiting for it
+        with nogil:
+            self.thisptr.takeSnapshot()
+    def get_n_snapshots(self):
+        return self.thisptr.getNsnapshots()
+    def get_snapshot_occupancy(self):
+        self.thisptr.getSnapshotOccupancy(Nparameter, <unsigned int*&> data_32)
+        if data_32 != NULL:
+            array = data_to_numpy_array_uint32(data_32, self.thisptr.getNcolumns() * self.thisptr.getNrows() * Nparameter)
+            return array.reshape((self.thisptr.getNcolumns(), self.thisptr.getNrows(), Nparameter), order='F')  # make linear array to 3d array (col,row,parameter)
+    def get_snapshot_tot_hist(self):
+        self.thisptr.getSnapshotTotHist(<unsigned int*&> data_32)
+        if data_32 != NULL:
+            return data_to_numpy_array_uint32(data_32, 16)
+    def get_snapshot_tdc_hist(self):
+        self.thisptr.getSnapshotTdcHist(<unsigned int*&> data_32)
+        if data_32 != NULL:
+            return data_to_numpy_array_uint32(data_32, 4096)
+    def get_snapshot_tdc_distance_hist(self):
+        self.thisptr.getSnapshotTdcTriggerDistanceHist(<unsigned int*&> data_32)
+        if data_32 != NULL:
+            return data_to_numpy_array_uint32(data_32, 256)
+    def get_snapshot_rel_bcid_hist(self):
+        self.thisptr.getSnapshotRelBcidHist(<unsigned int*&> data_32)
+        if data_32 != NULL:
+            return data_to_numpy_array_uint32(data_32, 256)
+    def get_snapshot_tot_pixel_hist(self):
+        self.thisptr.getSnapshotTotPixelHist(<cnp.uint16_t*&> data_16)
+        if data_16 != NULL:
+            array = data_to_numpy_array_uint16(data_16, self.thisptr.getNcolumns() * self.thisptr.getNrows() * 16)
+            return array.reshape((self.thisptr.getNcolumns(), self.thisptr.getNrows(), 16), order='F')
+    def get_snapshot_tdc_pixel_hist(self):
+        cdef unsigned int n_bins = 0
+        self.thisptr.getSnapshotTdcPixelHist(n_bins, <cnp.uint16_t*&> data_16)
+        if data_16 != NULL:
+            array = data_to_numpy_array_uint16(data_16, self.thisptr.getNcolumns() * self.thisptr.getNrows() * n_bins)
+            return array.reshape((self.thisptr.getNcolumns(), self.thisptr.getNrows(), n_bins), order='F')
+    def get_snapshot_mean_tot(self):  # mean ToT and ToT RMS of the last snapshot in new arrays (col, row, parameter), None if the mean ToT histogram is not created
+        self.thisptr.getSnapshotOccupancy(Nparameter, <unsigned int*&> data_32)
+        cdef cnp.ndarray[cnp.float32_t, ndim=1] mean_tot = np.empty(self.thisptr.getNcolumns() * self.thisptr.getNrows() * Nparameter, dtype=np.float32)
+        cdef cnp.ndarray[cnp.float32_t, ndim=1] tot_rms = np.empty_like(mean_tot)
+        if data_32 == NULL or not self.thisptr.getSnapshotMeanTot(<float*> mean_tot.data, <float*> tot_rms.data):
+            return None
+        return tuple(array.reshape((self.thisptr.getNcolumns(), self.thisptr.getNrows(), Nparameter), order='F') for array in (mean_tot, tot_rms))
+    def get_snapshot_tdc_pixel_moments(self):  # TDC moments of the last snapshot as get_tdc_pixel_moments, None if not created
+        cdef cnp.ndarray[cnp.uint32_t, ndim=1] count = np.zeros(self.thisptr.getNcolumns() * self.thisptr.getNrows(), dtype=np.uint32)
+        cdef cnp.ndarray[cnp.float32_t, ndim=1] mean = np.zeros(self.thisptr.getNcolumns() * self.thisptr.getNrows(), dtype=np.float32)
+        cdef cnp.ndarray[cnp.float32_t, ndim=1] rms = np.zeros(self.thisptr.getNcolumns() * self.thisptr.getNrows(), dtype=np.float32)
+        cdef cnp.ndarray[cnp.uint16_t, ndim=1] tdc_min = np.zeros(self.thisptr.getNcolumns() * self.thisptr.getNrows(), dtype=np.uint16)
+        cdef cnp.ndarray[cnp.uint16_t, ndim=1] tdc_max = np.zeros(self.thisptr.getNcolumns() * self.thisptr.getNrows(), dtype=np.uint16)
+        if not self.thisptr.getSnapshotTdcPixelMoments(<unsigned int*> count.data, <float*> mean.data, <float*> rms.data, <unsigned short*> tdc_min.data, <unsigned short*> tdc_max.data):
+            return None
+        return tuple(array.reshape((self.thisptr.getNcolumns(), self.thisptr.getNrows()), order='F') for array in (count, mean, rms, tdc_min, tdc_max))
+    def add_hits(self, cnp.ndarray[numpy_hit_info, ndim=1] hit_info):  # the GIL is released while filling, thus other threads can take snapshots meanwhile
+        cdef HitInfo* hits = <HitInfo*> hit_info.data
+        cdef unsigned int n_hits = hit_info.shape[0]
+        with nogil:
+            self.thisptr.addHits(hits, n_hits)
     def add_cluster_seed_hits(self, cnp.ndarray[numpy_cluster_info, ndim=1] cluster_info, Ncluster):
-        self.thisptr.addClusterSeedHits(<ClusterInfo*&> cluster_info.data, <const unsigned int&> Ncluster)
+        cdef ClusterInfo* cluster = <ClusterInfo*> cluster_info.data
+        cdef unsigned int n_cluster = Ncluster
+        with nogil:
+            self.thisptr.addClusterSeedHits(cluster, n_cluster)
     def add_scan_parameter(self, cnp.ndarray[cnp.int32_t, ndim=1] parameter_info):
         self.thisptr.addScanParameter(<int*&> parameter_info.data, <const unsigned int&> parameter_info.shape[0])
     def set_no_scan_parameter(self):
         self.thisptr.setNoScanParameter()
     def add_meta_event_index(self, cnp.ndarray[cnp.uint64_t, ndim=1] event_index, array_length):
         self.thisptr.addMetaEventIndex(<uint64_t*&> event_index.data, <unsigned int&> array_length)
+    def set_meta_time_stamps(self, cnp.ndarray[cnp.float64_t, ndim=1] time_stamps):  # start time stamp of each read out (e.g. meta_data['timestamp_start']), same length as the meta event index
+        self.thisptr.setMetaTimeStamps(<const double*> time_stamps.data, <const unsigned int&> time_stamps.shape[0])
     def get_n_parameters(self):
         return <unsigned int> self.thisptr.getNparameters()
     def calculate_threshold_scan_arrays(self, cnp.ndarray[cnp.float64_t, ndim=1] threshold, cnp.ndarray[cnp.float64_t, ndim=1] noise, n_injections, min_parameter, max_parameter):
         self.thisptr.calculateThresholdScanArrays(<double*> threshold.data, <double*> noise.data, <const unsigned int&> n_injections, <const unsigned int&> min_parameter, <const unsigned int&> max_parameter)
+    def start_live_threshold(self, n_injections, min_parameter, max_parameter):  # starts the incremental threshold estimation, the scan parameters have to be set
+        self.thisptr.startLiveThreshold(<const unsigned int&> n_injections, <const unsigned int&> min_parameter, <const unsigned int&> max_parameter)
+    def add_live_threshold_step(self):  # call when the hits of the next parameter step are added
+        self.thisptr.addLiveThresholdStep()
+    def get_live_threshold(self, cnp.ndarray[cnp.float64_t, ndim=1] threshold, cnp.ndarray[cnp.float64_t, ndim=1] noise):
+        self.thisptr.getLiveThreshold(<double*> threshold.data, <double*> noise.data)
+    def get_n_live_threshold_steps(self):
+        return self.thisptr.getNliveThresholdSteps()
+    def fit_scurves(self, cnp.ndarray[cnp.float64_t, ndim=1] threshold, cnp.ndarray[cnp.float64_t, ndim=1] noise, cnp.ndarray[cnp.float64_t, ndim=1] chi2, cnp.ndarray[cnp.uint8_t, ndim=1] status, n_injections, min_parameter, max_parameter):  # status: 0 converged, 1 not converged, 2 no data, 3 failed
+        self.thisptr.fitScurves(<double*> threshold.data, <double*> noise.data, <double*> chi2.data, <unsigned char*> status.data, <const unsigned int&> n_injections, <const unsigned int&> min_parameter, <const unsigned int&> max_parameter)
     def reset(self):
         self.thisptr.reset()
     def test(self):
         self.thisptr.test()
+
+
+def reduce_histogramings(histogramings):  # merges all histogrammers into the first one by a tree reduction and returns it
+    cdef vector[Histogram*] histograms
+    cdef PyDataHistograming histograming
+    for histograming in histogramings:
+        histograms.push_back(histograming.thisptr)
+    Histogram.reduce(histograms)
+    return histogramings[0] if histogramings else None
@@ -6,9 +6,9 @@ cimport numpy as cnp
 from numpy cimport ndarray
 from libcpp cimport bool as cpp_bool  # to be able to use bool variables, as cpp_bool according to http://code.google.com/p/cefpython/source/browse/cefpython/cefpython.pyx?spec=svne037c69837fa39ae220806c2faa1bbb6ae4500b9&r=e037c69837fa39ae220806c2faa1bbb6ae4500b9
 from data_struct cimport numpy_hit_info, numpy_meta_data, numpy_meta_data_v2, numpy_meta_word_data
-from data_struct import MetaTable, MetaTableV2
+from data_struct import MetaTable, MetaTableV2, TriggerIndexTable
 from tables import dtype_from_descr
-from libc.stdint cimport uint64_t
+from libc.stdint cimport uint64_t, int64_t
 
 cnp.import_array()  # if array is used it has to be imported, otherwise possible runtime error
 
@@ -25,6 +25,8 @@ cdef extern from "Interpret.h":
         MetaWordInfoOut()
     cdef cppclass HitInfo:
         HitInfo()
+    cdef cppclass TriggerIndexInfo:
+        TriggerIndexInfo()
     cdef cppclass Interpret(Basis):
         Interpret() except +
         void printStatus()
@@ -66,6 +68,20 @@ cdef extern from "Interpret.h":
         void setMaxTdcDelay(const unsigned int& rMaxTdcDelay)
         void useTdcTriggerTimeStamp(cpp_bool useTdcTriggerTimeStamp)
         void setMaxTriggerNumber(const unsigned int& rMaxTriggerNumber)
+        void setModuleChip(const unsigned int& rNchips, const unsigned int& rChip) except +
+        unsigned int getNcolumns()
+        unsigned int getNrows()
+        void setPixelMask(const unsigned char* rMask, const unsigned int& rNcolumns, const unsigned int& rNrows) except +
+        void clearPixelMask()
+        void getDroppedHits(unsigned int* rDroppedHits)
+        uint64_t getNdroppedHits()
+        void setNoisyPixelDetection(const double& rWindow, const double& rMaxSigma, const double& rMaxRate, cpp_bool AutoMask) except +
+        void getNoisyPixels(unsigned char* rNoisyPixels)
+        unsigned int getNnoisyPixels()
+        void createTriggerIndex(cpp_bool CreateTriggerIndex)
+        unsigned int getNtriggerIndex()
+        void getTriggerIndex(TriggerIndexInfo* rTriggerIndex)
+        void findTriggerEvents(const int64_t* rTriggerKeys, const unsigned int& rSize, int64_t* rEventNumber, int64_t* rHitIndex)
 
         void resetEventVariables()
         void resetCounters()
@@ -210,6 +226,46 @@ cdef class PyDataInterpreter:
         self.thisptr.setMaxTdcDelay(<const unsigned int&> max_tdc_delay)
     def set_max_trigger_number(self, max_trigger_number):  # max delay, below tdc words are fully ignored (but counted)
         self.thisptr.setMaxTriggerNumber(<const unsigned int&> max_trigger_number)
+    def set_module_chip(self, n_chips, chip):  # hits get the columns/rows of the chip in a module with 1, 2 or 4 chips, see PyDataHistograming.set_n_chips
+        self.thisptr.setModuleChip(<const unsigned int&> n_chips, <const unsigned int&> chip)
+    def set_pixel_mask(self, mask):  # hits of pixels with mask != 0 (2d array col, row in module coordinates) are dropped during decoding, None: no mask
+        cdef cnp.ndarray[cnp.uint8_t, ndim=1] mask_array
+        if mask is None:
+            self.thisptr.clearPixelMask()
+            return
+        mask = np.asarray(mask)
+        if mask.ndim != 2:
+            raise ValueError('Pixel mask has to be a 2d array (col, row)')
+        mask_array = (mask != 0).ravel(order='F').astype(np.uint8)
+        self.thisptr.setPixelMask(<const unsigned char*> mask_array.data, <const unsigned int&> mask.shape[0], <const unsigned int&> mask.shape[1])
+    def get_dropped_hits(self):  # number of dropped hits of each masked pixel (col, row)
+        cdef cnp.ndarray[cnp.uint32_t, ndim=1] dropped_hits = np.zeros(self.thisptr.getNcolumns() * self.thisptr.getNrows(), dtype=np.uint32)
+        self.thisptr.getDroppedHits(<unsigned int*> dropped_hits.data)
+        return dropped_hits.reshape((self.thisptr.getNcolumns(), self.thisptr.getNrows()), order='F')
+    def get_n_dropped_hits(self):
+        return self.thisptr.getNdroppedHits()
+    def set_noisy_pixel_detection(self, window, max_sigma=5., max_rate=0., auto_mask=False):  # flags pixels with a rate of stored hits (masked and ToT cut hits not counted) above mean + max_sigma * RMS or above max_rate (Hz) in sliding windows of window seconds of the meta data time stamps, auto_mask: add them to the pixel mask; window = 0: off
+        self.thisptr.setNoisyPixelDetection(<const double&> window, <const double&> max_sigma, <const double&> max_rate, <cpp_bool> auto_mask)
+    def get_noisy_pixels(self):  # noisy pixel flags (col, row)
+        cdef cnp.ndarray[cnp.uint8_t, ndim=1] noisy_pixels = np.zeros(self.thisptr.getNcolumns() * self.thisptr.getNrows(), dtype=np.uint8)
+        self.thisptr.getNoisyPixels(<unsigned char*> noisy_pixels.data)
+        return noisy_pixels.reshape((self.thisptr.getNcolumns(), self.thisptr.getNrows()), order='F').astype(np.bool_)
+    def get_n_noisy_pixels(self):
+        return self.thisptr.getNnoisyPixels()
+    def create_trigger_index(self, value=True):  # index of the events by the unwrapped trigger number (time stamp in TIMESTAMP trigger format), reset with reset(); kept in memory (std::vector) with 24 bytes per event, e.g. 240 MB for 10^7 events
+        self.thisptr.createTriggerIndex(<cpp_bool> value)
+    def get_trigger_index(self):  # trigger_key, event_number, hit_index (first hit of the event) sorted by trigger_key
+        cdef cnp.ndarray trigger_index = np.zeros(self.thisptr.getNtriggerIndex(), dtype=dtype_from_descr(TriggerIndexTable))
+        if trigger_index.shape[0] != 0:
+            self.thisptr.getTriggerIndex(<TriggerIndexInfo*> trigger_index.data)
+        return trigger_index
+    def find_trigger_events(self, trigger_keys):  # event number and first hit index of the first event with the trigger key, -1 if not found
+        cdef cnp.ndarray[cnp.int64_t, ndim=1] keys = np.ascontiguousarray(trigger_keys, dtype=np.int64).ravel()
+        cdef cnp.ndarray[cnp.int64_t, ndim=1] event_numbers = np.empty_like(keys)
+        cdef cnp.ndarray[cnp.int64_t, ndim=1] hit_indices = np.empty_like(keys)
+        if keys.shape[0] != 0:
+            self.thisptr.findTriggerEvents(<const int64_t*> keys.data, <const unsigned int&> keys.shape[0], <int64_t*> event_numbers.data, <int64_t*> hit_indices.data)
+        return event_numbers, hit_indices
     @property
     def fei4b(self):
         return <cpp_bool> self.thisptr.getFEI4B()
@@ -101,6 +101,12 @@ class MetaInfoWordTable(tb.IsDescription):
     stop_index = tb.UInt32Col(pos=2)
 
 
+class TriggerIndexTable(tb.IsDescription):
+    trigger_key = tb.Int64Col(pos=0)
+    event_number = tb.Int64Col(pos=1)
+    hit_index = tb.Int64Col(pos=2)
+
+
 class ClusterHitInfoTable(tb.IsDescription):
     event_number = tb.Int64Col(pos=0)
     trigger_number = tb.UInt32Col(pos=1)
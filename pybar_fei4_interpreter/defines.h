@@ -95,12 +95,21 @@ typedef struct MetaWordInfoOut{
 	unsigned int stopWordIdex;	//stop word index
 } MetaWordInfoOut;
 
+//structure of the trigger index entries (Interpret::createTriggerIndex)
+typedef struct TriggerIndexInfo{
+	int64_t triggerKey;			//trigger number (time stamp in TIMESTAMP trigger format) of the event with the overflows added, thus increasing
+	int64_t eventNumber;		//event number
+	int64_t hitIndex;			//index of the first hit of the event in the hits of all interpreted data
+} TriggerIndexInfo;
+
 //DUT and TLU defines
 const unsigned int __BCIDCOUNTERSIZE_FEI4A=256;	//BCID counter for FEI4A has 8 bit
 const unsigned int __BCIDCOUNTERSIZE_FEI4B=1024;//BCID counter for FEI4B has 10 bit
 const unsigned int __NSERVICERECORDS=32;		//# of different service records
 const size_t __MAXARRAYSIZE=2000000;			//maximum buffer array size for the output hit array (has to be bigger than hits in one chunk)
 const size_t __MAXHITBUFFERSIZE=4000000;		//maximum buffer array size for the hit buffer array (has to be bigger than hits in one event)
+const unsigned int __MIN_NOISY_PIXEL_HITS=10;	//minimum number of hits in a window for a pixel to be flagged noisy by the sigma criterion (Interpret::setNoisyPixelDetection), suppresses fluctuations at low occupancy
+const unsigned int __MAX_INTERPOLATION_STEPS=4;	//interpolation search steps of the trigger index search (Interpret::findTriggerKey), the remaining range is searched binary
 
 //event error codes
 const unsigned int __N_ERROR_CODES=16;			//number of event error codes
@@ -137,6 +146,39 @@ const unsigned int __MAXPOSYBINS=1000;			//number of bins in y for the 2d hit po
 
 const unsigned int __MAXTOTLOOKUP=14;
 
+//Histogram definitions
+const unsigned int __HIT_BLOCK_SIZE=64;			//number of hits that are range checked at once in Histogram::addHits
+const unsigned int __HIST_TILE_SIZE=256;			//number of entries of one histogram tile (TiledArray), the number of pixels has to be a multiple of it
+const unsigned int __MIN_HITS_PER_THREAD=50000;	//minimum number of hits per thread in Histogram::addHits, the partial histogram reduction does not pay off for less
+const unsigned int __MAX_SCURVE_FIT_ITERATIONS=100;	//maximum number of Levenberg-Marquardt iterations of one S-curve fit
+const unsigned int __HIST_BLOB_ID=0x54534948;			//first word of a serialized histogram (Histogram::serialize)
+const unsigned int __HIST_BLOB_VERSION=2;			//version of the serialized histogram format
+const unsigned int __HIST_FILE_ID=0x46534948;		//first word of a histogram storage file (Histogram::setStorageFile)
+const unsigned int __HIST_FILE_VERSION=2;			//version of the histogram storage file layout
+const unsigned int __HIST_FILE_HEADER_SIZE=64;		//the header before the entries of a histogram storage file is a multiple of these bytes
+const int __DECAY_MAX_TILE_EXPONENT=64;			//a decaying occupancy tile is rescaled when the weight of a new hit exceeds 2^x (Histogram::createDecayingOccupancyHist)
+const int __DECAY_MAX_EXPONENT=256;				//the decay origin is moved when an event weight exceeds 2^x, a tile is reset when its factor exceeds 2^x (decayed to 0); double range is 2^1023
+const unsigned int __N_SNAPSHOT_BUFFERS=3;			//number of histogram snapshot buffers (Histogram::takeSnapshot): the snapshot, the last published histograms and the buffer being published; every tile has one dirty bit per buffer
+
+//AnalysisFunctions definitions
+const unsigned int __GALLOP_MIN_SIZE_RATIO=8;		//the sorted array functions use galloping search if one array is at least x times larger than the other, otherwise linear search
+const unsigned int __MIN_EVENTS_PER_THREAD=1<<20;	//minimum number of entries per thread of the parallel functions
+const unsigned int __GROUP_COUNT=0;				//group-by reductions (reduceGroups): number of entries of a group
+const unsigned int __GROUP_SUM=1;				//sum of the values of a group
+const unsigned int __GROUP_MIN=2;				//minimum value of a group
+const unsigned int __GROUP_MAX=3;				//maximum value of a group
+const unsigned int __GROUP_FIRST=4;				//first value of a group
+const unsigned int __GROUP_LAST=5;				//last value of a group
+const unsigned int __JOIN_INNER=0;				//sorted joins (joinSorted): all pairs of entries with equal keys, one-to-many if the keys of table one are unique
+const unsigned int __JOIN_LEFT=1;				//inner join and every entry of table one without match paired with -1
+const unsigned int __JOIN_PAIRWISE=2;			//the n-th entry of a key in table one paired with the n-th entry of the key in table two or -1 (mapCluster)
+
+//S-curve fit status codes
+const unsigned char __SCURVE_FIT_CONVERGED=0;		//fit converged
+const unsigned char __SCURVE_FIT_NOT_CONVERGED=1;	//maximum number of iterations reached
+const unsigned char __SCURVE_FIT_NO_DATA=2;			//pixel without hits or without any parameter below the threshold, not fitted
+const unsigned char __SCURVE_FIT_FAILED=3;			//fit diverged (non finite or negative values)
+
 // FE definitions
 const unsigned int RAW_DATA_MIN_COLUMN=1;
 const unsigned int RAW_DATA_MAX_COLUMN=80;
@@ -2,15 +2,20 @@
 '''
 
 import os
+import math
 import unittest
+import tempfile
+import shutil
+import threading
 import tables as tb
 import numpy as np
 
 import pybar_fei4_interpreter
 from pybar_fei4_interpreter import analysis_utils
+from pybar_fei4_interpreter import analysis_functions
 from pybar_fei4_interpreter import data_struct
 from pybar_fei4_interpreter.data_interpreter import PyDataInterpreter
-from pybar_fei4_interpreter.data_histograming import PyDataHistograming
+from pybar_fei4_interpreter.data_histograming import PyDataHistograming, reduce_histogramings
 
 
 # Get package path
@@ -161,12 +166,757 @@ class TestAnalysis(unittest.TestCase):
         occ_hist_python, _, _ = np.histogram2d(col_arr, row_arr, bins=(80, 336), range=[[1, 80], [1, 336]])
         self.assertTrue(np.all(occ_hist_cpp == occ_hist_python))
 
+    def test_hit_histograming_invalid_hits(self):  # a batch with an invalid hit has to raise the out of range error and must not change the histograms
+        hits = np.zeros((200, ), dtype=tb.dtype_from_descr(data_struct.HitInfoTable))
+        hits['column'], hits['row'], hits['tot'] = 1, 1, 5
+        hits[150]['row'] = 337
+        histograming = PyDataHistograming()
+        histograming.set_no_scan_parameter()
+        histograming.create_occupancy_hist(True)
+        histograming.create_tot_hist(True)
+        with self.assertRaises(IndexError) as context:
+            histograming.add_hits(hits)
+        self.assertEqual(str(context.exception), 'Row index out of range.')
+        self.assertEqual(histograming.get_occupancy().sum(), 0)
+        self.assertEqual(histograming.get_tot_hist().sum(), 0)
+        hits[150]['row'] = 336
+        histograming.add_hits(hits)
+        self.assertEqual(histograming.get_occupancy()[0, 0, 0], 199)
+        self.assertEqual(histograming.get_occupancy()[0, 335, 0], 1)
+        self.assertEqual(histograming.get_tot_hist()[5], 200)
+
+    def test_hit_histograming_mean_tot(self):  # check the mean ToT and ToT RMS calculated from the per pixel ToT sums
+        hits = np.zeros((4, ), dtype=tb.dtype_from_descr(data_struct.HitInfoTable))
+        hits['column'], hits['row'], hits['tot'] = 1, 1, [2, 4, 4, 4]
+        hits[3]['row'] = 2
+        histograming = PyDataHistograming()
+        histograming.set_no_scan_parameter()
+        histograming.create_mean_tot_hist(True)
+        histograming.add_hits(hits)
+        mean_tot, tot_rms = histograming.get_mean_tot(), histograming.get_tot_rms()
+        self.assertAlmostEqual(mean_tot[0, 0, 0], 10. / 3., places=6)
+        self.assertAlmostEqual(tot_rms[0, 0, 0], np.std([2, 4, 4]), places=6)
+        self.assertEqual(mean_tot[0, 1, 0], 4)
+        self.assertEqual(tot_rms[0, 1, 0], 0)
+        self.assertTrue(np.isnan(mean_tot[1, 0, 0]) and np.isnan(tot_rms[1, 0, 0]))
+        histograming = PyDataHistograming()  # disabled mean ToT histogram
+        histograming.set_no_scan_parameter()
+        histograming.add_hits(hits)
+        self.assertIsNone(histograming.get_mean_tot())
+        self.assertIsNone(histograming.get_tot_rms())
+
+    def test_hit_histograming_multi_threaded(self):  # the multi-threaded histograming has to give exactly the single-threaded result
+        np.random.seed(0)
+        hits = np.zeros((400000, ), dtype=tb.dtype_from_descr(data_struct.HitInfoTable))
+        hits['event_number'] = np.arange(hits.shape[0]) // 4
+        hits['column'], hits['row'] = np.random.randint(1, 81, hits.shape[0]), np.random.randint(1, 337, hits.shape[0])
+        hits['tot'], hits['relative_BCID'] = np.random.randint(0, 16, hits.shape[0]), np.random.randint(0, 16, hits.shape[0])
+        hits['TDC'], hits['TDC_time_stamp'] = np.random.randint(0, 4096, hits.shape[0]), np.random.randint(0, 256, hits.shape[0])
+        hits['event_status'][::100] = 2048  # virtual hits (no hit event status) are ignored
+        for n_parameters in (2, 16):  # thread private partial histograms and disjoint parameter slices
+            parameters = np.arange(n_parameters, dtype=np.int32)
+            meta_event_index = np.linspace(0, hits['event_number'][-1], n_parameters, endpoint=False).astype(np.uint64)
+            results = []
+            for n_threads in (1, 4):
+                histograming = PyDataHistograming()
+                histograming.set_n_threads(n_threads)
+                histograming.create_occupancy_hist(True)
+                histograming.create_mean_tot_hist(True)
+                histograming.create_rel_bcid_hist(True)
+                histograming.create_tot_hist(True)
+                histograming.create_tdc_hist(True)
+                histograming.create_tdc_distance_hist(True)
+                histograming.add_meta_event_index(meta_event_index, meta_event_index.shape[0])
+                histograming.add_scan_parameter(parameters)
+                histograming.add_hits(hits[:200000])
+                histograming.add_hits(hits[200000:])
+                results.append((histograming.get_occupancy().copy(), histograming.get_mean_tot(), histograming.get_tot_rms(), histograming.get_rel_bcid_hist().copy(), histograming.get_tot_hist().copy(), histograming.get_tdc_hist().copy(), histograming.get_tdc_distance_hist().copy()))  # copy the arrays that are views of the histogrammer memory
+            self.assertEqual(results[0][0].sum(), np.count_nonzero(hits['tot'][hits['event_status'] == 0] <= 13))
+            for single_threaded, multi_threaded in zip(*results):
+                np.testing.assert_array_equal(single_threaded, multi_threaded)
+
+    def test_hit_histograming_sparse_occupancy(self):  # the sparse occupancy storage has to give the dense result with memory for the touched tiles only
+        np.random.seed(0)
+        n_parameters = 200
+        hits = np.zeros((20000, ), dtype=tb.dtype_from_descr(data_struct.HitInfoTable))
+        hits['event_number'] = np.arange(hits.shape[0]) // 2
+        hits['column'], hits['row'] = np.random.randint(1, 3, hits.shape[0]), np.random.randint(1, 3, hits.shape[0])
+        hits['tot'] = np.random.randint(0, 14, hits.shape[0])
+        parameters = np.arange(n_parameters, dtype=np.int32)
+        meta_event_index = np.linspace(0, hits['event_number'][-1], n_parameters, endpoint=False).astype(np.uint64)
+        results, memory = [], []
+        for sparse in (False, True):
+            histograming = PyDataHistograming()
+            histograming.set_sparse_occupancy(sparse)
+            histograming.create_occupancy_hist(True)
+            histograming.create_mean_tot_hist(True)
+            histograming.add_meta_event_index(meta_event_index, meta_event_index.shape[0])
+            histograming.add_scan_parameter(parameters)
+            histograming.add_hits(hits)
+            threshold, noise = np.zeros(80 * 336, dtype=np.float64), np.zeros(80 * 336, dtype=np.float64)
+            histograming.calculate_threshold_scan_arrays(threshold, noise, 100, 0, n_parameters - 1)
+            results.append((histograming.get_occupancy().copy(), histograming.get_mean_tot(), histograming.get_tot_rms(), threshold, noise))
+            memory.append(histograming.get_occupancy_memory())
+        for dense_result, sparse_result in zip(*results):
+            np.testing.assert_array_equal(dense_result, sparse_result)
+        self.assertEqual(results[1][0].sum(), hits.shape[0])
+        self.assertLess(memory[1], memory[0] / 50)
+
+    def test_hit_histograming_pixel_major_occupancy(self):  # the pixel-major layout has to give the parameter-major results for all storage and thread options
+        np.random.seed(0)
+        hits = np.zeros((200000, ), dtype=tb.dtype_from_descr(data_struct.HitInfoTable))
+        hits['event_number'] = np.arange(hits.shape[0]) // 2
+        hits['column'], hits['row'] = np.random.randint(1, 81, hits.shape[0]), np.random.randint(1, 337, hits.shape[0])
+        hits['tot'] = np.random.randint(0, 16, hits.shape[0])
+        for n_parameters in (3, 16):  # thread private partial histograms and disjoint parameter slices
+            parameters = np.arange(n_parameters, dtype=np.int32)
+            meta_event_index = np.linspace(0, hits['event_number'][-1], n_parameters, endpoint=False).astype(np.uint64)
+            results = []
+            for pixel_major, sparse, n_threads in ((False, False, 1), (True, False, 1), (True, True, 1), (True, False, 4), (True, True, 4)):
+                histograming = PyDataHistograming()
+                histograming.set_n_threads(n_threads)
+                histograming.set_pixel_major_occupancy(pixel_major)
+                histograming.set_sparse_occupancy(sparse)
+                histograming.create_occupancy_hist(True)
+                histograming.create_mean_tot_hist(True)
+                histograming.add_meta_event_index(meta_event_index, meta_event_index.shape[0])
+                histograming.add_scan_parameter(parameters)
+                self.assertEqual(histograming.get_pixel_major_occupancy(), pixel_major)
+                histograming.start_live_threshold(10, 0, n_parameters - 1)
+                histograming.add_hits(hits)
+                for _ in range(n_parameters):
+                    histograming.add_live_threshold_step()
+                threshold, noise, live_threshold, live_noise, fit_threshold, fit_noise, chi2 = [np.zeros(80 * 336, dtype=np.float64) for _ in range(7)]
+                status = np.zeros(80 * 336, dtype=np.uint8)
+                histograming.calculate_threshold_scan_arrays(threshold, noise, 10, 0, n_parameters - 1)
+                histograming.get_live_threshold(live_threshold, live_noise)
+                histograming.fit_scurves(fit_threshold, fit_noise, chi2, status, 10, 0, n_parameters - 1)
+                results.append((histograming.get_occupancy().copy(), histograming.get_mean_tot(), histograming.get_tot_rms(), threshold, noise, live_threshold, live_noise, fit_threshold, fit_noise, chi2, status))
+            self.assertEqual(results[0][0].sum(), np.count_nonzero(hits['tot'] <= 13))
+            for result in results[1:]:
+                for parameter_major_array, array in zip(results[0], result):
+                    np.testing.assert_array_equal(parameter_major_array, array)
+
+    def test_hit_histograming_snapshots(self):  # the snapshots have to equal the histograms at the time they were taken and have to stay unchanged while filling continues
+        np.random.seed(0)
+        hits = np.zeros((3000, ), dtype=tb.dtype_from_descr(data_struct.HitInfoTable))
+        hits['event_number'] = np.arange(hits.shape[0])
+        hits['column'], hits['row'] = np.random.randint(1, 81, hits.shape[0]), np.random.randint(1, 337, hits.shape[0])
+        hits['tot'], hits['relative_BCID'] = np.random.randint(0, 14, hits.shape[0]), np.random.randint(0, 16, hits.shape[0])
+        hits['TDC'] = np.random.randint(0, 4096, hits.shape[0])
+        parameters = np.arange(4, dtype=np.int32)
+        meta_event_index = np.array([0, 800, 1600, 2400], dtype=np.uint64)
+        for pixel_major, sparse in ((False, False), (True, False), (True, True)):
+            histograming = PyDataHistograming()
+            histograming.set_pixel_major_occupancy(pixel_major)
+            histograming.set_sparse_occupancy(sparse)
+            histograming.create_occupancy_hist(True)
+            histograming.create_tot_hist(True)
+            histograming.create_rel_bcid_hist(True)
+            histograming.create_tdc_pixel_hist(True)
+            histograming.set_tdc_pixel_hist_bin_width(64)
+            histograming.create_mean_tot_hist(True)
+            histograming.create_tot_pixel_hist(True)
+            histograming.create_tdc_pixel_moments(True)
+            histograming.add_meta_event_index(meta_event_index, meta_event_index.shape[0])
+            histograming.add_scan_parameter(parameters)
+            with self.assertRaises(RuntimeError):  # snapshots not created
+                histograming.take_snapshot()
+            histograming.create_snapshots(True)
+            snapshots = []
+            for batch in (hits[:1000], hits[1000:1500], hits[1500:]):  # the buffers rotate, every publishing copies only the tiles changed since its buffer was written
+                histograming.add_hits(batch)
+                histograming.take_snapshot()
+                expected = (histograming.get_occupancy().copy(), histograming.get_tot_hist().copy(), histograming.get_rel_bcid_hist().copy(), histograming.get_tdc_pixel_hist().copy(), histograming.get_tot_pixel_hist().copy(), histograming.get_mean_tot(), histograming.get_tot_rms()) + histograming.get_tdc_pixel_moments()
+                snapshot = (histograming.get_snapshot_occupancy(), histograming.get_snapshot_tot_hist(), histograming.get_snapshot_rel_bcid_hist(), histograming.get_snapshot_tdc_pixel_hist(), histograming.get_snapshot_tot_pixel_hist()) + histograming.get_snapshot_mean_tot() + histograming.get_snapshot_tdc_pixel_moments()
+                for expected_array, snapshot_array in zip(expected, snapshot):
+                    np.testing.assert_array_equal(expected_array, snapshot_array)
+                if snapshots:  # the previous snapshot is not changed by the filling and the new snapshot
+                    for expected_array, snapshot_array in zip(*snapshots[-1]):
+                        np.testing.assert_array_equal(expected_array, snapshot_array)
+                snapshots.append((expected, snapshot))
+            self.assertEqual(histograming.get_n_snapshots(), 3)
+            self.assertIsNone(histograming.get_snapshot_tdc_hist())  # not enabled histogram
+            del snapshots, snapshot  # views of the snapshot buffers
+            histograming.set_n_chips(2)  # the snapshots of the old module layout are cleared
+            self.assertIsNone(histograming.get_snapshot_occupancy())
+            self.assertIsNone(histograming.get_snapshot_tot_hist())
+            self.assertIsNone(histograming.get_snapshot_mean_tot())
+            histograming.add_hits(hits[:0])  # publishes the histograms of the new layout
+            histograming.take_snapshot()
+            self.assertTupleEqual(histograming.get_snapshot_occupancy().shape, (160, 336, 4))
+            self.assertEqual(histograming.get_snapshot_occupancy().sum(), 0)
+
+    def test_hit_histograming_concurrent_snapshots(self):  # snapshots taken while another thread fills have to be consistent, i.e. equal the histograms after one of the batches
+        np.random.seed(0)
+        hits = np.zeros((2000000, ), dtype=tb.dtype_from_descr(data_struct.HitInfoTable))
+        hits['event_number'] = np.arange(hits.shape[0])
+        hits['column'], hits['row'] = np.random.randint(1, 81, hits.shape[0]), np.random.randint(1, 337, hits.shape[0])
+        hits['tot'] = np.random.randint(0, 14, hits.shape[0])
+        batches = np.array_split(hits, 20)  # two threads per batch, every batch has hits of more than two parameters
+        for pixel_major, n_threads in ((False, 1), (True, 4)):  # the pixel-major layout with many parameters fills tiles shared by the threads
+            histograming = PyDataHistograming()
+            histograming.set_n_threads(n_threads)
+            histograming.set_pixel_major_occupancy(pixel_major)
+            histograming.create_occupancy_hist(True)
+            histograming.create_mean_tot_hist(True)
+            histograming.create_tot_hist(True)
+            histograming.create_tot_pixel_hist(True)
+            meta_event_index = np.linspace(0, hits.shape[0], 64, endpoint=False).astype(np.uint64)
+            histograming.add_meta_event_index(meta_event_index, meta_event_index.shape[0])
+            histograming.add_scan_parameter(np.arange(64, dtype=np.int32))
+            histograming.create_snapshots(True)
+
+            def fill():
+                for batch in batches:
+                    histograming.add_hits(batch)
+
+            filler = threading.Thread(target=fill)
+            filler.start()
+            n_hits = []
+            while filler.is_alive() or not n_hits:
+                histograming.take_snapshot()
+                occupancy, tot_hist, tot_pixel_hist = histograming.get_snapshot_occupancy(), histograming.get_snapshot_tot_hist(), histograming.get_snapshot_tot_pixel_hist()
+                self.assertEqual(occupancy.sum(), tot_hist.sum())  # histograms of the same batches
+                self.assertEqual(occupancy.sum(), tot_pixel_hist.sum())
+                self.assertIn(occupancy.sum(), np.cumsum([0] + [batch.shape[0] for batch in batches]))  # no partially filled batch
+                self.assertTrue(np.array_equal(occupancy.sum(axis=2), tot_pixel_hist.sum(axis=2)))
+                n_hits.append(occupancy.sum())
+            filler.join()
+            histograming.take_snapshot()
+            np.testing.assert_array_equal(histograming.get_snapshot_occupancy(), histograming.get_occupancy())
+            np.testing.assert_array_equal(histograming.get_snapshot_mean_tot()[0], histograming.get_mean_tot())
+            self.assertTrue(np.all(np.diff(n_hits) >= 0))
+
+    def test_hit_histograming_merge(self):  # merged segments with different parameter sets have to give the histograms of the whole run
+        np.random.seed(0)
+        hits = np.zeros((6000, ), dtype=tb.dtype_from_descr(data_struct.HitInfoTable))
+        hits['event_number'] = np.arange(hits.shape[0]) // 2
+        hits['column'], hits['row'] = np.random.randint(1, 81, hits.shape[0]), np.random.randint(1, 337, hits.shape[0])
+        hits['tot'], hits['relative_BCID'] = np.random.randint(0, 14, hits.shape[0]), np.random.randint(0, 16, hits.shape[0])
+        hits['TDC'] = np.random.randint(0, 2048, hits.shape[0])
+        event_parameter = np.arange(3000) // 500  # six parameters with the values 10, 20, ..., 60
+        scan_parameters = []
+
+        def histogram(hits, pixel_major=False, sparse=False, mean_tot=True):
+            parameter_index = np.unique(event_parameter[hits['event_number']])
+            meta_event_index = np.array([np.min(hits['event_number'][event_parameter[hits['event_number']] == index]) for index in parameter_index], dtype=np.uint64)
+            scan_parameters.append(meta_event_index)  # the histogrammer keeps a pointer to the meta event index array
+            histograming = PyDataHistograming()
+            histograming.set_pixel_major_occupancy(pixel_major)
+            histograming.set_sparse_occupancy(sparse)
+            histograming.create_occupancy_hist(True)
+            histograming.create_mean_tot_hist(mean_tot)
+            histograming.create_tot_hist(True)
+            histograming.create_rel_bcid_hist(True)
+            histograming.create_tdc_pixel_hist(True)
+            histograming.set_tdc_pixel_hist_bin_width(16)
+            histograming.create_tdc_pixel_moments(True)
+            histograming.add_meta_event_index(meta_event_index, meta_event_index.shape[0])
+            scan_parameters.append(np.arange(parameter_index.shape[0], dtype=np.int32))  # the histogrammer keeps a pointer to the scan parameter array
+            histograming.add_scan_parameter(scan_parameters[-1])
+            histograming.set_parameter_values(((parameter_index + 1) * 10).astype(np.int32))
+            histograming.add_hits(hits)
+            return histograming
+
+        def results(histograming):
+            return (histograming.get_parameter_values(), histograming.get_occupancy().copy(), histograming.get_mean_tot(), histograming.get_tot_rms(), histograming.get_tot_hist().copy(), histograming.get_rel_bcid_hist().copy(), histograming.get_tdc_pixel_hist().copy()) + histograming.get_tdc_pixel_moments()
+
+        expected = results(histogram(hits))
+        np.testing.assert_array_equal(expected[0], [10, 20, 30, 40, 50, 60])
+        segments = (hits[:2400], hits[2400:4400], hits[4400:])  # the segments share the parameters 30 and 50
+        merged = reduce_histogramings([histogram(segments[0], pixel_major=True), histogram(segments[1], sparse=True), histogram(segments[2])])
+        for expected_array, array in zip(expected, results(merged)):
+            np.testing.assert_array_equal(expected_array, array)
+
+        histograming = histogram(segments[2])  # merge the serialized segments in the reverse order
+        histograming.merge_bytes(histogram(segments[1], pixel_major=True, sparse=True).to_bytes())
+        histograming.merge(histogram(segments[0]))
+        for expected_array, array in zip(expected, results(histograming)):
+            np.testing.assert_array_equal(expected_array, array)
+        with self.assertRaises(ValueError):
+            histograming.merge_bytes(histograming.to_bytes()[:-1])
+        with self.assertRaises(ValueError):
+            histograming.merge(histograming)
+        histograming.add_hits(segments[2])  # the scan parameter indices of the segment (50, 60) are mapped to the merged parameters
+        segment = histogram(segments[2])  # the occupancy array is owned by the histogrammer
+        occupancy = expected[1].copy()
+        occupancy[:, :, 4:] += segment.get_occupancy()
+        np.testing.assert_array_equal(histograming.get_occupancy(), occupancy)
+
+        with self.assertRaises(ValueError):  # the mean ToT cannot be merged without ToT sums, nothing is merged
+            reduce_histogramings([histogram(segments[0]), histogram(segments[1]), histogram(segments[2], mean_tot=False)])
+        with self.assertRaises(ValueError):
+            histogram(segments[0]).merge(histogram(segments[1], mean_tot=False))
+
+        histogramings = []
+        for _ in range(2):  # ToT pixel histogram bins saturate in merge
+            histograming = PyDataHistograming()
+            histograming.create_tot_pixel_hist(True)
+            histograming.set_no_scan_parameter()
+            histograming.add_hits(np.repeat(hits[:2], 40000))
+            histogramings.append(histograming)
+        tot_pixel_hist = reduce_histogramings(histogramings).get_tot_pixel_hist()
+        self.assertEqual(tot_pixel_hist[hits[0]['column'] - 1, hits[0]['row'] - 1, hits[0]['tot']], np.iinfo(np.uint16).max)
+        self.assertEqual(tot_pixel_hist.sum(), 2 * np.iinfo(np.uint16).max)
+
+    def test_hit_histograming_storage_file(self):  # the memory-mapped histogram files have to hold the live histograms and have to be resumable
+        np.random.seed(0)
+        hits = np.zeros((4000, ), dtype=tb.dtype_from_descr(data_struct.HitInfoTable))
+        hits['event_number'] = np.arange(hits.shape[0])
+        hits['column'], hits['row'] = np.random.randint(1, 81, hits.shape[0]), np.random.randint(1, 337, hits.shape[0])
+        hits['tot'], hits['TDC'] = np.random.randint(0, 14, hits.shape[0]), np.random.randint(0, 2048, hits.shape[0])
+        parameters = np.arange(2, dtype=np.int32)
+        meta_event_index = np.array([0, 2000], dtype=np.uint64)
+        storage_file = os.path.join(tempfile.mkdtemp(), 'run')
+
+        def histogram(hits, resume, parameters=parameters):
+            histograming = PyDataHistograming()
+            histograming.set_sparse_occupancy(True)  # memory-mapped histograms are dense
+            histograming.set_storage_file(storage_file, resume)
+            self.assertFalse(histograming.get_sparse_occupancy())
+            histograming.create_occupancy_hist(True)
+            histograming.create_mean_tot_hist(True)
+            histograming.set_tdc_pixel_hist_bin_width(64)  # before the histogram is enabled, otherwise the file is reset by the default binning
+            histograming.create_tdc_pixel_hist(True)
+            histograming.add_meta_event_index(meta_event_index, meta_event_index.shape[0])
+            histograming.add_scan_parameter(parameters)
+            histograming.add_hits(hits)
+            return histograming
+
+        try:
+            histograming = histogram(hits[:3000], False)
+            self.assertEqual(histograming.get_storage_file(), storage_file)
+            header = np.fromfile(storage_file + '_occupancy.dat', dtype=np.uint32, count=10)
+            self.assertListEqual(header.tolist(), [0x46534948, 2, 4, 2, 0, 64, 2 * 80 * 336, 0, 0, 1])  # ..., header size, number of entries (uint64), parameter values
+            occupancy_file = np.memmap(storage_file + '_occupancy.dat', dtype=np.uint32, mode='r', offset=64, shape=(80, 336, 2), order='F')  # other process view
+            tdc_pixel_file = np.memmap(storage_file + '_tdc_pixel.dat', dtype=np.uint16, mode='r', offset=64, shape=(80, 336, 32), order='F')
+            np.testing.assert_array_equal(occupancy_file, histograming.get_occupancy())
+            np.testing.assert_array_equal(tdc_pixel_file, histograming.get_tdc_pixel_hist())
+            histograming.add_hits(hits[3000:])  # live update of the file
+            self.assertEqual(occupancy_file.sum(), 4000)
+            expected = (histograming.get_occupancy().copy(), histograming.get_mean_tot(), histograming.get_tdc_pixel_hist().copy())
+            del histograming, occupancy_file, tdc_pixel_file
+
+            histograming = histogram(hits[:0], True)  # resume from the files
+            for expected_array, array in zip(expected, (histograming.get_occupancy(), histograming.get_mean_tot(), histograming.get_tdc_pixel_hist())):
+                np.testing.assert_array_equal(expected_array, array)
+            with self.assertRaises(ValueError):
+                histograming.set_sparse_occupancy(True)
+            del histograming
+            other_parameters = np.array([3, 4], dtype=np.int32)
+            histograming = histogram(hits[:0], True, other_parameters)  # same layout, other parameter values: not resumed
+            self.assertEqual(histograming.get_occupancy().sum(), 0)
+            del histograming
+            histograming = PyDataHistograming()
+            histograming.create_occupancy_hist(True)
+            histograming.set_no_scan_parameter()
+            with self.assertRaises(RuntimeError):  # the heap histograms would be replaced by the file content
+                histograming.set_storage_file(storage_file, True)
+            histograming.set_storage_file(storage_file, False)
+            del histograming
+            histograming = histogram(hits[:0], False)
+            self.assertEqual(histograming.get_occupancy().sum(), 0)
+            del histograming
+        finally:
+            shutil.rmtree(os.path.dirname(storage_file))
+
+    def test_hit_histograming_module(self):  # a module histogram filled in one pass has to equal the stitched chip histograms
+        np.random.seed(0)
+        raw_data = np.array([67307647, 67645759, 67660079, 67541711, 67718111, 67913663, 67914223, 67847647, 67978655, 68081199, 68219119, 68219487], np.uint32)
+        chip_hits, module_hits = [], []
+        for chip in range(4):
+            interpreter = PyDataInterpreter()
+            interpreter.set_trig_count(1)
+            interpreter.set_warning_output(False)
+            interpreter.interpret_raw_data(raw_data)
+            interpreter.store_event()
+            chip_hits.append(interpreter.get_hits().copy())
+            interpreter = PyDataInterpreter()  # same raw data decoded into module coordinates
+            interpreter.set_trig_count(1)
+            interpreter.set_warning_output(False)
+            interpreter.set_module_chip(4, chip)
+            interpreter.interpret_raw_data(raw_data)
+            interpreter.store_event()
+            module_hits.append(interpreter.get_hits().copy())
+        for chip in range(4):  # additional random hits, converted to module coordinates here
+            hits = np.zeros((2000, ), dtype=tb.dtype_from_descr(data_struct.HitInfoTable))
+            hits['column'], hits['row'], hits['tot'] = np.random.randint(1, 81, hits.shape[0]), np.random.randint(1, 337, hits.shape[0]), np.random.randint(0, 14, hits.shape[0])
+            hits['TDC'] = np.random.randint(0, 4096, hits.shape[0])
+            chip_hits[chip] = np.concatenate((chip_hits[chip], hits))
+            hits = hits.copy()
+            if chip < 2:
+                hits['column'] += chip * 80
+            else:
+                hits['column'], hits['row'] = (4 - chip) * 80 + 1 - hits['column'], 673 - hits['row']
+            module_hits[chip] = np.concatenate((module_hits[chip], hits))
+        self.assertTrue(np.all(module_hits[2]['column'][:10] == 161 - chip_hits[2]['column'][:10]) and np.all(module_hits[2]['row'][:10] == 673 - chip_hits[2]['row'][:10]))
+
+        def histogram(hits, n_chips):
+            histograming = PyDataHistograming()
+            histograming.set_n_chips(n_chips)
+            histograming.set_no_scan_parameter()
+            histograming.create_occupancy_hist(True)
+            histograming.create_tot_pixel_hist(True)
+            histograming.create_tdc_pixel_hist(True)
+            histograming.set_tdc_pixel_hist_bin_width(64)
+            histograming.create_tdc_pixel_moments(True)
+            histograming.add_hits(hits)
+            return histograming
+
+        def results(histograming):
+            return (histograming.get_occupancy().copy(), histograming.get_tot_pixel_hist().copy(), histograming.get_tdc_pixel_hist().copy(), histograming.get_tdc_pixel_moments()[0])
+
+        module = histogram(np.concatenate(module_hits), 4)
+        self.assertEqual((module.get_n_chips(), module.get_n_columns(), module.get_n_rows()), (4, 160, 672))
+        chips = [results(histogram(hits, 1)) for hits in chip_hits]
+        for index, array in enumerate(results(module)):
+            stitched = np.zeros_like(array)
+            stitched[:80, :336], stitched[80:, :336] = chips[0][index], chips[1][index]
+            stitched[80:, 336:], stitched[:80, 336:] = chips[2][index][::-1, ::-1], chips[3][index][::-1, ::-1]
+            np.testing.assert_array_equal(stitched, array)
+        merged = histogram(module_hits[0][:0], 4)
+        merged.merge_bytes(module.to_bytes())
+        np.testing.assert_array_equal(module.get_occupancy(), merged.get_occupancy())
+
+        two_chip = histogram(np.concatenate(module_hits[:2]), 2)
+        np.testing.assert_array_equal(two_chip.get_occupancy(), np.concatenate((chips[0][0], chips[1][0])))
+        with self.assertRaises(IndexError):  # rows of the upper chips are outside of a 2-chip module
+            two_chip.add_hits(module_hits[2])
+        with self.assertRaises(ValueError):
+            two_chip.merge(module)
+        with self.assertRaises(ValueError):
+            two_chip.set_n_chips(3)
+        with self.assertRaises(IndexError):
+            PyDataInterpreter().set_module_chip(2, 2)
+
+    def test_pixel_mask(self):  # hits of masked pixels have to be dropped during decoding and histogramming and counted per pixel
+        raw_data = np.array([67307647, 67645759, 67660079, 67541711, 67718111, 67913663, 67914223, 67847647, 67978655, 68081199, 68219119, 68219487], np.uint32)
+        interpreter = PyDataInterpreter()
+        interpreter.set_trig_count(1)
+        interpreter.set_warning_output(False)
+        interpreter.interpret_raw_data(raw_data)
+        interpreter.store_event()
+        hits = interpreter.get_hits().copy()
+        mask = np.zeros((80, 336), dtype=np.bool_)
+        mask[hits['column'][:3] - 1, hits['row'][:3] - 1] = True
+        interpreter = PyDataInterpreter()
+        interpreter.set_trig_count(1)
+        interpreter.set_warning_output(False)
+        interpreter.set_pixel_mask(mask)
+        interpreter.interpret_raw_data(raw_data)
+        interpreter.store_event()
+        masked_hits = interpreter.get_hits().copy()
+        is_masked = mask[hits['column'] - 1, hits['row'] - 1]
+        np.testing.assert_array_equal(masked_hits[['column', 'row', 'tot']], hits[~is_masked][['column', 'row', 'tot']])
+        self.assertEqual(interpreter.get_n_dropped_hits(), np.count_nonzero(is_masked))
+        dropped_hits = np.zeros((80, 336), dtype=np.uint32)
+        np.add.at(dropped_hits, (hits['column'][is_masked] - 1, hits['row'][is_masked] - 1), 1)
+        np.testing.assert_array_equal(interpreter.get_dropped_hits(), dropped_hits)
+        with self.assertRaises(ValueError):  # the mask has to have the module geometry
+            interpreter.set_pixel_mask(np.zeros((160, 336)))
+
+        np.random.seed(0)
+        hits = np.zeros((200000, ), dtype=tb.dtype_from_descr(data_struct.HitInfoTable))
+        hits['event_number'] = np.arange(hits.shape[0]) // 4
+        hits['column'], hits['row'] = np.random.randint(1, 81, hits.shape[0]), np.random.randint(1, 337, hits.shape[0])
+        hits['tot'], hits['TDC'] = np.random.randint(0, 14, hits.shape[0]), np.random.randint(0, 4096, hits.shape[0])
+        mask = np.random.random((80, 336)) < 0.05
+        for n_threads in (1, 4):
+            results = []
+            for pixel_mask in (None, mask):
+                histograming = PyDataHistograming()
+                histograming.set_n_threads(n_threads)
+                histograming.set_pixel_mask(pixel_mask)
+                histograming.set_no_scan_parameter()
+                histograming.create_occupancy_hist(True)
+                histograming.create_tot_hist(True)
+                histograming.create_tdc_pixel_moments(True)
+                histograming.create_tot_pixel_hist(True)
+                histograming.add_hits(hits)
+                results.append((histograming.get_occupancy()[:, :, 0].copy(), histograming.get_tot_hist().copy(), histograming.get_tdc_pixel_moments()[0], histograming.get_dropped_hits(), histograming.get_tot_pixel_hist().sum(axis=2)))
+            occupancy = results[0][0]
+            np.testing.assert_array_equal(results[1][0], np.where(mask, 0, occupancy))
+            np.testing.assert_array_equal(results[1][2], np.where(mask, 0, occupancy))
+            np.testing.assert_array_equal(results[1][4], np.where(mask, 0, occupancy))
+            histograming.add_hits(hits[mask[hits['column'] - 1, hits['row'] - 1]])  # only masked hits
+            np.testing.assert_array_equal(histograming.get_occupancy()[:, :, 0], results[1][0])
+            self.assertEqual(histograming.get_n_dropped_hits(), 2 * occupancy[mask].sum())
+            histograming.add_hits(hits[~mask[hits['column'] - 1, hits['row'] - 1]])  # no masked hit
+            np.testing.assert_array_equal(histograming.get_occupancy()[:, :, 0], 2 * results[1][0])
+            np.testing.assert_array_equal(results[1][3], np.where(mask, occupancy, 0))
+            self.assertEqual(results[1][1].sum(), occupancy[~mask].sum())
+            histograming.reset()
+            self.assertEqual(histograming.get_n_dropped_hits(), 0)
+            histograming.set_n_chips(2)  # a new geometry clears the mask
+            self.assertEqual(histograming.get_dropped_hits().sum(), 0)
+
+    def test_noisy_pixel_detection(self):  # a noisy pixel has to be flagged from the meta data time stamps and auto-masked during decoding
+        np.random.seed(0)
+        raw_data, meta_data = [], np.zeros((40, ), dtype=tb.dtype_from_descr(data_struct.MetaTableV2))
+        for readout in range(meta_data.shape[0]):  # one readout per second with random hits and 30 hits of the noisy pixel column 10, row 20
+            columns, rows = np.append(np.random.randint(1, 81, 50), [10] * 30), np.append(np.random.randint(1, 337, 50), [20] * 30)
+            words = [0x00E90000 | readout] + list((columns << 17) | (rows << 8) | (5 << 4) | 0xF)
+            meta_data[readout] = (len(raw_data), len(raw_data) + len(words), len(words), readout, readout + 0.5, 0)
+            raw_data.extend(words)
+        raw_data = np.array(raw_data, dtype=np.uint32)
+
+        def interpret(**kwargs):
+            interpreter = PyDataInterpreter()
+            interpreter.set_trig_count(1)
+            interpreter.set_warning_output(False)
+            interpreter.set_info_output(False)
+            interpreter.set_noisy_pixel_detection(4., **kwargs)
+            interpreter.set_meta_data(meta_data)
+            interpreter.set_meta_event_data(np.zeros((meta_data.shape[0], ), dtype=np.uint64))
+            interpreter.interpret_raw_data(raw_data)
+            interpreter.store_event()
+            return interpreter, interpreter.get_hits().copy()
+
+        for kwargs in ({'max_sigma': 5.}, {'max_sigma': 0., 'max_rate': 20.}):
+            interpreter, hits = interpret(**kwargs)
+            noisy_pixels = interpreter.get_noisy_pixels()
+            self.assertEqual(interpreter.get_n_noisy_pixels(), 1)
+            self.assertTrue(noisy_pixels[9, 19])
+            self.assertEqual(np.count_nonzero((hits['column'] == 10) & (hits['row'] == 20)), 30 * meta_data.shape[0])  # only flagged, not masked
+        interpreter, hits = interpret(auto_mask=True)
+        self.assertTrue(interpreter.get_noisy_pixels()[9, 19])
+        n_noisy_hits = np.count_nonzero((hits['column'] == 10) & (hits['row'] == 20))
+        self.assertTrue(0 < n_noisy_hits < 30 * 5)  # masked after the first window
+        self.assertEqual(interpreter.get_n_dropped_hits() + n_noisy_hits, 30 * meta_data.shape[0])
+        self.assertEqual(interpreter.get_dropped_hits()[9, 19], interpreter.get_n_dropped_hits())
+        interpreter, hits = interpret(max_sigma=0., max_rate=100.)  # below the rate limit
+        self.assertEqual(interpreter.get_n_noisy_pixels(), 0)
+        with self.assertRaises(ValueError):
+            interpreter.set_noisy_pixel_detection(4., max_sigma=0., max_rate=0.)
+
+    def test_decaying_occupancy(self):  # the lazily decayed occupancy has to equal the hits weighted with their age
+        np.random.seed(0)
+        hits = np.zeros((20000, ), dtype=tb.dtype_from_descr(data_struct.HitInfoTable))
+        hits['event_number'] = np.sort(np.random.randint(0, 50000, hits.shape[0]))
+        hits['column'], hits['row'] = np.random.randint(1, 81, hits.shape[0]), np.random.randint(1, 337, hits.shape[0])
+        hits['column'][::2], hits['row'][::2] = np.random.randint(1, 5, hits.shape[0] // 2), np.random.randint(1, 5, hits.shape[0] // 2)  # hot spot to rescale tiles often
+        for half_life in (10., 1000.):  # 10: the decay origin is moved several times
+            histograming = PyDataHistograming()
+            histograming.set_info_output(False)
+            histograming.set_no_scan_parameter()
+            histograming.create_decaying_occupancy_hist(True)
+            histograming.set_occupancy_half_life(half_life)
+            self.assertEqual(histograming.get_occupancy_half_life(), half_life)
+            for batch in np.array_split(hits, 9):
+                histograming.add_hits(batch)
+            expected = np.zeros((80, 336))
+            np.add.at(expected, (hits['column'] - 1, hits['row'] - 1), 2. ** ((hits['event_number'].astype(np.float64) - hits['event_number'][-1]) / half_life))
+            self.assertTrue(np.allclose(histograming.get_decaying_occupancy(), expected, rtol=1e-5, atol=1e-6))
+        histograming.set_occupancy_half_life(1e12)  # no decay
+        histograming.add_hits(hits)
+        self.assertTrue(np.allclose(histograming.get_decaying_occupancy(), np.histogram2d(hits['column'], hits['row'], bins=(80, 336), range=((0.5, 80.5), (0.5, 336.5)))[0], rtol=1e-5))
+        with self.assertRaises(ValueError):
+            histograming.set_occupancy_half_life(0.)
+
+    def test_time_histograming(self):  # the time histograms have to equal the hits binned by the read out time stamps
+        np.random.seed(0)
+        event_index = np.arange(0, 2000, 100, dtype=np.uint64)  # 20 read outs with 100 events each, 0.5 s per read out
+        time_stamps = 1000. + 0.5 * np.arange(event_index.shape[0])
+        hits = np.zeros((3000, ), dtype=tb.dtype_from_descr(data_struct.HitInfoTable))
+        hits['event_number'] = np.sort(np.random.randint(0, 2000, hits.shape[0]))
+        hits['column'], hits['row'], hits['tot'] = np.random.randint(1, 81, hits.shape[0]), np.random.randint(1, 337, hits.shape[0]), np.random.randint(0, 14, hits.shape[0])
+        event_status = np.random.choice([0, 2, 256, 256 | 32, 2048], 2000)  # same status for all hits of an event, 2048: event without hit
+        hits['event_status'] = event_status[hits['event_number']]
+
+        def histogram(n_bins, n_batches=1):
+            histograming = PyDataHistograming()
+            histograming.set_info_output(False)
+            histograming.set_no_scan_parameter()
+            histograming.add_meta_event_index(event_index, event_index.shape[0])
+            histograming.set_meta_time_stamps(time_stamps)
+            histograming.set_time_hist_binning(2., n_bins, 2, 3)
+            histograming.create_time_hist(True)
+            for batch in np.array_split(hits, n_batches):  # the batches split events
+                histograming.add_hits(batch)
+            return histograming
+
+        time_bin = (hits['event_number'] // 100) // 4
+        first_hits = np.r_[True, hits['event_number'][1:] != hits['event_number'][:-1]]  # one entry per event
+        real_hits = hits['event_status'] & 2048 == 0
+        start, events, n_hits, tdc, errors, regions = histogram(10).get_time_hist()
+        self.assertEqual(start, 1000.)
+        self.assertTrue(np.all(events == np.bincount(time_bin[first_hits], minlength=5)))
+        self.assertTrue(np.all(n_hits == np.bincount(time_bin[real_hits], minlength=5)))
+        self.assertTrue(np.all(tdc == np.bincount(time_bin[first_hits & (hits['event_status'] & 256 != 0)], minlength=5)))
+        for code in range(16):
+            self.assertTrue(np.all(errors[:, code] == np.bincount(time_bin[first_hits & (hits['event_status'] & (1 << code) != 0)], minlength=5)))
+        region = (hits['column'] - 1) * 2 // 80 + ((hits['row'] - 1) * 3 // 336) * 2
+        self.assertEqual(regions.shape, (2, 3, 5))
+        self.assertTrue(np.all(regions.reshape((6, 5), order='F') == np.array([np.bincount(time_bin[real_hits & (region == i)], minlength=5) for i in range(6)])))
+        histograming = histogram(3, n_batches=7)  # ring of 3 bins: the first 2 bins drop out
+        ring_start, ring_events, ring_hits, _, ring_errors, ring_regions = histograming.get_time_hist()
+        self.assertEqual(ring_start, 1004.)
+        self.assertTrue(np.all(ring_events == events[2:]) and np.all(ring_hits == n_hits[2:]) and np.all(ring_errors == errors[2:]) and np.all(ring_regions == regions[:, :, 2:]))
+        self.assertEqual(histograming.get_n_time_hist_lost_hits(), 0)
+        histograming.set_meta_time_stamps(time_stamps)  # restarts the read out search, the hits are older than the ring
+        histograming.add_hits(hits[:100])
+        self.assertEqual(histograming.get_n_time_hist_lost_hits(), np.count_nonzero(real_hits[:100]))
+        pixel_mask = np.zeros((80, 336), dtype=np.uint8)
+        pixel_mask[:40] = 1
+        histograming.set_pixel_mask(pixel_mask)
+        histograming.set_meta_time_stamps(time_stamps)
+        histograming.add_hits(hits[:100])  # masked hits are not counted as lost
+        self.assertEqual(histograming.get_n_time_hist_lost_hits(), np.count_nonzero(real_hits[:100]) + np.count_nonzero(real_hits[:100] & (hits['column'][:100] > 40)))
+        histograming.set_pixel_mask(None)
+        self.assertTrue(np.all(histograming.get_time_hist()[1] == events[2:]))
+        with self.assertRaises(ValueError):
+            histograming.set_time_hist_binning(0., 10)
+
+    def test_tdc_pixel_histograming(self):  # check the binned and sparse TDC pixel histogram and the TDC moments
+        hits = np.zeros((5, ), dtype=tb.dtype_from_descr(data_struct.HitInfoTable))
+        hits['column'], hits['row'], hits['TDC'] = 1, 1, [10, 11, 20, 100, 3000]
+        hits[3]['column'], hits[4]['column'] = 2, 3
+        histograming = PyDataHistograming()
+        histograming.set_no_scan_parameter()
+        histograming.create_tdc_pixel_hist(True)
+        histograming.create_tdc_pixel_moments(True)
+        with self.assertRaises(ValueError):
+            histograming.set_tdc_pixel_hist_bin_width(3)
+        histograming.set_tdc_pixel_hist_bin_width(8)
+        histograming.set_sparse_tdc_pixel_hist(True)
+        histograming.add_hits(hits)
+        tdc_pixel_hist = histograming.get_tdc_pixel_hist()
+        self.assertEqual(tdc_pixel_hist.shape, (80, 336, 256))
+        self.assertEqual(tdc_pixel_hist[0, 0, 1], 2)
+        self.assertEqual(tdc_pixel_hist[0, 0, 2], 1)
+        self.assertEqual(tdc_pixel_hist[1, 0, 12], 1)
+        self.assertEqual(tdc_pixel_hist[2, 0].sum(), 0)  # TDC values >= 2048 are not histogrammed
+        self.assertEqual(tdc_pixel_hist.sum(), 4)
+        self.assertLess(histograming.get_tdc_pixel_hist_memory(), 80 * 336 * 256 * 2 / 10)  # tile pointer table and two tiles
+        count, mean, rms, tdc_min, tdc_max = histograming.get_tdc_pixel_moments()
+        self.assertEqual(count[0, 0], 3)
+        self.assertAlmostEqual(mean[0, 0], 41. / 3., places=5)
+        self.assertAlmostEqual(rms[0, 0], np.std([10, 11, 20]), places=5)
+        self.assertEqual((tdc_min[0, 0], tdc_max[0, 0]), (10, 20))
+        self.assertEqual((count[2, 0], tdc_max[2, 0]), (1, 3000))
+        self.assertTrue(np.isnan(mean[0, 1]))
+
+    def test_threshold_scan_arrays(self):  # check the compiled threshold/noise calculation against the reference formula
+        np.random.seed(0)
+        n_parameters, n_injections, q_min, q_max = 20, 10, 0, 95
+        pixel_threshold = np.random.uniform(3, 16, (80, 40))  # threshold in parameter steps for the pixels of the first 40 rows
+        occupancy = np.zeros((80, 336, n_parameters), dtype=np.uint32)
+        for parameter in range(n_parameters):
+            occupancy[:, :40, parameter] = np.clip(np.round(n_injections * (parameter - pixel_threshold + 0.5)), 0, n_injections)
+        column, row, parameter = np.nonzero(occupancy)
+        n_hits = occupancy[column, row, parameter]
+        column, row, parameter = np.repeat(column, n_hits), np.repeat(row, n_hits), np.repeat(parameter, n_hits)
+        order = np.argsort(parameter, kind='mergesort')  # one event per hit, sorted by the scan parameter
+        column, row, parameter = column[order], row[order], parameter[order]
+        hits = np.zeros((parameter.shape[0], ), dtype=tb.dtype_from_descr(data_struct.HitInfoTable))
+        hits['event_number'], hits['column'], hits['row'] = np.arange(hits.shape[0]), column + 1, row + 1
+        meta_event_index = np.searchsorted(parameter, np.arange(n_parameters)).astype(np.uint64)
+        histograming = PyDataHistograming()
+        histograming.create_occupancy_hist(True)
+        histograming.add_meta_event_index(meta_event_index, meta_event_index.shape[0])
+        histograming.add_scan_parameter(np.arange(n_parameters, dtype=np.int32))
+        histograming.add_hits(hits)
+        np.testing.assert_array_equal(histograming.get_occupancy(), occupancy)
+        threshold, noise = np.zeros(80 * 336, dtype=np.float64), np.zeros(80 * 336, dtype=np.float64)
+        histograming.calculate_threshold_scan_arrays(threshold, noise, n_injections, q_min, q_max)
+        d = int((q_max - q_min) / (n_parameters - 1.))
+        threshold_reference = q_max - d * occupancy.sum(axis=2).astype(np.float64) / n_injections
+        below_threshold = np.arange(n_parameters)[np.newaxis, np.newaxis, :] * float(d) < threshold_reference[:, :, np.newaxis]
+        mu = np.where(below_threshold, occupancy, n_injections - occupancy.astype(np.int64)).sum(axis=2)
+        noise_reference = float(d) * mu / n_injections * np.sqrt(3.141592653589893238462643383 / 2)
+        np.testing.assert_allclose(threshold.reshape((80, 336), order='F'), threshold_reference, rtol=1e-12)
+        np.testing.assert_allclose(noise.reshape((80, 336), order='F'), noise_reference, rtol=1e-12)
+        # incremental threshold estimation while the scan is running, has to end with the same result
+        histograming = PyDataHistograming()
+        histograming.create_occupancy_hist(True)
+        histograming.add_meta_event_index(meta_event_index, meta_event_index.shape[0])
+        histograming.add_scan_parameter(np.arange(n_parameters, dtype=np.int32))
+        histograming.start_live_threshold(n_injections, q_min, q_max)
+        live_threshold, live_noise = np.zeros(80 * 336, dtype=np.float64), np.zeros(80 * 336, dtype=np.float64)
+        step_index = np.append(meta_event_index.astype(np.int64), hits.shape[0])
+        for step in range(n_parameters):
+            histograming.add_hits(hits[step_index[step]:step_index[step + 1]])
+            histograming.add_live_threshold_step()
+            histograming.get_live_threshold(live_threshold, live_noise)
+            self.assertTrue(np.all(live_threshold <= threshold))  # missing steps are counted as fully efficient
+        with self.assertRaises(IndexError):
+            histograming.add_live_threshold_step()
+        self.assertEqual(histograming.get_n_live_threshold_steps(), n_parameters)
+        np.testing.assert_array_equal(live_threshold, threshold)
+        np.testing.assert_array_equal(live_noise, noise)
+
+    def test_scurve_fit(self):  # check the compiled S-curve fit with error function shaped occupancies
+        np.random.seed(0)
+        n_parameters, n_injections, q_min, q_max = 40, 100, 0, 195
+        parameter_values = np.linspace(q_min, q_max, n_parameters)
+        pixel_threshold, pixel_noise = np.random.uniform(50, 150, (80, 20)), np.random.uniform(4, 12, (80, 20))
+        occupancy = np.zeros((80, 336, n_parameters), dtype=np.uint32)
+        for parameter in range(n_parameters):
+            z = (parameter_values[parameter] - pixel_threshold) / (np.sqrt(2) * pixel_noise)
+            occupancy[:, :20, parameter] = np.round(n_injections / 2. * (1 + np.vectorize(math.erf)(z)))
+        column, row, parameter = np.nonzero(occupancy)
+        n_hits = occupancy[column, row, parameter]
+        column, row, parameter = np.repeat(column, n_hits), np.repeat(row, n_hits), np.repeat(parameter, n_hits)
+        order = np.argsort(parameter, kind='mergesort')  # one event per hit, sorted by the scan parameter
+        hits = np.zeros((parameter.shape[0], ), dtype=tb.dtype_from_descr(data_struct.HitInfoTable))
+        hits['event_number'], hits['column'], hits['row'] = np.arange(hits.shape[0]), column[order] + 1, row[order] + 1
+        meta_event_index = np.searchsorted(parameter[order], np.arange(n_parameters)).astype(np.uint64)
+        histograming = PyDataHistograming()
+        histograming.create_occupancy_hist(True)
+        histograming.add_meta_event_index(meta_event_index, meta_event_index.shape[0])
+        histograming.add_scan_parameter(np.arange(n_parameters, dtype=np.int32))
+        histograming.add_hits(hits)
+        threshold, noise, chi2 = np.zeros(80 * 336, dtype=np.float64), np.zeros(80 * 336, dtype=np.float64), np.zeros(80 * 336, dtype=np.float64)
+        status = np.zeros(80 * 336, dtype=np.uint8)
+        histograming.fit_scurves(threshold, noise, chi2, status, n_injections, q_min, q_max)
+        threshold, noise, chi2, status = [array.reshape((80, 336), order='F') for array in (threshold, noise, chi2, status)]
+        self.assertTrue(np.all(status[:, :20] == 0))
+        self.assertTrue(np.all(status[:, 20:] == 2) and np.all(np.isnan(threshold[:, 20:])))
+        self.assertLess(np.max(np.abs(threshold[:, :20] - pixel_threshold)), 0.5)  # only rounding of the occupancy
+        self.assertLess(np.max(np.abs(noise[:, :20] / pixel_noise - 1)), 0.05)
+        self.assertLess(np.max(chi2[:, :20]), 0.25)
+
     def test_analysis_utils_in1d_events(self):  # check compiled get_in1d_sorted function
         event_numbers = np.array([[0, 0, 2, 2, 2, 4, 5, 5, 6, 7, 7, 7, 8], [0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0]], dtype=np.int64)
         event_numbers_2 = np.array([1, 1, 1, 2, 2, 2, 4, 4, 4, 7], dtype=np.int64)
         result = event_numbers[0][analysis_utils.in1d_events(event_numbers[0], event_numbers_2)]
         self.assertListEqual([2, 2, 2, 4, 7, 7, 7], result.tolist())
 
+    def test_analysis_utils_sorted_arrays_skewed(self):  # check the sorted array functions for skewed (galloping) and balanced sizes and empty arrays
+        np.random.seed(0)
+        for size_one, size_two in ((100000, 10), (10, 100000), (1000, 1000), (5000, 300), (0, 100), (100, 0), (0, 0)):
+            events_one = np.sort(np.random.randint(0, 20000, size_one)).astype(np.int64)
+            events_two = np.sort(np.random.randint(0, 20000, size_two)).astype(np.int64)
+            self.assertTrue(np.all(analysis_utils.in1d_events(events_one, events_two) == np.in1d(events_one, events_two)))
+            self.assertListEqual(analysis_utils.get_events_in_both_arrays(events_one, events_two).tolist(), np.intersect1d(events_one, events_two).tolist())
+            values_one, counts_one = np.unique(events_one, return_counts=True)
+            values_two, counts_two = np.unique(events_two, return_counts=True)
+            values = np.union1d(values_one, values_two)
+            counts = np.zeros(values.shape[0], dtype=np.int64)
+            counts[np.searchsorted(values, values_one)] = counts_one
+            counts[np.searchsorted(values, values_two)] = np.maximum(counts[np.searchsorted(values, values_two)], counts_two)
+            self.assertListEqual(analysis_utils.get_max_events_in_both_arrays(events_one, events_two).tolist(), np.repeat(values, counts).tolist())
+
+    def test_analysis_utils_sorted_arrays_parallel(self):  # the merge path parallel functions have to give the serial results
+        np.random.seed(0)
+        events_one = np.sort(np.random.randint(0, 1000000, 3000000)).astype(np.int64)  # many duplicates to split event number runs
+        events_two = np.sort(np.random.randint(0, 1000000, 2000000)).astype(np.int64)
+        for function in (analysis_utils.in1d_events, analysis_utils.get_events_in_both_arrays, analysis_utils.get_max_events_in_both_arrays):
+            self.assertTrue(np.array_equal(function(events_one, events_two, n_threads=1), function(events_one, events_two, n_threads=4)))
+        cluster = np.zeros((events_one.shape[0] // 2, ), dtype=tb.dtype_from_descr(data_struct.ClusterInfoTable))
+        cluster['event_number'] = events_one[::2] * 2  # every cluster has an event entry
+        cluster['size'] = np.arange(cluster.shape[0]) % 100 + 1
+        serial = analysis_utils.map_cluster(events_one * 2, cluster, n_threads=1)
+        self.assertTrue(np.array_equal(serial, analysis_utils.map_cluster(events_one * 2, cluster, n_threads=4)))
+        self.assertEqual(np.count_nonzero(serial['size']), cluster.shape[0])
+        orphan = np.where(np.diff(cluster['event_number']) > 0)[0][cluster.shape[0] // 5] + 1  # odd event number without event entry: only this cluster is not mapped
+        cluster['event_number'][orphan] -= 1
+        serial = analysis_utils.map_cluster(events_one * 2, cluster, n_threads=1)
+        self.assertTrue(np.array_equal(serial, analysis_utils.map_cluster(events_one * 2, cluster, n_threads=4)))
+        self.assertEqual(np.count_nonzero(serial['size']), cluster.shape[0] - 1)
+        self.assertTrue(np.array_equal(serial, analysis_utils.join_sorted(events_one * 2, cluster, how='pairwise', gather=True)[1]))  # map_cluster is the gathered pairwise join
+
     def test_1d_index_histograming(self):  # check compiled hist_2D_index function
         x = np.random.randint(0, 100, 100)
         shape = (100, )
@@ -214,6 +964,223 @@ class TestAnalysis(unittest.TestCase):
                 pass
             self.assertTrue(exception_ok & np.all(array == array_fast))
 
+    def test_index_histograming_types(self):  # check the index types, uint64 and weighted bins and the parallel filling of the compiled histogram functions
+        np.random.seed(0)
+        x, y, z = np.random.randint(0, 80, 3000000), np.random.randint(0, 336, 3000000), np.random.randint(0, 16, 3000000)
+        weights = np.random.uniform(0, 2, x.shape[0])
+        array = np.histogramdd(np.column_stack((x, y, z)), bins=(80, 336, 16), range=[[0, 80], [0, 336], [0, 16]])[0]
+        array_weighted = np.histogramdd(np.column_stack((x, y, z)), bins=(80, 336, 16), range=[[0, 80], [0, 336], [0, 16]], weights=weights)[0]
+        for dtype in (np.uint8, np.uint16, np.int32, np.int64, np.uint32):
+            for n_threads in (1, 4):
+                self.assertTrue(np.all(analysis_utils.hist_1d_index(z.astype(dtype), shape=(16, ), n_threads=n_threads) == array.sum(axis=(0, 1))))
+                self.assertTrue(np.all(analysis_utils.hist_2d_index(x.astype(dtype), y.astype(np.uint16), shape=(80, 336), dtype=np.uint64, n_threads=n_threads) == array.sum(axis=2)))
+                self.assertTrue(np.all(analysis_utils.hist_3d_index(x.astype(dtype), y.astype(np.uint16), z.astype(dtype), shape=(80, 336, 16), n_threads=n_threads) == array))
+                self.assertTrue(np.allclose(analysis_utils.hist_3d_index(x.astype(dtype), y.astype(np.uint16), z.astype(dtype), shape=(80, 336, 16), weights=weights, n_threads=n_threads), array_weighted))
+        self.assertEqual(analysis_utils.hist_1d_index(z.astype(np.uint8), shape=(16, ), dtype=np.uint64).dtype, np.uint64)
+        for n_threads in (1, 4):  # negative and too large indices, the result is not filled in parallel
+            x[-1] = -1
+            with self.assertRaises(IndexError):
+                analysis_utils.hist_2d_index(x, y, shape=(80, 336), n_threads=n_threads)
+            x[-1] = 80
+            with self.assertRaises(IndexError):
+                analysis_utils.hist_2d_index(x, y, shape=(80, 336), n_threads=n_threads)
+        result = np.zeros(16, dtype=np.uint32)  # a uint32 bin overflows in the parallel reduction, the result is not changed
+        result[0] = np.iinfo(np.uint32).max - 10
+        with self.assertRaises(IndexError):
+            analysis_functions.hist_1d(z.astype(np.int32), 16, result, n_threads=4)
+        self.assertEqual(result[0], np.iinfo(np.uint32).max - 10)
+        self.assertEqual(result[1:].sum(), 0)
+        result = np.zeros(80 * 336 * 16, dtype=np.uint32)  # the deprecated throw_exception argument of the old interface is still accepted
+        analysis_functions.hist_3d(x[:-1].astype(np.int32), y[:-1].astype(np.int32), z[:-1].astype(np.int32), 80, 336, 16, result, True)
+        self.assertTrue(np.all(result.reshape((80, 336, 16)) == np.histogramdd(np.column_stack((x[:-1], y[:-1], z[:-1])), bins=(80, 336, 16), range=[[0, 80], [0, 336], [0, 16]])[0]))
+        with self.assertWarns(DeprecationWarning):
+            analysis_functions.hist_3d(x[:1].astype(np.int32), y[:1].astype(np.int32), z[:1].astype(np.int32), 80, 336, 16, result, False)
+        with self.assertRaises(ValueError):  # too few weights or indices would be read out of bounds
+            analysis_utils.hist_1d_index(z, shape=(16, ), weights=weights[:-1])
+        with self.assertRaises(ValueError):
+            analysis_utils.hist_3d_index(x, y[:-1], z, shape=(80, 336, 16))
+        with self.assertRaises(ValueError):
+            analysis_functions.hist_2d(x[:-1].astype(np.int32), y[:-1].astype(np.int32), 80, 336, np.zeros(80 * 336, dtype=np.float64), weights[:-2])
+        with self.assertRaises(ValueError):
+            analysis_functions.hist_3d(x[:-1].astype(np.int32), y[:-1].astype(np.int32), z[:-2].astype(np.int32), 80, 336, 16, result)
+
+    def test_analysis_utils_reduce_groups(self):  # check the compiled group-by reductions against numpy, serial and parallel
+        np.random.seed(0)
+        keys = np.sort(np.random.randint(0, 1000000, 3000000)).astype(np.int64)
+        keys[1499000:1501000] = keys[1499000]  # long group across the split of the parallel reduction
+        tot = np.random.randint(0, 14, keys.shape[0]).astype(np.uint8)
+        charge = np.random.uniform(-1, 1, keys.shape[0]).astype(np.float32)
+        unique_keys, starts, counts = np.unique(keys, return_index=True, return_counts=True)
+        for n_threads in (1, 4):
+            result_keys, result = analysis_utils.reduce_groups(keys, n_threads=n_threads)
+            self.assertTrue(np.array_equal(result_keys, unique_keys) and np.array_equal(result, counts) and result.dtype == np.uint32)
+            result_keys, result = analysis_utils.reduce_groups(keys, tot, 'sum', n_threads=n_threads)
+            self.assertTrue(np.array_equal(result_keys, unique_keys) and np.array_equal(result, np.add.reduceat(tot.astype(np.uint64), starts)) and result.dtype == np.uint64)
+            self.assertTrue(np.allclose(analysis_utils.reduce_groups(keys, charge, 'sum', n_threads=n_threads)[1], np.add.reduceat(charge.astype(np.float64), starts)))
+            self.assertTrue(np.array_equal(analysis_utils.reduce_groups(keys, tot, 'max', n_threads=n_threads)[1], np.maximum.reduceat(tot, starts)))
+            self.assertTrue(np.array_equal(analysis_utils.reduce_groups(keys, charge, 'min', n_threads=n_threads)[1], np.minimum.reduceat(charge, starts)))
+            self.assertTrue(np.array_equal(analysis_utils.reduce_groups(keys, charge, 'first', n_threads=n_threads)[1], charge[starts]))
+            self.assertTrue(np.array_equal(analysis_utils.reduce_groups(keys, charge, 'last', n_threads=n_threads)[1], charge[starts + counts - 1]))
+        result_keys, result = analysis_utils.reduce_groups(np.array([3, 3, 1, 3], dtype=np.int64), np.array([1, 2, 3, 4], dtype=np.int16), 'sum')  # unsorted keys: runs of equal keys, int16 is summed as int64
+        self.assertListEqual([3, 1, 3], result_keys.tolist())
+        self.assertListEqual([3, 3, 4], result.tolist())
+        self.assertEqual(analysis_utils.reduce_groups(np.array([], dtype=np.int64))[0].shape[0], 0)
+        with self.assertRaises(ValueError):
+            analysis_utils.reduce_groups(keys, tot, 'mean')
+
+    def test_analysis_utils_join_sorted(self):  # check the compiled sorted joins against a python join, serial and parallel
+        keys_one = np.array([0, 1, 1, 3, 4, 4, 4, 7, 9], dtype=np.int64)
+        keys_two = np.array([1, 1, 1, 2, 4, 4, 8, 9], dtype=np.int64)
+        inner = [(i, j) for i in range(keys_one.shape[0]) for j in range(keys_two.shape[0]) if keys_one[i] == keys_two[j]]
+        left = sorted(inner + [(i, -1) for i in range(keys_one.shape[0]) if keys_one[i] not in keys_two])
+        pairwise = [(i, (np.where(keys_two == keys_one[i])[0].tolist() + [-1] * 9)[i - np.searchsorted(keys_one, keys_one[i])]) for i in range(keys_one.shape[0])]
+        for how, pairs in (('inner', inner), ('left', left), ('pairwise', pairwise)):
+            index_one, index_two = analysis_utils.join_sorted(keys_one, keys_two, how=how)
+            self.assertListEqual(pairs, list(zip(index_one.tolist(), index_two.tolist())))
+        self.assertEqual(analysis_utils.join_sorted(keys_one, keys_two[:0], how='left')[1].tolist(), [-1] * keys_one.shape[0])
+        with self.assertRaises(ValueError):
+            analysis_utils.join_sorted(keys_one, keys_two, how='outer')
+        np.random.seed(0)  # records of different type, gathered and parallel
+        hits = np.zeros((3000000, ), dtype=tb.dtype_from_descr(data_struct.HitInfoTable))
+        hits['event_number'] = np.sort(np.random.randint(0, 1000000, hits.shape[0]))
+        hits['column'] = np.random.randint(1, 81, hits.shape[0])
+        cluster = np.zeros((20000, ), dtype=tb.dtype_from_descr(data_struct.ClusterInfoTable))
+        cluster['event_number'] = np.sort(np.random.randint(0, 2000000, cluster.shape[0]))  # skewed sizes: galloping
+        cluster['size'] = np.random.randint(1, 10, cluster.shape[0])
+        for how in ('inner', 'left', 'pairwise'):
+            serial = analysis_utils.join_sorted(cluster, hits, how=how, n_threads=1)
+            parallel = analysis_utils.join_sorted(cluster, hits, how=how, n_threads=4)
+            self.assertTrue(np.array_equal(serial[0], parallel[0]) and np.array_equal(serial[1], parallel[1]))
+            matched = serial[1] != -1
+            self.assertTrue(np.array_equal(cluster['event_number'][serial[0][matched]], hits['event_number'][serial[1][matched]]))
+        index_cluster, index_hits = analysis_utils.join_sorted(cluster, hits, how='left')
+        cluster_records, hit_records = analysis_utils.join_sorted(cluster, hits, how='left', gather=True)
+        self.assertTrue(np.array_equal(cluster_records, cluster[index_cluster]))
+        self.assertTrue(np.array_equal(hit_records[index_hits != -1], hits[index_hits[index_hits != -1]]))
+        self.assertTrue(np.all(hit_records['column'][index_hits == -1] == 0) and np.any(index_hits == -1))
+        with self.assertRaises(ValueError):  # gather_records copies raw records, thus only between C-contiguous arrays of the same type
+            analysis_functions.gather_records(cluster, index_cluster, np.empty(index_cluster.shape[0], dtype=hits.dtype))
+        with self.assertRaises(ValueError):
+            analysis_functions.gather_records(cluster[::2], index_cluster[:10], np.empty(10, dtype=cluster.dtype))
+        with self.assertRaises(IndexError):
+            analysis_functions.gather_records(cluster, index_cluster, np.empty(index_cluster.shape[0] - 1, dtype=cluster.dtype))
+
+    def test_analysis_utils_hist_correlation(self):  # check the compiled correlation histograms against the histogram of the joined hits, serial and parallel
+        np.random.seed(0)
+        hits_one = np.zeros((2000000, ), dtype=tb.dtype_from_descr(data_struct.HitInfoTable))
+        hits_one['event_number'] = np.sort(np.random.randint(0, 1000000, hits_one.shape[0]))
+        hits_one['column'], hits_one['row'] = np.random.randint(1, 81, hits_one.shape[0]), np.random.randint(1, 337, hits_one.shape[0])
+        hits_two = np.zeros((1000000, ), dtype=tb.dtype_from_descr(data_struct.HitInfoTable))
+        hits_two['event_number'] = np.sort(np.random.randint(0, 1000000, hits_two.shape[0]))
+        hits_two['column'], hits_two['row'] = np.random.randint(1, 81, hits_two.shape[0]), np.random.randint(1, 337, hits_two.shape[0])
+        index_one, index_two = analysis_utils.join_sorted(hits_one, hits_two)
+        slice_one = (hits_one['event_number'] // 250000).astype(np.uint32)  # four time slices
+        column_correlation = np.zeros((80, 80), dtype=np.uint32)
+        np.add.at(column_correlation, (hits_one['column'][index_one] - 1, hits_two['column'][index_two] - 1), 1)
+        row_correlation = np.zeros((4, 336, 336), dtype=np.uint32)
+        np.add.at(row_correlation, (slice_one[index_one], hits_one['row'][index_one] - 1, hits_two['row'][index_two] - 1), 1)
+        for n_threads in (1, 4):
+            self.assertTrue(np.array_equal(analysis_utils.get_hit_correlations(hits_one, hits_two, n_threads=n_threads)[0], column_correlation))
+            self.assertTrue(np.array_equal(analysis_utils.get_hit_correlations(hits_one, hits_two, slice_one=slice_one, n_slices=4, dtype=np.uint64, n_threads=n_threads)[1], row_correlation))
+        few_hits = hits_one[::2000]  # skewed sizes: galloping
+        index_one, index_two = analysis_utils.join_sorted(few_hits, hits_two)
+        column_correlation = np.zeros((80, 80), dtype=np.uint32)
+        np.add.at(column_correlation, (few_hits['column'][index_one] - 1, hits_two['column'][index_two] - 1), 1)
+        self.assertTrue(np.array_equal(analysis_utils.get_hit_correlations(few_hits, hits_two)[0], column_correlation))
+        with self.assertRaises(IndexError):
+            analysis_utils.hist_correlation(hits_one['event_number'], hits_one['column'], hits_two['event_number'], hits_two['column'] - 1, shape=(80, 80))
+        with self.assertRaises(IndexError):
+            analysis_utils.hist_correlation(hits_one['event_number'], hits_one['row'] - 1, hits_two['event_number'], hits_two['row'] - 1, shape=(3, 336, 336), slice_one=slice_one)
+
+    def test_analysis_utils_chunked(self):  # the chunk-streaming functions have to give the results of the whole arrays for chunk borders within events
+        np.random.seed(0)
+        events = np.sort(np.random.randint(0, 2000, 20000)).astype(np.int64)
+        tot = np.random.randint(0, 14, events.shape[0]).astype(np.uint8)
+        cluster = np.zeros((5000, ), dtype=tb.dtype_from_descr(data_struct.ClusterInfoTable))
+        cluster['event_number'] = np.sort(np.random.randint(0, 2000, cluster.shape[0]))
+        cluster['size'] = np.random.randint(1, 10, cluster.shape[0])
+        borders = np.sort(np.random.randint(0, events.shape[0], 30))  # many chunks, some empty
+        cluster_borders = np.sort(np.random.randint(0, cluster.shape[0], 30))
+        for operation in ('count', 'sum', 'min', 'max', 'first', 'last'):
+            reduction = analysis_utils.ChunkedGroupReduction(operation)
+            results = [reduction.add(chunk, chunk_tot) for chunk, chunk_tot in zip(np.split(events, borders), np.split(tot, borders))] + [reduction.finish()]
+            result_keys, result = analysis_utils.reduce_groups(events, tot, operation)
+            self.assertTrue(np.array_equal(np.concatenate([r[0] for r in results]), result_keys))
+            self.assertTrue(np.array_equal(np.concatenate([r[1] for r in results]), result))
+        for function, table in ((analysis_utils.get_events_in_both_arrays, cluster['event_number']), (analysis_utils.in1d_events, cluster['event_number']), (analysis_utils.map_cluster, cluster)):
+            join = analysis_utils.ChunkedSortedJoin(function)
+            results = [join.add(chunk, chunk_table) for chunk, chunk_table in zip(np.split(events, borders), np.split(table, cluster_borders))] + [join.finish()]
+            self.assertTrue(np.array_equal(np.concatenate([r for r in results if r is not None]), function(events, table)))
+        for how in ('inner', 'left', 'pairwise'):  # chunk-local indices are shifted to the indices of the whole arrays
+            join = analysis_utils.ChunkedSortedJoin(lambda one, two, how=how: analysis_utils.join_sorted(one, two, how=how), indices=True)
+            results = [join.add(chunk, chunk_cluster) for chunk, chunk_cluster in zip(np.split(events, borders), np.split(cluster, cluster_borders))] + [join.finish()]
+            index_one, index_two = analysis_utils.join_sorted(events, cluster, how=how)
+            self.assertTrue(np.array_equal(np.concatenate([r[0] for r in results if r is not None]), index_one))
+            self.assertTrue(np.array_equal(np.concatenate([r[1] for r in results if r is not None]), index_two))
+        hits = np.zeros((events.shape[0], ), dtype=tb.dtype_from_descr(data_struct.HitInfoTable))
+        hits['event_number'], hits['column'], hits['row'] = events, np.random.randint(1, 81, events.shape[0]), np.random.randint(1, 337, events.shape[0])
+        join = analysis_utils.ChunkedSortedJoin(analysis_utils.get_hit_correlations)
+        results = [join.add(chunk_one, chunk_two) for chunk_one, chunk_two in zip(np.split(hits, borders), np.split(hits[::3], cluster_borders // 3))] + [join.finish()]
+        correlations = analysis_utils.get_hit_correlations(hits, hits[::3])
+        self.assertTrue(np.array_equal(sum(r[0] for r in results if r is not None), correlations[0]))
+        self.assertTrue(np.array_equal(sum(r[1] for r in results if r is not None), correlations[1]))
+        early_cluster = cluster[cluster['event_number'] < 1000]  # the cluster array ends early: the events are not buffered after its last chunk
+        join = analysis_utils.ChunkedSortedJoin(analysis_utils.map_cluster)
+        results = [join.add(events[:0], early_cluster, last_two=True)]
+        for end in range(1000, events.shape[0] + 1, 1000):
+            results.append(join.add(events[end - 1000:end]))
+            self.assertEqual(sum(r.shape[0] for r in results), np.searchsorted(events, events[end - 1]))
+        results.append(join.finish())
+        self.assertTrue(np.array_equal(np.concatenate(results), analysis_utils.map_cluster(events, early_cluster)))
+
+    def test_trigger_index(self):  # the trigger index has to unwrap the trigger number overflows and point to the events and their first hits
+        def interpret(trigger_numbers, n_hits, max_trigger_number=0x7FFFFFFF, trigger_format=0):
+            raw_data = []
+            for trigger_number, event_hits in zip(trigger_numbers, n_hits):  # trigger word, one data header and one hit per data record
+                raw_data.extend([0x80000000 | trigger_number, 0x00E90000] + [(1 << 17) | ((i + 1) << 8) | (5 << 4) | 0xF for i in range(event_hits)])
+            raw_data = np.array(raw_data, dtype=np.uint32)
+            interpreter = PyDataInterpreter()
+            interpreter.set_trig_count(1)
+            interpreter.set_warning_output(False)
+            interpreter.set_info_output(False)
+            interpreter.align_at_trigger(True)
+            interpreter.set_max_trigger_number(max_trigger_number)
+            interpreter.set_trigger_format(trigger_format)
+            interpreter.create_trigger_index()
+            interpreter.interpret_raw_data(raw_data[:raw_data.shape[0] // 2])  # two chunks, the hit indices are counted over all chunks
+            hits = interpreter.get_hits().copy()
+            interpreter.interpret_raw_data(raw_data[raw_data.shape[0] // 2:])
+            interpreter.store_event()  # the last event is added to the hits of the last chunk
+            return interpreter, np.concatenate((hits, interpreter.get_hits()))
+
+        trigger_numbers = np.concatenate((np.arange(90, 100), np.arange(100), np.arange(20)))  # two overflows
+        n_hits = np.arange(trigger_numbers.shape[0]) % 3
+        interpreter, hits = interpret(trigger_numbers, n_hits, max_trigger_number=99)
+        trigger_index = interpreter.get_trigger_index()
+        first_hits = np.append(0, np.cumsum(n_hits)[:-1])
+        self.assertTrue(np.array_equal(trigger_index['trigger_key'], 90 + np.arange(trigger_numbers.shape[0])))
+        self.assertTrue(np.array_equal(trigger_index['event_number'], np.arange(trigger_numbers.shape[0])))
+        self.assertTrue(np.array_equal(trigger_index['hit_index'], first_hits))
+        self.assertEqual(hits.shape[0], np.sum(n_hits))
+        self.assertTrue(np.array_equal(hits['event_number'][trigger_index['hit_index'][n_hits != 0]], trigger_index['event_number'][n_hits != 0]))
+        event_numbers, hit_indices = interpreter.find_trigger_events([95, 150, 219, 5, 1000])
+        self.assertTrue(np.array_equal(event_numbers, [5, 60, 129, -1, -1]))
+        self.assertTrue(np.array_equal(hit_indices, [first_hits[5], first_hits[60], first_hits[129], -1, -1]))
+        keys = np.arange(-10, 300)  # interpolation search has to equal a linear search
+        event_numbers, _ = interpreter.find_trigger_events(keys)
+        self.assertTrue(np.array_equal(event_numbers, np.where((keys >= 90) & (keys < 220), keys - 90, -1)))
+
+        interpreter, _ = interpret([0, 1, 2, 3, 4, 3, 6, 7, 8, 9], [1] * 10)  # a wrong trigger number must not shift the following keys
+        trigger_index = interpreter.get_trigger_index()
+        self.assertTrue(np.array_equal(trigger_index['trigger_key'], [0, 1, 2, 3, 3, 4, 6, 7, 8, 9]))
+        self.assertTrue(np.array_equal(trigger_index['event_number'], [0, 1, 2, 3, 5, 4, 6, 7, 8, 9]))
+        self.assertTrue(np.array_equal(interpreter.find_trigger_events([3, 5, 6])[0], [3, -1, 6]))
+        interpreter.reset()
+        self.assertEqual(interpreter.get_trigger_index().shape[0], 0)
+
+        interpreter, _ = interpret([100, 0x50000000, 0x7FFFFF00, 50, 0x60000000], [1] * 5, trigger_format=1)  # time stamps are unwrapped forward, also over gaps longer than half the period
+        self.assertTrue(np.array_equal(interpreter.get_trigger_index()['trigger_key'], [100, 0x50000000, 0x7FFFFF00, 0x80000032, 0xE0000000]))
+
 if __name__ == '__main__':
     suite = unittest.TestLoader().loadTestsFromTestCase(TestAnalysis)
     unittest.TextTestRunner(verbosity=2).run(suite)
@@ -13,9 +13,14 @@ from distutils.command.build_ext import build_ext
 from Cython.Build import cythonize
 import numpy as np
 import os
+import sys
 
 copt = {'msvc': ['-Ipybar_fei4_interpreter/external', '/EHsc']}  # Set additional include path and EHsc exception handling for VS
 lopt = {}
+if sys.platform != 'darwin':  # OpenMP for the multi-threaded histograming, not supported by the default macOS compiler
+    copt['msvc'].append('/openmp')
+    copt['unix'] = ['-fopenmp']
+    lopt['unix'] = ['-fopenmp']
 
 
 class build_ext_opt(build_ext):